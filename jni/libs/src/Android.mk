@@ -55,16 +55,20 @@ LOCAL_C_INCLUDES := \
 LOCAL_SRC_FILES := \
   $(subst $(LOCAL_PATH)/,,$(DEPENDENCIES_SDL_DIR))/src/main/android/SDL_android_main.c \
   $(PIE_NOON_RELATIVE_DIR)/src/ai_controller.cpp \
+  $(PIE_NOON_RELATIVE_DIR)/src/ai_perception.cpp \
+  $(PIE_NOON_RELATIVE_DIR)/src/ai_scheduler.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/analytics_tracking.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/cardboard_controller.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/character.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/character_state_machine.cpp \
+  $(PIE_NOON_RELATIVE_DIR)/src/client_snapshot_buffer.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/controller.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/components/cardboard_player.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/components/drip_and_vanish.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/components/player_character.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/components/scene_object.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/components/shakeable_prop.cpp \
+  $(PIE_NOON_RELATIVE_DIR)/src/frustum_culler.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/full_screen_fader.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/gamepad_controller.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/game_camera.cpp \
@@ -72,6 +76,9 @@ LOCAL_SRC_FILES := \
   $(PIE_NOON_RELATIVE_DIR)/src/gpg_manager.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/gpg_multiplayer.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/gui_menu.cpp \
+  $(PIE_NOON_RELATIVE_DIR)/src/headless_game.cpp \
+  $(PIE_NOON_RELATIVE_DIR)/src/job_thread.cpp \
+  $(PIE_NOON_RELATIVE_DIR)/src/lookahead_ai_controller.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/main.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/multiplayer_controller.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/multiplayer_director.cpp \
@@ -79,12 +86,20 @@ LOCAL_SRC_FILES := \
   $(PIE_NOON_RELATIVE_DIR)/src/particles.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/precompiled.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/pie_noon_game.cpp \
+  $(PIE_NOON_RELATIVE_DIR)/src/pie_trajectory.cpp \
+  $(PIE_NOON_RELATIVE_DIR)/src/rollout_planner.cpp \
+  $(PIE_NOON_RELATIVE_DIR)/src/scene_description.cpp \
+  $(PIE_NOON_RELATIVE_DIR)/src/shadow_batch.cpp \
+  $(PIE_NOON_RELATIVE_DIR)/src/static_layer.cpp \
   $(PIE_NOON_RELATIVE_DIR)/src/touchscreen_button.cpp \
-  $(PIE_NOON_RELATIVE_DIR)/src/touchscreen_controller.cpp
+  $(PIE_NOON_RELATIVE_DIR)/src/touchscreen_controller.cpp \
+  $(PIE_NOON_RELATIVE_DIR)/src/utility_ai_controller.cpp \
+  $(PIE_NOON_RELATIVE_DIR)/src/worker_pool.cpp
 
 PIE_NOON_SCHEMA_DIR := $(PIE_NOON_DIR)/src/flatbufferschemas
 
 PIE_NOON_SCHEMA_FILES := \
+  $(PIE_NOON_SCHEMA_DIR)/atlas.fbs \
   $(PIE_NOON_SCHEMA_DIR)/character_state_machine_def.fbs \
   $(PIE_NOON_SCHEMA_DIR)/config.fbs \
   $(PIE_NOON_SCHEMA_DIR)/components.fbs \
@@ -18,18 +18,23 @@
 
 Finds the flatbuffer compiler and cwebp tool and then uses them to convert the
 JSON files to flatbuffer binary files and the png files to webp files so that
-they can be loaded by the game. This script also includes various 'make' style
-rules. If you just want to build the flatbuffer binaries you can pass
-'flatbuffer' as an argument, or if you want to just build the webp files you can
-pass 'cwebp' as an argument. Additionally, if you would like to clean all
-generated files, you can call this script with the argument 'clean'.
+they can be loaded by the game. Before converting, the art of the cardboard
+cutouts is packed into texture atlases, see build_atlases(). This script also
+includes various 'make' style rules. If you just want to build the flatbuffer
+binaries you can pass 'flatbuffer' as an argument, or if you want to just build
+the webp files you can pass 'cwebp' as an argument. Additionally, if you would
+like to clean all generated files, you can call this script with the argument
+'clean'.
 """
 
 
 import distutils.dir_util
 import glob
+import io
 import json
+import math
 import os
+import re
 import sys
 # The project root directory, which is two levels up from this script's
 # directory.
@@ -70,14 +75,50 @@ INTERMEDIATE_ASSETS_PATH = os.path.join(PROJECT_ROOT, 'obj', 'assets')
 # Directory where png files are written to before they are converted to webp.
 INTERMEDIATE_TEXTURE_PATH = os.path.join(INTERMEDIATE_ASSETS_PATH, 'textures')
 
+# Directory where the texture atlases are written. It is laid out like
+# rawassets/, and its contents are converted along with them.
+ATLAS_ASSETS_PATH = os.path.join(INTERMEDIATE_ASSETS_PATH, 'atlas')
+
 # Potential root directories for source assets.
-ASSET_ROOTS = [RAW_ASSETS_PATH, INTERMEDIATE_TEXTURE_PATH]
+ASSET_ROOTS = [RAW_ASSETS_PATH, INTERMEDIATE_TEXTURE_PATH, ATLAS_ASSETS_PATH]
 
 # Overlay directories.
 OVERLAY_DIRS = [os.path.relpath(f, RAW_ASSETS_PATH)
                 for f in glob.glob(os.path.join(RAW_ASSETS_PATH, 'overlays',
                                                 '*'))]
 
+# Name of the atlas manifest, and prefix of the atlas page textures and
+# materials. Must match kAtlasFileName in pie_noon_game.cpp.
+ATLAS_NAME = 'cardboard_atlas'
+
+# Largest atlas page, in pixels, along either side. Some OpenGL ES 2 devices
+# don't support larger textures.
+ATLAS_MAX_PAGE_SIZE = 2048
+
+# Number of mip levels, after the full size one, at which no texel of an
+# atlas page mixes the art of two materials. Pages are mipmapped, and each
+# level averages blocks twice the size of the last one, so the art is kept
+# 2 ** ATLAS_CLEAN_MIP_LEVELS pixels apart and aligned to blocks that size.
+# Only cutouts shrunk more than that many times can show their neighbours.
+ATLAS_CLEAN_MIP_LEVELS = 4
+
+# Transparent pixels around each piece of art in an atlas, so that texture
+# filtering doesn't bleed its neighbours into it. Also the alignment of every
+# piece of art on its page.
+ATLAS_GUTTER = 2 ** ATLAS_CLEAN_MIP_LEVELS
+
+# Number of levels per color channel that character variant palettes are
+# indexed by. Must match kPaletteSize in pie_noon_game.cpp and the shaders.
+PALETTE_SIZE = 32
+
+# How closely recoloring the base character with a palette has to match the
+# art of a variant, for the variant to be drawn that way. In 8 bit units,
+# averaged over the channels of each pixel: the mean error, and the error
+# beyond which a pixel is an outlier, of which there may only be a few.
+PALETTE_MAX_MEAN_ERROR = 2.0
+PALETTE_OUTLIER_ERROR = 16
+PALETTE_MAX_OUTLIERS = 0.01
+
 # A list of json files and their schemas that will be converted to binary files
 # by the flatbuffer compiler.
 FLATBUFFERS_CONVERSION_DATA = [
@@ -115,6 +156,547 @@ FLATBUFFERS_CONVERSION_DATA = [
 ]
 
 
+def atlas_files(pattern):
+  """List of files matching pattern in the atlas output, including overlays.
+
+  Args:
+    pattern: glob style pattern, relative to the root of the assets.
+
+  Returns:
+    List of filenames.
+  """
+  return (glob.glob(os.path.join(ATLAS_ASSETS_PATH, pattern)) +
+          glob.glob(os.path.join(ATLAS_ASSETS_PATH, 'overlays', '*', pattern)))
+
+
+def flatbuffers_conversion_data():
+  """FLATBUFFERS_CONVERSION_DATA plus the output of build_atlases()."""
+  return FLATBUFFERS_CONVERSION_DATA + [
+      builder.FlatbuffersConversionData(
+          schema=PROJECT_SCHEMA_PATH.join('atlas.fbs'),
+          extension='.pieatlas',
+          input_files=atlas_files(ATLAS_NAME + '.json')),
+      builder.FlatbuffersConversionData(
+          schema=builder.FPLBASE_ROOT.join('schemas', 'materials.fbs'),
+          extension='.fplmat',
+          input_files=atlas_files(os.path.join('materials', '*.json')))]
+
+
+# Matches the parts of a flatc JSON file that the json module can't read:
+# comments, and enum values written as bare identifiers. Strings are matched
+# too, so that their contents are left alone.
+FLATC_JSON_TOKEN = re.compile(
+    r'("(?:\\.|[^"\\])*")|(//[^\n]*)|\b([A-Za-z_]\w*)\b')
+
+# Matches trailing commas, which flatc accepts and the json module doesn't.
+FLATC_JSON_TRAILING_COMMA = re.compile(r'("(?:\\.|[^"\\])*")|,(?=\s*[}\]])')
+
+
+def load_flatc_json(filename):
+  """Loads a JSON file written for flatc into Python objects.
+
+  Args:
+    filename: JSON file to load.
+
+  Returns:
+    The contents of the file. Enum values are returned as strings.
+  """
+  def replace_token(match):
+    string, comment, identifier = match.groups()
+    if string:
+      return string
+    if comment:
+      return ''
+    if identifier in ('true', 'false', 'null'):
+      return identifier
+    return '"%s"' % identifier
+
+  with open(filename) as f:
+    text = FLATC_JSON_TOKEN.sub(replace_token, f.read())
+  text = FLATC_JSON_TRAILING_COMMA.sub(lambda m: m.group(1) or '', text)
+  return json.loads(text)
+
+
+def round_up_to_power_of_2(x):
+  """Smallest power of two that is >= x, for x >= 1."""
+  return 1 << (int(math.ceil(x)) - 1).bit_length()
+
+
+def find_raw_asset(overlay, path):
+  """Finds a file in rawassets/, preferring the overlay's version of it.
+
+  Args:
+    overlay: Overlay directory relative to rawassets/, or None.
+    path: File name relative to the root of the assets.
+
+  Returns:
+    Full path to the file, or None if there's no such file.
+  """
+  roots = [RAW_ASSETS_PATH]
+  if overlay:
+    roots.insert(0, os.path.join(RAW_ASSETS_PATH, overlay))
+  for root in roots:
+    candidate = os.path.join(root, path)
+    if os.path.isfile(candidate):
+      return candidate
+  return None
+
+
+def cardboard_art_bounds(config):
+  """Finds the materials drawn as cardboard cutouts, and how much of each.
+
+  PieNoonGame::CreateVerticalQuadMesh() draws the bottom center of each
+  texture, of a size given by the renderable's 'pixel_bounds'. The texture
+  itself is that size rounded up to a power of two.
+
+  Args:
+    config: Contents of config.json.
+
+  Returns:
+    Dictionary of material name to the (width, height) of its art. Materials
+    drawn at more than one size are left out.
+  """
+  bounds = {}
+  conflicts = set()
+
+  def add(material, bounds_json):
+    if not material or not bounds_json:
+      return
+    size = (bounds_json.get('x', 0), bounds_json.get('y', 0))
+    if size[0] <= 0 or size[1] <= 0:
+      return
+    if bounds.setdefault(material, size) != size:
+      conflicts.add(material)
+
+  for renderable in config.get('renderables', []):
+    pixel_bounds = renderable.get('pixel_bounds')
+    for material in renderable.get('cardboard_fronts', []):
+      add(material, pixel_bounds)
+    add(renderable.get('cardboard_back'), pixel_bounds)
+  add(config.get('stick_front'), config.get('stick_bounds'))
+  add(config.get('stick_back'), config.get('stick_bounds'))
+
+  for material in conflicts:
+    del bounds[material]
+  return bounds
+
+
+def cardboard_variants(config):
+  """Finds the color variants of each cardboard cutout.
+
+  Args:
+    config: Contents of config.json.
+
+  Returns:
+    Dictionary of variant index to the list of (base material, variant
+    material) of the renderables with that variant. Variant 0 is the base.
+  """
+  variants = {}
+  for renderable in config.get('renderables', []):
+    fronts = renderable.get('cardboard_fronts', [])
+    for index, material in enumerate(fronts[1:], 1):
+      if material and material != fronts[0]:
+        variants.setdefault(index, []).append((fronts[0], material))
+  return variants
+
+
+def palette_cell(color):
+  """Index of the palette entry for an (r, g, b, ...) color."""
+  step = 256 // PALETTE_SIZE
+  return ((color[2] // step * PALETTE_SIZE + color[1] // step) *
+          PALETTE_SIZE + color[0] // step)
+
+
+def palette_neighbours(cell):
+  """Indices of the palette entries next to cell along each channel."""
+  r = cell % PALETTE_SIZE
+  g = cell // PALETTE_SIZE % PALETTE_SIZE
+  b = cell // (PALETTE_SIZE * PALETTE_SIZE)
+  neighbours = []
+  for channel, value in enumerate((r, g, b)):
+    stride = PALETTE_SIZE ** channel
+    if value > 0:
+      neighbours.append(cell - stride)
+    if value < PALETTE_SIZE - 1:
+      neighbours.append(cell + stride)
+  return neighbours
+
+
+def fit_palette(pixel_pairs):
+  """Works out the palette that best recolors base art into its variants.
+
+  Entries for colors that aren't in the base art are filled in from the
+  nearest ones that are. The game samples the art with bilinear filtering
+  from lossy, mipmapped textures, which blends neighbouring colors, and the
+  blends have to be recolored like the colors they came from.
+
+  Args:
+    pixel_pairs: List of lists of (base pixel, variant pixel), RGBA.
+
+  Returns:
+    The palette, as a bytearray of deltas in the format of AtlasPalette.
+  """
+  num_cells = PALETTE_SIZE ** 3
+  sums = [0.0] * (3 * num_cells)
+  counts = [0] * num_cells
+  for pairs in pixel_pairs:
+    for base, variant in pairs:
+      if base[3] == 0:
+        continue
+      cell = palette_cell(base)
+      counts[cell] += 1
+      for channel in range(3):
+        sums[3 * cell + channel] += variant[channel] - base[channel]
+  for cell, count in enumerate(counts):
+    for channel in range(3):
+      if count:
+        sums[3 * cell + channel] /= count
+
+  # Grow the filled entries outwards a step at a time. Each new entry takes
+  # the average of the neighbours that were filled before it.
+  frontier = [cell for cell, count in enumerate(counts) if count]
+  while frontier:
+    reached = {}
+    for cell in frontier:
+      for neighbour in palette_neighbours(cell):
+        if not counts[neighbour]:
+          reached.setdefault(neighbour, []).append(cell)
+    for cell, sources in reached.items():
+      for channel in range(3):
+        sums[3 * cell + channel] = sum(
+            sums[3 * source + channel] for source in sources) / len(sources)
+      counts[cell] = len(sources)
+    frontier = list(reached)
+
+  deltas = bytearray(3 * num_cells)
+  for index, delta in enumerate(sums):
+    deltas[index] = max(0, min(255, int(round(delta / 2)) + 128))
+  return deltas
+
+
+def filtered_pixels(size, pixels):
+  """The art as texture filtering sees it, between texels and mip levels.
+
+  Args:
+    size: (width, height) of the art.
+    pixels: Its pixels, RGBA, a row at a time.
+
+  Returns:
+    The average of each 2x2 block of pixels, RGBA, which is the next mip
+    level down and also what bilinear filtering blends halfway between
+    texels.
+  """
+  width, height = size
+  blended = []
+  for y in range(0, height - 1, 2):
+    for x in range(0, width - 1, 2):
+      block = (pixels[y * width + x], pixels[y * width + x + 1],
+               pixels[(y + 1) * width + x], pixels[(y + 1) * width + x + 1])
+      blended.append(tuple((sum(p[c] for p in block) + 2) // 4
+                           for c in range(4)))
+  return blended
+
+
+def palette_fits(pairs, deltas):
+  """Whether recoloring with a palette reproduces a variant closely enough.
+
+  Args:
+    pairs: List of (base pixel, variant pixel), RGBA.
+    deltas: Palette, as returned by fit_palette().
+
+  Returns:
+    True if the mean and outlier errors are within the PALETTE_* limits.
+  """
+  total_error = 0.0
+  num_pixels = 0
+  num_outliers = 0
+  for base, variant in pairs:
+    if base[3] == 0 and variant[3] == 0:
+      continue
+    num_pixels += 1
+    if abs(base[3] - variant[3]) > PALETTE_OUTLIER_ERROR:
+      num_outliers += 1
+      continue
+    cell = 3 * palette_cell(base)
+    error = sum(abs(max(0, min(255, base[c] + 2 * (deltas[cell + c] - 128))) -
+                    variant[c]) for c in range(3)) / 3.0
+    # Color errors show less where the art is see-through, and the color of
+    # see-through pixels blended in by filtering is often arbitrary.
+    error *= max(base[3], variant[3]) / 255.0
+    total_error += error
+    if error > PALETTE_OUTLIER_ERROR:
+      num_outliers += 1
+  return num_pixels > 0 and (
+      total_error / num_pixels <= PALETTE_MAX_MEAN_ERROR and
+      num_outliers <= PALETTE_MAX_OUTLIERS * num_pixels)
+
+
+def build_palettes(variants, art_pixels):
+  """Works out which variants can be drawn by recoloring their base art.
+
+  Variants with the same index are assumed to be recolored the same way, so
+  they share a palette. Variants that the palette doesn't reproduce closely
+  enough are left out of it, and keep their own art.
+
+  Args:
+    variants: As returned by cardboard_variants().
+    art_pixels: Dictionary of material name to the (size, pixels) of its art.
+
+  Returns:
+    A list of palettes, and a dictionary of each recolored variant material to
+    (base material, index into the list of palettes).
+  """
+  palettes = []
+  recolors = {}
+  for index in sorted(variants):
+    candidates = {}
+    for base, variant in variants[index]:
+      if base not in art_pixels or variant not in art_pixels:
+        continue
+      base_size, base_pixels = art_pixels[base]
+      variant_size, variant_pixels = art_pixels[variant]
+      if base_size == variant_size:
+        filtered = list(zip(filtered_pixels(base_size, base_pixels),
+                            filtered_pixels(variant_size, variant_pixels)))
+        candidates[variant] = (base, list(zip(base_pixels, variant_pixels)),
+                               filtered)
+
+    # Refit without the variants that don't fit, until they all do. The
+    # blends that filtering makes have to fit as well as the art itself.
+    while candidates:
+      deltas = fit_palette([pairs for _, pairs, _ in candidates.values()])
+      misfits = [variant
+                 for variant, (_, pairs, filtered) in candidates.items()
+                 if not (palette_fits(pairs, deltas) and
+                         palette_fits(filtered, deltas))]
+      if not misfits:
+        break
+      for variant in misfits:
+        del candidates[variant]
+    if candidates:
+      for variant, (base, _, _) in candidates.items():
+        recolors[variant] = (base, len(palettes))
+      palettes.append(deltas)
+  return palettes, recolors
+
+
+def atlas_cell_size(art_size):
+  """Space an atlas page needs for art of art_size, gutters included.
+
+  Rounded up to whole multiples of ATLAS_GUTTER, so that when cells are
+  packed from the corner of a page, the art in every one is aligned to the
+  blocks that the first ATLAS_CLEAN_MIP_LEVELS mip levels average.
+
+  Args:
+    art_size: (width, height) of the art.
+
+  Returns:
+    (width, height) of the cell. The art goes ATLAS_GUTTER in from its top
+    left corner.
+  """
+  def cell(length):
+    return -(-(length + 2 * ATLAS_GUTTER) // ATLAS_GUTTER) * ATLAS_GUTTER
+  return (cell(art_size[0]), cell(art_size[1]))
+
+
+def pack_shelves(sizes, page_size):
+  """Packs rectangles onto square pages in rows, tallest first.
+
+  Args:
+    sizes: List of (width, height). Neither may be larger than page_size.
+    page_size: Width and height of a page.
+
+  Returns:
+    List of the (page, x, y) of each rectangle, in the same order as sizes.
+  """
+  order = sorted(range(len(sizes)),
+                 key=lambda i: (-sizes[i][1], -sizes[i][0]))
+  placements = [None] * len(sizes)
+  page, x, y, shelf_height = 0, 0, 0, 0
+  for i in order:
+    width, height = sizes[i]
+    if x + width > page_size:
+      x, y, shelf_height = 0, y + shelf_height, 0
+    if y + height > page_size:
+      page, x, y, shelf_height = page + 1, 0, 0, 0
+    placements[i] = (page, x, y)
+    x += width
+    shelf_height = max(shelf_height, height)
+  return placements
+
+
+def write_if_changed(filename, data):
+  """Writes data to filename, unless the file already holds exactly that.
+
+  Keeps the timestamps of unchanged outputs, so that the make style rules
+  don't convert them again.
+  """
+  if os.path.isfile(filename):
+    with open(filename, 'rb') as f:
+      if f.read() == data:
+        return
+  directory = os.path.dirname(filename)
+  if not os.path.isdir(directory):
+    os.makedirs(directory)
+  with open(filename, 'wb') as f:
+    f.write(data)
+
+
+def build_atlas(overlay):
+  """Packs the art of the cardboard cutouts into as few textures as possible.
+
+  Each material's art is cut out of its texture, without the power of two
+  padding around it, and packed onto an atlas page. Materials are only packed
+  onto the same page if all of their other textures and settings match, since
+  they will all be drawn with the page's material. Character variants that
+  only differ from the base character in color aren't packed at all; they're
+  drawn from the base character's art, recolored by a palette.
+
+  Writes, under ATLAS_ASSETS_PATH, the page textures and materials, and the
+  ATLAS_NAME manifest that tells the game where each material's art went.
+
+  Args:
+    overlay: Overlay directory relative to rawassets/, or None to build the
+      atlas of the base assets.
+  """
+  from PIL import Image  # pylint: disable=g-import-not-at-top
+
+  config = load_flatc_json(find_raw_asset(overlay, 'config.json'))
+  art_bounds = cardboard_art_bounds(config)
+
+  # Cut out the art.
+  cutouts = {}
+  for material_name, bounds in sorted(art_bounds.items()):
+    raw_material = find_raw_asset(
+        overlay, os.path.splitext(material_name)[0] + '.json')
+    if not raw_material:
+      continue
+    material = load_flatc_json(raw_material)
+    textures = material.get('texture_filenames', [])
+    if not textures:
+      continue
+    texture_file = find_raw_asset(overlay,
+                                  os.path.splitext(textures[0])[0] + '.png')
+    if not texture_file:
+      continue
+    image = Image.open(texture_file).convert('RGBA')
+    texture_width, texture_height = image.size
+    width = int(round(texture_width * float(bounds[0]) /
+                      round_up_to_power_of_2(bounds[0])))
+    height = int(round(texture_height * float(bounds[1]) /
+                       round_up_to_power_of_2(bounds[1])))
+    if max(atlas_cell_size((width, height))) > ATLAS_MAX_PAGE_SIZE:
+      continue
+    left = (texture_width - width) // 2
+    top = texture_height - height
+    art = image.crop((left, top, left + width, top + height))
+    cutouts[material_name] = (dict(material, texture_filenames=textures[1:]),
+                              art)
+
+  # Variants that are recolors of their base art don't need art of their own.
+  palettes, recolors = build_palettes(
+      cardboard_variants(config),
+      dict((name, (art.size, list(art.getdata())))
+           for name, (_, art) in cutouts.items()))
+
+  # Group the rest of the art by the rest of its material.
+  groups = {}
+  for material_name, (page_material, art) in sorted(cutouts.items()):
+    if material_name in recolors:
+      continue
+    key = json.dumps(page_material, sort_keys=True)
+    groups.setdefault(key, (page_material, []))[1].append((material_name, art))
+
+  # Pack each group onto its own pages.
+  pages = []
+  entries = []
+  for key in sorted(groups):
+    page_material, arts = groups[key]
+    sizes = [atlas_cell_size(art.size) for _, art in arts]
+    placements = pack_shelves(sizes, ATLAS_MAX_PAGE_SIZE)
+    first_page = len(pages)
+    for page in range(max(p for p, _, _ in placements) + 1):
+      used = [(x + w, y + h) for (p, x, y), (w, h) in zip(placements, sizes)
+              if p == page]
+      pages.append({
+          'material': page_material,
+          'size': (round_up_to_power_of_2(max(u[0] for u in used)),
+                   round_up_to_power_of_2(max(u[1] for u in used))),
+          'arts': []})
+    for (material_name, art), (page, x, y) in zip(arts, placements):
+      pages[first_page + page]['arts'].append((art, x + ATLAS_GUTTER,
+                                               y + ATLAS_GUTTER))
+      page_width, page_height = pages[first_page + page]['size']
+      x += ATLAS_GUTTER
+      y += ATLAS_GUTTER
+      entries.append({
+          'material': material_name,
+          'page': first_page + page,
+          'uv_min': {'x': float(x) / page_width, 'y': float(y) / page_height},
+          'uv_max': {'x': float(x + art.size[0]) / page_width,
+                     'y': float(y + art.size[1]) / page_height}})
+
+  # Recolored variants are drawn from the art of their base.
+  base_entries = dict((entry['material'], entry) for entry in entries)
+  for variant, (base, palette) in recolors.items():
+    if base in base_entries:
+      entries.append(dict(base_entries[base], material=variant,
+                          palette=palette))
+
+  # Write the pages, and remove any left over from a previous build.
+  output_path = os.path.join(ATLAS_ASSETS_PATH, overlay or '')
+  manifest_pages = []
+  written = set()
+  for index, page in enumerate(pages):
+    name = '%s%d' % (ATLAS_NAME, index)
+    image = Image.new('RGBA', page['size'], (0, 0, 0, 0))
+    for art, x, y in page['arts']:
+      image.paste(art, (x, y))
+    png = io.BytesIO()
+    image.save(png, 'PNG')
+    texture_file = os.path.join(output_path, 'textures', name + '.png')
+    write_if_changed(texture_file, png.getvalue())
+
+    material = dict(page['material'])
+    material['texture_filenames'] = (['textures/%s.webp' % name] +
+                                     material['texture_filenames'])
+    material_file = os.path.join(output_path, 'materials', name + '.json')
+    write_if_changed(material_file,
+                     json.dumps(material, indent=4, sort_keys=True) + '\n')
+
+    manifest_pages.append({'material': 'materials/%s.fplmat' % name})
+    written.update((texture_file, material_file))
+
+  for stale in (glob.glob(os.path.join(output_path, 'textures',
+                                       ATLAS_NAME + '*.png')) +
+                glob.glob(os.path.join(output_path, 'materials',
+                                       ATLAS_NAME + '*.json'))):
+    if stale not in written:
+      os.remove(stale)
+
+  manifest = {'pages': manifest_pages,
+              'entries': sorted(entries, key=lambda e: e['material']),
+              'palettes': [{'deltas': list(deltas)} for deltas in palettes]}
+  write_if_changed(os.path.join(output_path, ATLAS_NAME + '.json'),
+                   json.dumps(manifest, indent=2, sort_keys=True) + '\n')
+
+
+def build_atlases():
+  """Builds the texture atlas of the base assets and of each overlay.
+
+  Needs the Python Imaging Library. Without it no atlases are built, and the
+  game draws each cardboard cutout from its own texture.
+  """
+  try:
+    import PIL  # pylint: disable=g-import-not-at-top,unused-variable
+  except ImportError:
+    sys.stderr.write('Warning: PIL not found, not building texture '
+                     'atlases.\n')
+    return
+  for overlay in [None] + OVERLAY_DIRS:
+    build_atlas(overlay)
+
+
 def fbx_files_to_convert():
   """FBX files to convert to fplmesh."""
   return glob.glob(os.path.join(RAW_MESH_PATH, '*.fbx'))
@@ -135,7 +717,7 @@ def texture_files(pattern):
 
 def png_files_to_convert():
   """PNG files to convert to webp."""
-  return texture_files('*.png')
+  return texture_files('*.png') + atlas_files(os.path.join('textures', '*.png'))
 
 
 def tga_files_to_convert():
@@ -160,6 +742,11 @@ def main():
   Returns:
     Returns 0 on success.
   """
+  if 'clean' in sys.argv[1:]:
+    if os.path.isdir(ATLAS_ASSETS_PATH):
+      distutils.dir_util.remove_tree(ATLAS_ASSETS_PATH)
+  else:
+    build_atlases()
   return builder.main(
       project_root=PROJECT_ROOT,
       assets_path=ASSETS_PATH,
@@ -168,7 +755,7 @@ def main():
       overlay_dirs=OVERLAY_DIRS,
       tga_files_to_convert=tga_files_to_convert,
       png_files_to_convert=png_files_to_convert,
-      flatbuffers_conversion_data=lambda: FLATBUFFERS_CONVERSION_DATA)
+      flatbuffers_conversion_data=flatbuffers_conversion_data)
 
 
 if __name__ == '__main__':
@@ -0,0 +1,138 @@
+#!/usr/bin/python
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+"""Tests the texture atlas and palette helpers in build_assets.py.
+
+Only needs Python. The asset builder module that build_assets.py imports is
+replaced with a stub, since none of the code under test uses it.
+"""
+
+
+import os
+import sys
+import unittest
+
+
+class _Stub(object):
+  """Stands in for any module, attribute or call result."""
+
+  def __getattr__(self, name):
+    return _Stub()
+
+  def __call__(self, *args, **kwargs):
+    return _Stub()
+
+
+sys.modules.setdefault('scene_lab_asset_builder', _Stub())
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import build_assets  # pylint: disable=g-import-not-at-top
+
+
+def recolor(deltas, pixel):
+  """Applies a palette to an RGBA pixel, as the cardboard shaders do."""
+  cell = 3 * build_assets.palette_cell(pixel)
+  return tuple(max(0, min(255, pixel[c] + 2 * (deltas[cell + c] - 128)))
+               for c in range(3)) + (pixel[3],)
+
+
+class PaletteTest(unittest.TestCase):
+
+  def test_fit_palette_recolors_the_art(self):
+    pairs = [((200, 40, 40, 255), (40, 40, 200, 255)),
+             ((40, 200, 40, 255), (40, 200, 40, 255))]
+    deltas = build_assets.fit_palette([pairs])
+    for base, variant in pairs:
+      self.assertEqual(variant, recolor(deltas, base))
+
+  def test_fit_palette_fills_blended_colors(self):
+    # Red turns blue and white stays white. A blend of mostly red with a
+    # little white was never in the art, but filtering makes it, so it
+    # should still turn mostly blue.
+    red = (224, 32, 32, 255)
+    pairs = [(red, (32, 32, 224, 255)), ((255, 255, 255, 255),) * 2]
+    deltas = build_assets.fit_palette([pairs])
+    blend = (232, 88, 88, 255)
+    cell = 3 * build_assets.palette_cell(blend)
+    self.assertNotEqual(128, deltas[cell])
+    recolored = recolor(deltas, blend)
+    self.assertGreater(recolored[2], recolored[0])
+
+  def test_filtered_pixels_averages_blocks(self):
+    pixels = [(0, 0, 0, 0), (255, 255, 255, 255),
+              (255, 255, 255, 255), (255, 255, 255, 255)]
+    self.assertEqual([(191, 191, 191, 191)],
+                     build_assets.filtered_pixels((2, 2), pixels))
+
+  def test_filtered_art_fits_filled_palette(self):
+    # Stripes of two colors, each recolored differently.
+    size = (8, 8)
+    colors = [((224, 32, 32, 255), (32, 32, 224, 255)),
+              ((32, 224, 32, 255), (224, 224, 32, 255))]
+    base = [colors[x // 3 % 2][0] for _ in range(8) for x in range(8)]
+    variant = [colors[x // 3 % 2][1] for _ in range(8) for x in range(8)]
+    pairs = list(zip(base, variant))
+    filtered = list(zip(build_assets.filtered_pixels(size, base),
+                        build_assets.filtered_pixels(size, variant)))
+    deltas = build_assets.fit_palette([pairs])
+    self.assertTrue(build_assets.palette_fits(pairs, deltas))
+    self.assertTrue(build_assets.palette_fits(filtered, deltas))
+
+  def test_build_palettes_recolors_only_matching_variants(self):
+    size = (2, 2)
+    base = [(224, 32, 32, 255)] * 4
+    recolored = [(32, 32, 224, 255)] * 4
+    reshaped = [(224, 32, 32, 255)] * 2 + [(0, 0, 0, 0)] * 2
+    art = {'base': (size, base), 'blue': (size, recolored),
+           'cut': (size, reshaped)}
+    palettes, recolors = build_assets.build_palettes(
+        {1: [('base', 'blue')], 2: [('base', 'cut')]}, art)
+    self.assertEqual(1, len(palettes))
+    self.assertEqual({'blue': ('base', 0)}, recolors)
+
+
+class AtlasTest(unittest.TestCase):
+
+  def test_cells_are_aligned_to_the_gutter(self):
+    gutter = build_assets.ATLAS_GUTTER
+    self.assertEqual(2 ** build_assets.ATLAS_CLEAN_MIP_LEVELS, gutter)
+    for length in (1, gutter - 1, gutter, 3 * gutter + 5):
+      width, height = build_assets.atlas_cell_size((length, 2 * length))
+      self.assertEqual(0, width % gutter)
+      self.assertEqual(0, height % gutter)
+      self.assertGreaterEqual(width, length + 2 * gutter)
+      self.assertGreaterEqual(height, 2 * length + 2 * gutter)
+
+  def test_pack_shelves_places_aligned_cells_without_overlap(self):
+    gutter = build_assets.ATLAS_GUTTER
+    page_size = 256
+    sizes = [build_assets.atlas_cell_size(art)
+             for art in [(100, 20), (30, 90), (7, 7), (120, 50), (60, 60),
+                         (200, 10), (5, 150)]]
+    placements = build_assets.pack_shelves(sizes, page_size)
+    rects = []
+    for (page, x, y), (width, height) in zip(placements, sizes):
+      self.assertEqual(0, x % gutter)
+      self.assertEqual(0, y % gutter)
+      self.assertLessEqual(x + width, page_size)
+      self.assertLessEqual(y + height, page_size)
+      for other_page, ox, oy, ow, oh in rects:
+        self.assertFalse(page == other_page and x < ox + ow and
+                         ox < x + width and y < oy + oh and oy < y + height)
+      rects.append((page, x, y, width, height))
+
+
+if __name__ == '__main__':
+  unittest.main()
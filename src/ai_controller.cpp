@@ -20,15 +20,30 @@
 namespace fpl {
 namespace pie_noon {
 
+AiTuning AiTuning::FromConfig(const Config& config) {
+  AiTuning tuning;
+  tuning.min_time_between_actions = config.ai_minimum_time_between_actions();
+  tuning.max_time_between_actions = config.ai_maximum_time_between_actions();
+  tuning.chance_to_block = config.ai_chance_to_block();
+  tuning.chance_to_change_aim = config.ai_chance_to_change_aim();
+  tuning.chance_to_throw = config.ai_chance_to_throw();
+  tuning.block_min_duration = config.ai_block_min_duration();
+  tuning.block_max_duration = config.ai_block_max_duration();
+  return tuning;
+}
+
 AiController::AiController() : Controller(kTypeAI) {}
 
 void AiController::Initialize(GameState* gamestate, const Config* config,
                               CharacterId character_id) {
   gamestate_ = gamestate;
   config_ = config;
+  tuning_ = AiTuning::FromConfig(*config);
   character_id_ = character_id;
+  Seed(0);
   time_to_next_action_ = 0;
   block_timer_ = 0;
+  acted_this_frame_ = false;
 }
 
 void AiController::AdvanceFrame(WorldTime delta_time) {
@@ -36,59 +51,72 @@ void AiController::AdvanceFrame(WorldTime delta_time) {
     return;
   }
   ClearAllLogicalInputs();
+  acted_this_frame_ = false;
   time_to_next_action_ -= delta_time;
 
   // Check to make sure we're valid to be sending input.
-  const Character* character = gamestate_->characters()[character_id_].get();
-  auto character_state = character->State();
-  if (character->health() <= 0 || character_state == StateId_KO ||
-      character_state == StateId_Joining ||
-      character_state == StateId_Jumping) {
-    return;
-  }
+  if (!gamestate_->characters()[character_id_]->CanAct()) return;
 
   // if we're blocking, keep blocking.
   if (block_timer_ > 0) {
     block_timer_ -= delta_time;
     SetLogicalInputs(LogicalInputs_Deflect, true);
+    acted_this_frame_ = true;
     return;
   }
 
   if (time_to_next_action_ > 0) return;
 
-  time_to_next_action_ = mathfu::RandomInRange<WorldTime>(
-      config_->ai_minimum_time_between_actions(),
-      config_->ai_maximum_time_between_actions());
+  time_to_next_action_ = RandomTime(tuning_.min_time_between_actions,
+                                    tuning_.max_time_between_actions);
 
-  float action = mathfu::Random<float>();
-  if (action < config_->ai_chance_to_change_aim()) {
-    if (action < config_->ai_chance_to_change_aim() / 2) {
+  float action = RandomChance();
+  if (action < tuning_.chance_to_change_aim) {
+    if (action < tuning_.chance_to_change_aim / 2) {
       SetLogicalInputs(LogicalInputs_Left, true);
     } else {
       SetLogicalInputs(LogicalInputs_Right, true);
     }
   }
-  action -= config_->ai_chance_to_change_aim();
-  if (action >= 0 && action < config_->ai_chance_to_throw()) {
+  action -= tuning_.chance_to_change_aim;
+  if (action >= 0 && action < tuning_.chance_to_throw) {
     SetLogicalInputs(LogicalInputs_ThrowPie, true);
   }  // else do nothing.
 
-  if (!gamestate_->is_in_cardboard() && IsInDanger(character_id_) &&
-      mathfu::Random<float>() < config_->ai_chance_to_block()) {
-    block_timer_ = mathfu::RandomInRange<WorldTime>(
-        config_->ai_block_min_duration(), config_->ai_block_max_duration());
+  if (!gamestate_->is_in_cardboard() &&
+      gamestate_->perception().IsInDanger(character_id_) &&
+      RandomChance() < tuning_.chance_to_block) {
+    block_timer_ = RandomTime(tuning_.block_min_duration,
+                              tuning_.block_max_duration);
     SetLogicalInputs(LogicalInputs_Deflect, true);
   }
+  // Only our own inputs have been set since they were cleared.
+  acted_this_frame_ = is_down_ != 0;
 }
 
-// Utility function for checking if someone is in danger.
-bool AiController::IsInDanger(CharacterId id) const {
-  for (size_t i = 0; i < gamestate_->pies().size(); i++) {
-    if (gamestate_->pies()[i]->target() == id) {
-      return true;
-    }
+WorldTime AiController::TimeUntilInput() const {
+  if (character_id_ == kNoCharacter) return kNoPendingInput;
+  // Inputs set last frame are cleared on the next.
+  if (acted_this_frame_) return 0;
+  if (!gamestate_->characters()[character_id_]->CanAct()) {
+    return kNoPendingInput;
   }
-  return false;
+  if (block_timer_ > 0) return 0;
+  return std::max(time_to_next_action_, 0);
+}
+
+void AiController::Seed(uint32_t seed) {
+  std::seed_seq sequence = {seed, static_cast<uint32_t>(character_id_)};
+  random_.seed(sequence);
+}
+
+float AiController::RandomChance() {
+  return std::uniform_real_distribution<float>(0.0f, 1.0f)(random_);
+}
+
+WorldTime AiController::RandomTime(WorldTime min_time, WorldTime max_time) {
+  return std::uniform_int_distribution<WorldTime>(
+      min_time, std::max(min_time, max_time))(random_);
 }
 
 }  // pie_noon
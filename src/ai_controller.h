@@ -17,6 +17,7 @@
 
 #include "precompiled.h"
 
+#include <random>
 #include <vector>
 
 #include "audio_config_generated.h"
@@ -31,6 +32,23 @@
 namespace fpl {
 namespace pie_noon {
 
+// The knobs that shape how an AiController plays. Normally they come from
+// the config, but tools that tune them can hand in their own.
+struct AiTuning {
+  static AiTuning FromConfig(const Config& config);
+
+  // Variance for how long AI players go without acting.
+  WorldTime min_time_between_actions;
+  WorldTime max_time_between_actions;
+  // Chances (0-1) of each action when they act.
+  float chance_to_block;
+  float chance_to_change_aim;
+  float chance_to_throw;
+  // How long they block for.
+  WorldTime block_min_duration;
+  WorldTime block_max_duration;
+};
+
 // A computer-controlled player.  Basically the same as PlayerController,
 // except that instead of generating logical inputs based on events,
 // this generates inputs based on random numbers and the current game state.
@@ -38,20 +56,40 @@ class AiController : public Controller {
  public:
   AiController();
 
-  // Give the AI everything it will need.
-  void Initialize(GameState* gamestate_ptr, const Config* config,
-                  int characterId);
+  // Give the AI everything it will need. Takes its tuning from 'config'.
+  virtual void Initialize(GameState* gamestate_ptr, const Config* config,
+                          int characterId);
+
+  // Start a new random sequence, mixed with our character id so that the
+  // AIs in one game don't all make the same choices. Initialize() seeds
+  // with 0, so a game is repeatable unless it's given other seeds.
+  void Seed(uint32_t seed);
+
+  void set_tuning(const AiTuning& tuning) { tuning_ = tuning; }
+  const AiTuning& tuning() const { return tuning_; }
 
   // Decide what the robot is doing this frame.
   virtual void AdvanceFrame(WorldTime delta_time);
 
+  virtual WorldTime TimeUntilInput() const;
+
  private:
-  bool IsInDanger(CharacterId id) const;
   WorldTime block_timer_;  // How many milliseconds we need to block.
+  bool acted_this_frame_;  // Whether we set any inputs last AdvanceFrame.
+
+  // A random number in [0, 1).
+  float RandomChance();
+  // A random time in [min_time, max_time].
+  WorldTime RandomTime(WorldTime min_time, WorldTime max_time);
 
   GameState* gamestate_;  // Pointer to the gamestate object
   const Config* config_;  // Pointer to the config structure
+  AiTuning tuning_;
   WorldTime time_to_next_action_;
+
+  // Each AI has its own generator, so AIs running on different threads
+  // never share a sequence, as they would with rand().
+  std::minstd_rand random_;
 };
 
 }  // pie_noon
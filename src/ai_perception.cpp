@@ -0,0 +1,117 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include <limits>
+
+#include "ai_perception.h"
+
+namespace fpl {
+namespace pie_noon {
+
+const WorldTime AiPerception::kNoImpact = std::numeric_limits<WorldTime>::max();
+
+// Sort 'ids' so that the best 'values' come first, with ties in id order.
+template <class Better>
+static void Rank(const std::vector<CharacterHealth>& values, Better better,
+                 std::vector<CharacterId>* ids) {
+  std::sort(ids->begin(), ids->end(),
+            [&values, &better](CharacterId a, CharacterId b) {
+    return better(values[a], values[b]) || (values[a] == values[b] && a < b);
+  });
+}
+
+void AiPerception::Update(
+    const std::vector<std::unique_ptr<Character>>& characters,
+    const std::vector<std::unique_ptr<AirbornePie>>& pies, WorldTime time) {
+  const size_t num_characters = characters.size();
+  bool changed = num_characters != threats_.size();
+  time_ = time;
+  threats_.swap(previous_threats_);
+  threats_.resize(num_characters);
+  health_.resize(num_characters);
+  pie_damage_.resize(num_characters);
+  by_largest_pie_.clear();
+  for (size_t i = 0; i < num_characters; ++i) {
+    const Character& character = *characters[i];
+    Threat& threat = threats_[i];
+    threat.num_pies = 0;
+    threat.damage = 0;
+    threat.impact_time = kNoImpact;
+    threat.valid = character.health() > 0;
+    changed = changed || health_[i] != character.health() ||
+              pie_damage_[i] != character.pie_damage();
+    health_[i] = character.health();
+    pie_damage_[i] = character.pie_damage();
+    if (threat.valid) {
+      by_largest_pie_.push_back(static_cast<CharacterId>(i));
+    }
+  }
+
+  for (auto it = pies.begin(); it != pies.end(); ++it) {
+    const AirbornePie& pie = **it;
+    Threat& threat = threats_[pie.target()];
+    threat.num_pies++;
+    threat.damage += pie.damage();
+    threat.impact_time =
+        std::min(threat.impact_time, pie.start_time() + pie.flight_time());
+  }
+  changed = changed || threats_ != previous_threats_;
+  if (changed) generation_++;
+
+  by_lowest_health_ = by_largest_pie_;
+  by_highest_health_ = by_largest_pie_;
+  Rank(pie_damage_, std::greater<CharacterHealth>(), &by_largest_pie_);
+  Rank(health_, std::less<CharacterHealth>(), &by_lowest_health_);
+  Rank(health_, std::greater<CharacterHealth>(), &by_highest_health_);
+}
+
+void AiPerception::AppendBest(const std::vector<CharacterId>& ranking,
+                              const std::vector<CharacterHealth>& values,
+                              CharacterId self,
+                              std::vector<CharacterId>* targets) {
+  auto it = ranking.begin();
+  if (it != ranking.end() && *it == self) ++it;
+  if (it == ranking.end()) return;
+  const CharacterHealth best = values[*it];
+  for (; it != ranking.end() && values[*it] == best; ++it) {
+    if (*it != self) targets->push_back(*it);
+  }
+}
+
+void AiPerception::LargestPieTargets(CharacterId self,
+                                     std::vector<CharacterId>* targets) const {
+  AppendBest(by_largest_pie_, pie_damage_, self, targets);
+}
+
+void AiPerception::LowestHealthTargets(
+    CharacterId self, std::vector<CharacterId>* targets) const {
+  AppendBest(by_lowest_health_, health_, self, targets);
+}
+
+void AiPerception::HighestHealthTargets(
+    CharacterId self, std::vector<CharacterId>* targets) const {
+  AppendBest(by_highest_health_, health_, self, targets);
+}
+
+void AiPerception::AllTargets(CharacterId self,
+                              std::vector<CharacterId>* targets) const {
+  for (size_t i = 0; i < threats_.size(); ++i) {
+    const CharacterId id = static_cast<CharacterId>(i);
+    if (id != self && threats_[i].valid) targets->push_back(id);
+  }
+}
+
+}  // pie_noon
+}  // fpl
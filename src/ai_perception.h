@@ -0,0 +1,119 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AI_PERCEPTION_H
+#define AI_PERCEPTION_H
+
+#include <memory>
+#include <vector>
+#include "character.h"
+
+namespace fpl {
+namespace pie_noon {
+
+// What the computer players know about the game, gathered once per frame by
+// GameState so that each AI doesn't have to scan every pie and character
+// for itself. Read-only to everything except GameState.
+class AiPerception {
+ public:
+  // Time to impact of a character with no pies heading its way.
+  static const WorldTime kNoImpact;
+
+  AiPerception() : time_(0), generation_(0) {}
+
+  // Rebuild from the current state of the game. Cost is linear in the
+  // number of pies, plus sorting the characters.
+  void Update(const std::vector<std::unique_ptr<Character>>& characters,
+              const std::vector<std::unique_ptr<AirbornePie>>& pies,
+              WorldTime time);
+
+  // Number of pies heading for 'id'.
+  int incoming_pies(CharacterId id) const { return threats_[id].num_pies; }
+
+  // Total damage of the pies heading for 'id'.
+  CharacterHealth incoming_damage(CharacterId id) const {
+    return threats_[id].damage;
+  }
+
+  // Milliseconds until the first pie heading for 'id' lands, or kNoImpact.
+  WorldTime time_to_impact(CharacterId id) const {
+    const WorldTime impact = threats_[id].impact_time;
+    return impact == kNoImpact ? kNoImpact : impact - time_;
+  }
+
+  CharacterHealth health(CharacterId id) const { return health_[id]; }
+  CharacterHealth pie_damage(CharacterId id) const { return pie_damage_[id]; }
+
+  bool IsInDanger(CharacterId id) const { return incoming_pies(id) > 0; }
+
+  // Characters that can still be hit, i.e. have health left.
+  bool IsValidTarget(CharacterId id) const { return threats_[id].valid; }
+
+  // Each of these appends to 'targets', in id order, the valid targets
+  // other than 'self' that share the best value of the ranking. Nothing is
+  // appended if there are no such targets.
+  void LargestPieTargets(CharacterId self,
+                         std::vector<CharacterId>* targets) const;
+  void LowestHealthTargets(CharacterId self,
+                           std::vector<CharacterId>* targets) const;
+  void HighestHealthTargets(CharacterId self,
+                            std::vector<CharacterId>* targets) const;
+  // Every valid target other than 'self'.
+  void AllTargets(CharacterId self, std::vector<CharacterId>* targets) const;
+
+  // Bumped by Update() whenever anything above changes other than the
+  // passing of time. AIs that only react to what they perceive can skip
+  // deciding while this stays the same.
+  uint32_t generation() const { return generation_; }
+
+ private:
+  struct Threat {
+    bool operator==(const Threat& rhs) const {
+      return num_pies == rhs.num_pies && damage == rhs.damage &&
+             impact_time == rhs.impact_time && valid == rhs.valid;
+    }
+
+    int num_pies;
+    CharacterHealth damage;
+    // When the first pie lands, or kNoImpact.
+    WorldTime impact_time;
+    bool valid;
+  };
+
+  // Append the targets at the front of 'ranking' (skipping 'self') whose
+  // value matches the first one's.
+  static void AppendBest(const std::vector<CharacterId>& ranking,
+                         const std::vector<CharacterHealth>& values,
+                         CharacterId self, std::vector<CharacterId>* targets);
+
+  WorldTime time_;
+  uint32_t generation_;
+
+  // Indexed by CharacterId. previous_threats_ holds last Update()'s
+  // threats_, to tell whether anything changed.
+  std::vector<Threat> threats_;
+  std::vector<Threat> previous_threats_;
+  std::vector<CharacterHealth> health_;
+  std::vector<CharacterHealth> pie_damage_;
+
+  // Valid targets, best first. Ties are in id order.
+  std::vector<CharacterId> by_largest_pie_;
+  std::vector<CharacterId> by_lowest_health_;
+  std::vector<CharacterId> by_highest_health_;
+};
+
+}  // pie_noon
+}  // fpl
+
+#endif  // AI_PERCEPTION_H
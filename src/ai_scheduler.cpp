@@ -0,0 +1,101 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+
+#include "ai_scheduler.h"
+#include "controller.h"
+#include "game_state.h"
+#include "worker_pool.h"
+
+namespace fpl {
+namespace pie_noon {
+
+AiScheduler::AiScheduler()
+    : game_state_(nullptr), worker_pool_(nullptr), min_parallel_batch_(0) {}
+
+void AiScheduler::Initialize(const GameState* game_state,
+                             int min_parallel_batch) {
+  game_state_ = game_state;
+  min_parallel_batch_ = min_parallel_batch;
+  entries_.clear();
+  awake_.clear();
+}
+
+void AiScheduler::AddController(Controller* controller) {
+  Entry entry = Entry();
+  entry.controller = controller;
+  entry.has_run = false;
+  entries_.push_back(entry);
+}
+
+bool AiScheduler::IsAwake(const Entry& entry) const {
+  if (!entry.has_run || entry.asleep_time >= entry.time_until_input) {
+    return true;
+  }
+  const CharacterId id = entry.controller->character_id();
+  if (id != entry.character_id) return true;
+  if (id == kNoCharacter) return false;
+  const Character& character = *game_state_->characters()[id];
+  return character.State() != entry.state ||
+         character.health() != entry.health ||
+         character.target() != entry.target ||
+         game_state_->perception().generation() !=
+             entry.perception_generation;
+}
+
+void AiScheduler::Remember(Entry* entry) const {
+  entry->asleep_time = 0;
+  entry->time_until_input = entry->controller->TimeUntilInput();
+  entry->has_run = true;
+  const CharacterId id = entry->controller->character_id();
+  entry->character_id = id;
+  if (id == kNoCharacter) return;
+  const Character& character = *game_state_->characters()[id];
+  entry->state = character.State();
+  entry->health = character.health();
+  entry->target = character.target();
+  entry->perception_generation = game_state_->perception().generation();
+}
+
+void AiScheduler::AdvanceFrame(WorldTime delta_time) {
+  awake_.clear();
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    Entry& entry = entries_[i];
+    entry.asleep_time += delta_time;
+    if (IsAwake(entry)) {
+      awake_.push_back(static_cast<int>(i));
+    } else if (entry.controller->character_id() != kNoCharacter) {
+      entry.controller->ClearAllLogicalInputs();
+    }
+  }
+
+  const int num_awake = static_cast<int>(awake_.size());
+  const auto run = [this](int i) {
+    Entry& entry = entries_[awake_[i]];
+    entry.controller->AdvanceFrame(entry.asleep_time);
+  };
+  if (worker_pool_ != nullptr && num_awake >= min_parallel_batch_) {
+    worker_pool_->ParallelFor(num_awake, run);
+  } else {
+    for (int i = 0; i < num_awake; ++i) run(i);
+  }
+
+  for (auto it = awake_.begin(); it != awake_.end(); ++it) {
+    Remember(&entries_[*it]);
+  }
+}
+
+}  // pie_noon
+}  // fpl
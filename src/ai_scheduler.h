@@ -0,0 +1,99 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AI_SCHEDULER_H
+#define AI_SCHEDULER_H
+
+#include <vector>
+#include "character.h"
+#include "common.h"
+
+namespace fpl {
+
+class WorkerPool;
+
+namespace pie_noon {
+
+class Controller;
+class GameState;
+
+// Updates the computer players' controllers, but only the ones that have
+// something to do.
+//
+// A controller is woken when the time it gave from TimeUntilInput() has
+// passed, or when something it might react to has changed: which
+// character it controls, that character's state, health or target, or the
+// AiPerception. Woken
+// controllers get one AdvanceFrame() covering all the time they slept, so
+// timers come out the same as if they'd run every frame. Sleeping ones
+// just have their inputs cleared, as a frame with nothing to do would.
+//
+// The woken controllers run as one batch, which is shared out across the
+// worker threads once it is big enough. Controllers must then only read
+// the game and write to themselves in AdvanceFrame(). Other controllers'
+// inputs are written during the batch, so a controller that needs all of
+// them must be given a copy taken before AdvanceFrame() is called.
+//
+// A sleeping controller's TimeUntilInput() is as of when it last ran, so
+// don't combine this with GameState::SkipIdleFrames().
+class AiScheduler {
+ public:
+  AiScheduler();
+
+  void Initialize(const GameState* game_state, int min_parallel_batch);
+
+  // Threads to run big batches on. May be null, and must outlive us.
+  void set_worker_pool(WorkerPool* worker_pool) { worker_pool_ = worker_pool; }
+
+  // Take over calling AdvanceFrame() on 'controller', which we don't own.
+  void AddController(Controller* controller);
+
+  // Run the controllers that need to run this frame. Call where the
+  // controllers would otherwise have been advanced.
+  void AdvanceFrame(WorldTime delta_time);
+
+  // How many controllers ran in the last AdvanceFrame().
+  int num_awake() const { return static_cast<int>(awake_.size()); }
+
+ private:
+  struct Entry {
+    Controller* controller;
+    // Time passed since the controller last ran.
+    WorldTime asleep_time;
+    // Its TimeUntilInput() when it last ran.
+    WorldTime time_until_input;
+    // What the controller could see when it last ran.
+    bool has_run;
+    CharacterId character_id;
+    uint16_t state;
+    CharacterHealth health;
+    CharacterId target;
+    uint32_t perception_generation;
+  };
+
+  bool IsAwake(const Entry& entry) const;
+  void Remember(Entry* entry) const;
+
+  const GameState* game_state_;
+  WorkerPool* worker_pool_;
+  int min_parallel_batch_;
+  std::vector<Entry> entries_;
+  // Indices into entries_ of the controllers to run this frame.
+  std::vector<int> awake_;
+};
+
+}  // pie_noon
+}  // fpl
+
+#endif  // AI_SCHEDULER_H
@@ -18,6 +18,8 @@
 #include "character.h"
 #include "character_state_machine.h"
 #include "character_state_machine_def_generated.h"
+#include "controller.h"
+#include "game_state_snapshot.h"
 #include "motive/init.h"
 #include "motive/io/flatbuffers.h"
 #include "motive/util.h"
@@ -31,15 +33,10 @@ using mathfu::vec3;
 using mathfu::vec4;
 using mathfu::mat4;
 using motive::Angle;
-using motive::kPi;
-using motive::kTwoPi;
-using motive::Range;
 
 namespace fpl {
 namespace pie_noon {
 
-static const float kMaxPosition = 20.0f;
-
 Character::Character(
     CharacterId id, Controller* controller, const Config& config,
     const CharacterStateMachineDef* character_state_machine_def)
@@ -128,70 +125,146 @@ mathfu::vec4 Character::ButtonColor() const {
   return vec4(color, 1.0);
 }
 
+void Character::SaveSnapshot(CharacterSnapshot* snapshot) const {
+  snapshot->target = target_;
+  snapshot->health = health_;
+  snapshot->pie_damage = pie_damage_;
+  snapshot->position[0] = position_.x();
+  snapshot->position[1] = position_.y();
+  snapshot->position[2] = position_.z();
+  snapshot->face_angle = face_angle_.Value();
+  snapshot->face_angle_velocity = face_angle_.Velocity();
+  snapshot->state = State();
+  snapshot->state_start_time = state_machine_.current_state_start_time();
+  snapshot->state_last_update = state_last_update_;
+  snapshot->just_joined_game = just_joined_game_;
+  snapshot->visible = visible_;
+  snapshot->score = score_;
+  snapshot->victory_state = victory_state_;
+  snapshot->is_down = controller_->is_down();
+  snapshot->went_down = controller_->went_down();
+  snapshot->went_up = controller_->went_up();
+  for (int i = 0; i < kMaxStats; i++) {
+    snapshot->player_stats[i] = player_stats_[i];
+  }
+}
+
+bool Character::CanAct() const {
+  const uint16_t state = State();
+  return !(health_ <= 0 || state == StateId_KO || state == StateId_Joining ||
+           state == StateId_Jumping);
+}
+
+bool Character::IsValidSnapshot(const CharacterSnapshot& snapshot,
+                                CharacterId num_characters) {
+  // The state machine definition has exactly one state per StateId, in
+  // order; see CharacterStateMachineDef_Validate().
+  return snapshot.target >= 0 && snapshot.target < num_characters &&
+         snapshot.state >= 0 && snapshot.state < StateId_Count &&
+         snapshot.victory_state >= kResultUnknown &&
+         snapshot.victory_state <= kFailure;
+}
+
+void Character::RestoreSnapshot(const CharacterSnapshot& snapshot,
+                                motive::MotiveEngine* engine) {
+  // Callers should check IsValidSnapshot() first. The target can't be
+  // checked here, since a Character doesn't know how many others there are.
+  if (snapshot.state < 0 || snapshot.state >= StateId_Count ||
+      snapshot.victory_state < kResultUnknown ||
+      snapshot.victory_state > kFailure) {
+    fplbase::LogError(fplbase::kApplication,
+                      "Character snapshot has an invalid state.\n");
+    return;
+  }
+  target_ = snapshot.target;
+  health_ = snapshot.health;
+  pie_damage_ = snapshot.pie_damage;
+  position_ = vec3(snapshot.position[0], snapshot.position[1],
+                   snapshot.position[2]);
+  state_machine_.SetCurrentState(snapshot.state, snapshot.state_start_time);
+  state_last_update_ = snapshot.state_last_update;
+  just_joined_game_ = snapshot.just_joined_game != 0;
+  visible_ = snapshot.visible != 0;
+  score_ = snapshot.score;
+  victory_state_ = static_cast<VictoryState>(snapshot.victory_state);
+  controller_->RestoreLogicalInputs(snapshot.is_down, snapshot.went_down,
+                                    snapshot.went_up);
+  for (int i = 0; i < kMaxStats; i++) {
+    player_stats_[i] = snapshot.player_stats[i];
+  }
+
+  // The target angle isn't saved. GameState::AdvanceFrame sets it again
+  // before the engine next moves the Motivator.
+  motive::OvershootInit init;
+  OvershootInitFromFlatBuffers(*config_->face_angle_def(), &init);
+  face_angle_.InitializeWithTarget(
+      init, engine,
+      motive::Current1f(snapshot.face_angle, snapshot.face_angle_velocity));
+}
+
 void Character::IncrementStat(PlayerStats stat) { player_stats_[stat]++; }
 
 void Character::ResetStats() {
   for (int i = 0; i < kMaxStats; i++) player_stats_[i] = 0;
 }
 
-// orientation_ and position_ are set each frame in GameState::Advance.
+// matrix_ is set each frame in GameState::AdvanceFrame.
 AirbornePie::AirbornePie(CharacterId original_source, const Character& source,
                          const Character& target, WorldTime start_time,
                          WorldTime flight_time, CharacterHealth original_damage,
                          CharacterHealth damage, float start_height,
-                         float peak_height, int rotations, float y_rotation,
-                         motive::MotiveEngine* engine)
+                         float peak_height, int rotations, float y_rotation)
     : original_source_(original_source),
       source_(source.id()),
       target_(target.id()),
       start_time_(start_time),
       flight_time_(flight_time),
       original_damage_(original_damage),
-      damage_(damage) {
-  // x,z positions are within a reasonable bound.
-  // Rotations are anglular values.
-  const motive::SplineInit position_init(Range(-kMaxPosition, kMaxPosition),
-                                         false);
-  const motive::SplineInit rotation_init(Range(-kPi, kPi), true);
-
-  // Move x,z at constant speed from source to target.
-  const motive::MotiveTarget1f x_target(motive::CurrentToTargetConstVelocity1f(
-      source.position().x(), target.position().x(), flight_time));
-  const motive::MotiveTarget1f z_target(motive::CurrentToTargetConstVelocity1f(
-      source.position().z(), target.position().z(), flight_time));
-
-  // Move y along a trajectory that starts and ends at 'start_height' and
-  // tops out at 'peak_height' half way through.
-  // Since deceleration is constant, and velocity at the peak is zero,
-  // the average velocity from start to peak is,
-  //       0.5(start_velocity + 0)
-  //
-  // At peak, height is average velocity times travel time, so
-  //       peak_height = 0.5(start_velocity + 0)*peak_time
-  // Which implies,
-  //    start_velocity = 2 * delta_height / peak_time
-  const float peak_time = 0.5f * flight_time;
-  const float delta_height = peak_height - start_height;
-  const float start_velocity = 2.0f * delta_height / peak_time;
-  const motive::MotiveTarget1f y_target(motive::CurrentToTargetToTarget1f(
-      start_height, start_velocity,                  // Initial node.
-      peak_height, 0.0f, peak_time,                  // Peak node.
-      start_height, -start_velocity, flight_time));  // End node.
-
-  // The pie rotates top to bottom a fixed number of times. Rotation speed
-  // is constant.
-  const motive::MotiveTarget1f z_rotation_target(
-      motive::CurrentToTargetConstVelocity1f(0.0f, rotations * kTwoPi,
-                                             flight_time));
-
-  motive::MatrixOpArray ops(5);
-  ops.AddOp(motive::kTranslateX, position_init, x_target);
-  ops.AddOp(motive::kTranslateY, position_init, y_target);
-  ops.AddOp(motive::kTranslateZ, position_init, z_target);
-  ops.AddOp(motive::kRotateAboutY, y_rotation);
-  ops.AddOp(motive::kRotateAboutZ, rotation_init, z_rotation_target);
-  motive::MatrixInit init(ops);
-  motivator_.Initialize(init, engine);
+      damage_(damage),
+      source_position_(source.position()),
+      target_position_(target.position()),
+      start_height_(start_height),
+      peak_height_(peak_height),
+      rotations_(rotations),
+      y_rotation_(y_rotation),
+      matrix_(mat4::Identity()) {}
+
+AirbornePie::AirbornePie(const AirbornePieSnapshot& snapshot)
+    : original_source_(snapshot.original_source),
+      source_(snapshot.source),
+      target_(snapshot.target),
+      start_time_(snapshot.start_time),
+      flight_time_(snapshot.flight_time),
+      original_damage_(snapshot.original_damage),
+      damage_(snapshot.damage),
+      source_position_(snapshot.source_position[0],
+                       snapshot.source_position[1],
+                       snapshot.source_position[2]),
+      target_position_(snapshot.target_position[0],
+                       snapshot.target_position[1],
+                       snapshot.target_position[2]),
+      start_height_(snapshot.start_height),
+      peak_height_(snapshot.peak_height),
+      rotations_(snapshot.rotations),
+      y_rotation_(snapshot.y_rotation),
+      matrix_(mat4::Identity()) {}
+
+void AirbornePie::SaveSnapshot(AirbornePieSnapshot* snapshot) const {
+  snapshot->original_source = original_source_;
+  snapshot->source = source_;
+  snapshot->target = target_;
+  snapshot->start_time = start_time_;
+  snapshot->flight_time = flight_time_;
+  snapshot->original_damage = original_damage_;
+  snapshot->damage = damage_;
+  for (int i = 0; i < 3; ++i) {
+    snapshot->source_position[i] = source_position_[i];
+    snapshot->target_position[i] = target_position_[i];
+  }
+  snapshot->start_height = start_height_;
+  snapshot->peak_height = peak_height_;
+  snapshot->rotations = rotations_;
+  snapshot->y_rotation = y_rotation_;
 }
 
 void ApplyScoringRule(const ScoringRules* scoring_rules, ScoreEvent event,
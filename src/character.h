@@ -33,6 +33,8 @@ namespace fpl {
 namespace pie_noon {
 
 class Controller;
+struct AirbornePieSnapshot;
+struct CharacterSnapshot;
 
 typedef int CharacterHealth;
 
@@ -110,6 +112,10 @@ class Character {
   // Returns true if the character is still in the game.
   bool Active() const { return State() != StateId_KO; }
 
+  // Returns true if the character is alive, in the game and on the ground,
+  // so its controller's inputs will do something.
+  bool CanAct() const;
+
   // Play a sound associated with this character.
   void PlaySound(const char* sound) const;
 
@@ -155,6 +161,21 @@ class Character {
   bool visible() const { return visible_; }
   void set_visible(bool visible) { visible_ = visible; }
 
+  // Copy everything that changes during a game into 'snapshot'. The
+  // controller's logical inputs are included; the controller itself isn't.
+  void SaveSnapshot(CharacterSnapshot* snapshot) const;
+
+  // True if every index in 'snapshot' is in range for a game with
+  // 'num_characters' characters, so that it's safe to restore. Snapshots can
+  // be assigned from any bytes, so check before calling RestoreSnapshot().
+  static bool IsValidSnapshot(const CharacterSnapshot& snapshot,
+                              CharacterId num_characters);
+
+  // Return to the state recorded by SaveSnapshot(). The face angle Motivator
+  // is reinitialized in 'engine' with its saved value and velocity.
+  void RestoreSnapshot(const CharacterSnapshot& snapshot,
+                       motive::MotiveEngine* engine);
+
  private:
   // Constant configuration data.
   const Config* config_;
@@ -204,13 +225,21 @@ class Character {
   bool visible_;
 };
 
+// A pie in flight. Its matrix is calculated for all pies at once by
+// PieTrajectoryBatch, from the launch parameters below.
 class AirbornePie {
  public:
   AirbornePie(CharacterId original_source, const Character& source,
               const Character& target, WorldTime start_time,
               WorldTime flight_time, CharacterHealth original_damage,
               CharacterHealth damage, float start_height, float peak_height,
-              int rotations, float y_rotation, motive::MotiveEngine* engine);
+              int rotations, float y_rotation);
+
+  // Recreate a pie from its saved launch parameters. The pie continues along
+  // the same path it was on when saved.
+  explicit AirbornePie(const AirbornePieSnapshot& snapshot);
+
+  void SaveSnapshot(AirbornePieSnapshot* snapshot) const;
 
   CharacterId original_source() const { return original_source_; }
   CharacterId source() const { return source_; }
@@ -219,8 +248,16 @@ class AirbornePie {
   WorldTime flight_time() const { return flight_time_; }
   CharacterHealth original_damage() const { return original_damage_; }
   CharacterHealth damage() const { return damage_; }
-  const mathfu::mat4& Matrix() const { return motivator_.Value(); }
-  mathfu::vec3 Position() const { return motivator_.Position(); }
+  const mathfu::vec3& source_position() const { return source_position_; }
+  const mathfu::vec3& target_position() const { return target_position_; }
+  float start_height() const { return start_height_; }
+  float peak_height() const { return peak_height_; }
+  int rotations() const { return rotations_; }
+  float y_rotation() const { return y_rotation_; }
+
+  const mathfu::mat4& Matrix() const { return matrix_; }
+  mathfu::vec3 Position() const { return matrix_.TranslationVector3D(); }
+  void set_matrix(const mathfu::mat4& matrix) { matrix_ = matrix; }
 
  private:
   CharacterId original_source_;
@@ -230,7 +267,17 @@ class AirbornePie {
   WorldTime flight_time_;
   CharacterHealth original_damage_;
   CharacterHealth damage_;
-  motive::MatrixMotivator4f motivator_;
+
+  // Launch parameters. The whole flight path follows from these.
+  mathfu::vec3 source_position_;
+  mathfu::vec3 target_position_;
+  float start_height_;
+  float peak_height_;
+  int rotations_;
+  float y_rotation_;
+
+  // Where the pie was when PieTrajectoryBatch last evaluated it.
+  mathfu::mat4 matrix_;
 };
 
 // Return index of first item with time >= t.
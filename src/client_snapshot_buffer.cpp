@@ -0,0 +1,104 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+
+#include "client_snapshot_buffer.h"
+
+namespace fpl {
+namespace pie_noon {
+
+// The host's game clock can run slower than ours (its frames are clamped to a
+// maximum update time), so let the clock offset creep up by this much per
+// snapshot. Otherwise one unusually quick message would pin it forever.
+static const WorldTime kClockOffsetRelaxation = 1;
+
+ClientSnapshotBuffer::ClientSnapshotBuffer() { Reset(); }
+
+void ClientSnapshotBuffer::Reset() {
+  oldest_ = 0;
+  count_ = 0;
+  clock_offset_ = 0;
+}
+
+bool ClientSnapshotBuffer::AddSnapshot(WorldTime host_time,
+                                       WorldTime receive_time,
+                                       const std::vector<uint8_t>& health,
+                                       const std::vector<uint8_t>& splats) {
+  if (count_ > 0) {
+    const Snapshot& newest = snapshots_[Index(count_ - 1)];
+    if (host_time < newest.host_time) return false;
+  }
+
+  const WorldTime offset = receive_time - host_time;
+  clock_offset_ = count_ == 0 ? offset
+                              : std::min(clock_offset_ + kClockOffsetRelaxation,
+                                         offset);
+
+  if (count_ == kMaxSnapshots) {
+    // Overwrite the oldest.
+    oldest_ = (oldest_ + 1) % kMaxSnapshots;
+    count_--;
+  }
+  Snapshot& snapshot = snapshots_[Index(count_)];
+  snapshot.host_time = host_time;
+  snapshot.health = health;
+  snapshot.splats = splats;
+  count_++;
+  return true;
+}
+
+bool ClientSnapshotBuffer::Sample(WorldTime now, WorldTime interpolation_delay,
+                                  std::vector<float>* health,
+                                  std::vector<uint8_t>* splats) const {
+  if (count_ == 0) return false;
+
+  const WorldTime target = now - clock_offset_ - interpolation_delay;
+
+  // Find the last snapshot at or before 'target'.
+  int before = 0;
+  while (before + 1 < count_ &&
+         snapshots_[Index(before + 1)].host_time <= target) {
+    before++;
+  }
+  const Snapshot& a = snapshots_[Index(before)];
+  const Snapshot& b = snapshots_[Index(std::min(before + 1, count_ - 1))];
+
+  float t = 0.0f;
+  if (b.host_time > a.host_time) {
+    t = static_cast<float>(target - a.host_time) /
+        static_cast<float>(b.host_time - a.host_time);
+    t = mathfu::Clamp(t, 0.0f, 1.0f);
+  } else if (target >= a.host_time) {
+    // Past the newest snapshot. Hold it rather than guess.
+    t = 1.0f;
+  }
+
+  health->resize(a.health.size());
+  for (size_t i = 0; i < a.health.size(); ++i) {
+    const float to = i < b.health.size() ? b.health[i] : a.health[i];
+    (*health)[i] = mathfu::Lerp(static_cast<float>(a.health[i]), to, t);
+  }
+  *splats = t >= 1.0f ? b.splats : a.splats;
+  return true;
+}
+
+void ClientSnapshotBuffer::DiscardAllButNewest() {
+  if (count_ == 0) return;
+  oldest_ = Index(count_ - 1);
+  count_ = 1;
+}
+
+}  // pie_noon
+}  // fpl
@@ -0,0 +1,84 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLIENT_SNAPSHOT_BUFFER_H
+#define CLIENT_SNAPSHOT_BUFFER_H
+
+#include <vector>
+#include "common.h"
+
+namespace fpl {
+namespace pie_noon {
+
+// Holds the last few player status snapshots a multiscreen client has
+// received from the host, and samples them a little in the past so the
+// display moves smoothly from one snapshot to the next instead of jumping
+// whenever a message arrives late.
+//
+// Snapshots are stamped with the host's game time. The client never sees the
+// host's clock directly, so we estimate the offset between the two clocks
+// from the snapshots that arrived fastest.
+class ClientSnapshotBuffer {
+ public:
+  ClientSnapshotBuffer();
+
+  // Forget every snapshot. Call at the start of each game.
+  void Reset();
+
+  // Record a snapshot stamped 'host_time' that arrived at 'receive_time' on
+  // our clock. Returns false, and ignores the snapshot, if it is older than
+  // one we already have (unreliable messages can arrive out of order).
+  bool AddSnapshot(WorldTime host_time, WorldTime receive_time,
+                   const std::vector<uint8_t>& health,
+                   const std::vector<uint8_t>& splats);
+
+  // Calculate player health and splats as of 'interpolation_delay' before
+  // 'now' (on our clock). Health is blended between the two snapshots either
+  // side of that time. Splats are bitmasks, so they come from the earlier of
+  // the two. Never extrapolates past the newest snapshot. Returns false if
+  // there are no snapshots.
+  bool Sample(WorldTime now, WorldTime interpolation_delay,
+              std::vector<float>* health, std::vector<uint8_t>* splats) const;
+
+  // Drop every snapshot except the newest, so Sample() won't go back to
+  // anything before it. Use when the newest snapshot has been displayed
+  // directly.
+  void DiscardAllButNewest();
+
+  bool empty() const { return count_ == 0; }
+
+ private:
+  struct Snapshot {
+    WorldTime host_time;
+    std::vector<uint8_t> health;
+    std::vector<uint8_t> splats;
+  };
+
+  static const int kMaxSnapshots = 8;
+
+  // Index of the i'th oldest snapshot.
+  int Index(int i) const { return (oldest_ + i) % kMaxSnapshots; }
+
+  Snapshot snapshots_[kMaxSnapshots];
+  int oldest_;
+  int count_;
+
+  // Our clock minus the host's clock, measured on the fastest snapshot.
+  WorldTime clock_offset_;
+};
+
+}  // pie_noon
+}  // fpl
+
+#endif  // CLIENT_SNAPSHOT_BUFFER_H
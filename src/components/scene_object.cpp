@@ -146,6 +146,17 @@ bool SceneObjectComponent::VisibleInHierarchy(
   }
 }
 
+// An object only stays put if everything it's attached to does.
+bool SceneObjectComponent::StaticInHierarchy(
+    const corgi::EntityRef& entity) const {
+  const SceneObjectData* data = GetComponentData(entity);
+  if (!data->HasParent()) {
+    return data->is_static();
+  } else {
+    return data->is_static() && StaticInHierarchy(data->parent());
+  }
+}
+
 void SceneObjectComponent::PopulateScene(SceneDescription* scene) {
   UpdateGlobalMatrices();
 
@@ -154,9 +165,11 @@ void SceneObjectComponent::PopulateScene(SceneDescription* scene) {
     corgi::EntityRef entity = iter->entity;
     if (VisibleInHierarchy(entity)) {
       SceneObjectData* data = GetComponentData(entity);
-      scene->renderables().push_back(std::unique_ptr<Renderable>(
+      Renderable* renderable =
           new Renderable(data->renderable_id(), data->variant(),
-                         data->global_matrix(), data->tint())));
+                         data->global_matrix(), data->tint());
+      renderable->set_is_static(StaticInHierarchy(entity));
+      scene->renderables().push_back(std::unique_ptr<Renderable>(renderable));
     }
   }
 }
@@ -37,7 +37,8 @@ class SceneObjectData {
         tint_(mathfu::kOnes4f),
         renderable_id_(0),
         variant_(0),
-        visible_(true) {}
+        visible_(true),
+        is_static_(false) {}
   void Initialize(motive::MotiveEngine* engine);
 
   // Set components of the transformation from object-to-local space.
@@ -133,6 +134,9 @@ class SceneObjectData {
   bool visible() const { return visible_; }
   void set_visible(bool visible) { visible_ = visible; }
 
+  bool is_static() const { return is_static_; }
+  void set_is_static(bool is_static) { is_static_ = is_static; }
+
  private:
   // Basic matrix operations from with 'transform_.Value()' is calculated.
   // These operations are applied last-to-first to convert the object from
@@ -182,6 +186,10 @@ class SceneObjectData {
 
   // Whether object is currently on-screen or not.
   bool visible_;
+
+  // Whether object is at rest. Props are, until they're shaken. Nothing
+  // else is. See Renderable::is_static().
+  bool is_static_;
 };
 
 // A sceneobject is "a thing I want to place in the scene and move around."
@@ -199,6 +207,7 @@ class SceneObjectComponent : public corgi::Component<SceneObjectData> {
                           std::vector<bool>& matrix_calculated);
   void UpdateGlobalMatrices();
   bool VisibleInHierarchy(const corgi::EntityRef& entity) const;
+  bool StaticInHierarchy(const corgi::EntityRef& entity) const;
 
   motive::MotiveEngine* engine_;
 };
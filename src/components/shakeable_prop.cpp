@@ -26,6 +26,11 @@ CORGI_DEFINE_COMPONENT(fpl::pie_noon::ShakeablePropComponent,
 namespace fpl {
 namespace pie_noon {
 
+// A shake has died down once the prop is this close to its rest angle, in
+// radians, and turning this slowly, in radians per millisecond.
+static const float kSettledAngle = 0.001f;
+static const float kSettledSpeed = 0.00001f;
+
 void ShakeablePropComponent::UpdateAllEntities(
     corgi::WorldTime /*delta_time*/) {
   for (auto iter = component_data_.begin(); iter != component_data_.end();
@@ -36,8 +41,17 @@ void ShakeablePropComponent::UpdateAllEntities(
     assert(so_data != nullptr && sp_data != nullptr);
 
     if (sp_data->motivator.Valid()) {
-      so_data->SetPreRotationAboutAxis(sp_data->motivator.Value(),
-                                       sp_data->axis);
+      const motive::Motivator1f& motivator = sp_data->motivator;
+      const bool settled =
+          fabs(motivator.Value() - motivator.TargetValue()) < kSettledAngle &&
+          fabs(motivator.Velocity()) < kSettledSpeed;
+
+      // Hold settled props exactly at rest, so that their matrices stop
+      // changing, and they can be treated as static again.
+      so_data->SetPreRotationAboutAxis(
+          settled ? motivator.TargetValue() : motivator.Value(),
+          sp_data->axis);
+      so_data->set_is_static(settled);
     }
   }
 }
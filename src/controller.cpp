@@ -23,6 +23,13 @@ void Controller::ClearAllLogicalInputs() {
   went_up_ = 0;
 }
 
+void Controller::RestoreLogicalInputs(uint32_t is_down, uint32_t went_down,
+                                      uint32_t went_up) {
+  is_down_ = is_down;
+  went_down_ = went_down;
+  went_up_ = went_up;
+}
+
 void Controller::SetLogicalInputs(uint32_t bitmap, bool set) {
   if (set) {
     uint32_t already_down = bitmap & is_down_;
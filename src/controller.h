@@ -16,6 +16,7 @@
 #define PIE_NOON_CONTROLLER_H_
 
 #include <cstdint>
+#include <limits>
 #include "common.h"
 
 namespace fpl {
@@ -23,6 +24,9 @@ namespace pie_noon {
 
 static const CharacterId kNoCharacter = -1;
 
+// Returned by Controller::TimeUntilInput() when no input is expected.
+static const WorldTime kNoPendingInput = std::numeric_limits<WorldTime>::max();
+
 class Controller {
  public:
   enum ControllerType {
@@ -47,6 +51,16 @@ class Controller {
   // Update the current state of this controller.
   virtual void AdvanceFrame(WorldTime delta_time) = 0;
 
+  // How long until this controller's logical inputs might change, assuming
+  // the game doesn't change around it first. Lets headless games skip
+  // frames in which nothing happens. Controllers driven by people can't
+  // know, so by default input could come at any time.
+  virtual WorldTime TimeUntilInput() const { return 0; }
+
+  // Called by GameState::Reset(), so a controller can forget anything it
+  // worked out about the previous game.
+  virtual void OnGameReset() {}
+
   ControllerType controller_type() const { return controller_type_; }
 
   // Returns the current set of active logical input bits.
@@ -66,6 +80,11 @@ class Controller {
   // Clear all the currently set logical inputs.
   void ClearAllLogicalInputs();
 
+  // Overwrite all the logical input bitfields at once. Used when restoring a
+  // saved GameState.
+  void RestoreLogicalInputs(uint32_t is_down, uint32_t went_down,
+                            uint32_t went_up);
+
  protected:
   // A bitfield of currently active logical input bits.
   uint32_t is_down_;
@@ -0,0 +1,84 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EVENT_SCHEDULE_H
+#define EVENT_SCHEDULE_H
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+#include "common.h"
+
+namespace fpl {
+namespace pie_noon {
+
+// A min-heap of things that will happen at a known WorldTime. Events due at
+// the same time come out in the order they were scheduled, so the order of
+// play doesn't depend on how the heap happens to be arranged.
+template <class T>
+class EventSchedule {
+ public:
+  EventSchedule() : next_sequence_(0) {}
+
+  void Schedule(WorldTime time, const T& payload) {
+    const Entry entry = {time, next_sequence_++, payload};
+    heap_.push_back(entry);
+    std::push_heap(heap_.begin(), heap_.end(), Later());
+  }
+
+  // Remove the earliest event and return it in 'payload', if it is due at
+  // or before 'time'. Returns false, and leaves the schedule alone, if not.
+  bool PopDue(WorldTime time, T* payload) {
+    if (heap_.empty() || heap_.front().time > time) return false;
+    *payload = heap_.front().payload;
+    std::pop_heap(heap_.begin(), heap_.end(), Later());
+    heap_.pop_back();
+    return true;
+  }
+
+  // Time of the earliest event. The schedule must not be empty.
+  WorldTime next_time() const {
+    assert(!heap_.empty());
+    return heap_.front().time;
+  }
+
+  bool empty() const { return heap_.empty(); }
+
+  void Clear() {
+    heap_.clear();
+    next_sequence_ = 0;
+  }
+
+ private:
+  struct Entry {
+    WorldTime time;
+    uint32_t sequence;
+    T payload;
+  };
+
+  // Orders the heap so that the earliest event is at the front.
+  struct Later {
+    bool operator()(const Entry& a, const Entry& b) const {
+      return a.time != b.time ? a.time > b.time : a.sequence > b.sequence;
+    }
+  };
+
+  std::vector<Entry> heap_;
+  uint32_t next_sequence_;
+};
+
+}  // pie_noon
+}  // fpl
+
+#endif  // EVENT_SCHEDULE_H
@@ -0,0 +1,96 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "common.h"
+#include "frustum_culler.h"
+
+using mathfu::mat4;
+using mathfu::vec3;
+using mathfu::vec4;
+
+namespace fpl {
+namespace pie_noon {
+
+void FrustumCuller::Clear(size_t num_spheres) {
+  num_spheres_ = 0;
+  x_.clear();
+  y_.clear();
+  z_.clear();
+  radius_.clear();
+  x_.reserve(num_spheres);
+  y_.reserve(num_spheres);
+  z_.reserve(num_spheres);
+  radius_.reserve(num_spheres);
+}
+
+void FrustumCuller::Add(const vec3& center, float radius) {
+  x_.push_back(center.x());
+  y_.push_back(center.y());
+  z_.push_back(center.z());
+  radius_.push_back(radius);
+  num_spheres_++;
+}
+
+int FrustumCuller::Cull(const mat4& clip_from_world,
+                        std::vector<uint8_t>* visible) const {
+  const size_t n = num_spheres_;
+  visible->assign(n, 1);
+  if (n == 0) return 0;
+
+  // A point is inside the frustum when -w <= x, y, z <= w in clip space.
+  // Each of those six inequalities is a plane in world space, made from the
+  // rows of 'clip_from_world'.
+  const vec4 row_x(clip_from_world(0, 0), clip_from_world(0, 1),
+                   clip_from_world(0, 2), clip_from_world(0, 3));
+  const vec4 row_y(clip_from_world(1, 0), clip_from_world(1, 1),
+                   clip_from_world(1, 2), clip_from_world(1, 3));
+  const vec4 row_z(clip_from_world(2, 0), clip_from_world(2, 1),
+                   clip_from_world(2, 2), clip_from_world(2, 3));
+  const vec4 row_w(clip_from_world(3, 0), clip_from_world(3, 1),
+                   clip_from_world(3, 2), clip_from_world(3, 3));
+  const vec4 planes[] = {row_w + row_x, row_w - row_x, row_w + row_y,
+                         row_w - row_y, row_w + row_z, row_w - row_z};
+
+  // Each loop below reads whole columns and has no branches, so the
+  // compiler can turn it into vector instructions.
+  const float* x = &x_[0];
+  const float* y = &y_[0];
+  const float* z = &z_[0];
+  const float* radius = &radius_[0];
+  uint8_t* inside = &(*visible)[0];
+  for (size_t p = 0; p < PIE_ARRAYSIZE(planes); ++p) {
+    // Normalize, so that the plane equation gives the distance to it.
+    const vec4& plane = planes[p];
+    const float length = plane.xyz().Length();
+    if (length == 0.0f) continue;
+    const float a = plane.x() / length;
+    const float b = plane.y() / length;
+    const float c = plane.z() / length;
+    const float d = plane.w() / length;
+    for (size_t i = 0; i < n; ++i) {
+      const float distance = a * x[i] + b * y[i] + c * z[i] + d;
+      inside[i] &= static_cast<uint8_t>(distance >= -radius[i]);
+    }
+  }
+
+  int num_culled = 0;
+  for (size_t i = 0; i < n; ++i) {
+    num_culled += 1 - inside[i];
+  }
+  return num_culled;
+}
+
+}  // pie_noon
+}  // fpl
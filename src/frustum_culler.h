@@ -0,0 +1,76 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <vector>
+#include "mathfu/glsl_mappings.h"
+
+namespace fpl {
+namespace pie_noon {
+
+// How much culling left out, over some number of passes.
+struct CullingStats {
+  CullingStats()
+      : passes(0),
+        renderables(0),
+        renderables_culled(0),
+        shadows(0),
+        shadows_culled(0) {}
+  // One per camera the scene was drawn from.
+  int passes;
+  int renderables;
+  int renderables_culled;
+  int shadows;
+  int shadows_culled;
+};
+
+// Tests bounding spheres against a camera's view frustum.
+//
+// The spheres are set once per frame, in world space, and can then be tested
+// against any number of cameras, e.g. one for each eye in Cardboard mode.
+// Spheres are kept column by column, so each plane of the frustum is tested
+// against every sphere with one loop.
+class FrustumCuller {
+ public:
+  FrustumCuller() : num_spheres_(0) {}
+
+  // Remove all spheres, and make room for 'num_spheres' of them.
+  void Clear(size_t num_spheres);
+
+  // Add a sphere. Spheres are numbered in the order they're added.
+  void Add(const mathfu::vec3& center, float radius);
+
+  // Set 'visible' to one for every sphere that may be seen through
+  // 'clip_from_world', e.g. a projection times a camera matrix, and to zero
+  // for the others. Returns the number of spheres culled.
+  int Cull(const mathfu::mat4& clip_from_world,
+           std::vector<uint8_t>* visible) const;
+
+  size_t num_spheres() const { return num_spheres_; }
+
+ private:
+  size_t num_spheres_;
+
+  std::vector<float> x_;
+  std::vector<float> y_;
+  std::vector<float> z_;
+  std::vector<float> radius_;
+};
+
+}  // pie_noon
+}  // fpl
+
+#endif  // FRUSTUM_CULLER_H
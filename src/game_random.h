@@ -0,0 +1,82 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GAME_RANDOM_H
+#define GAME_RANDOM_H
+
+#include <cstdint>
+
+namespace fpl {
+namespace pie_noon {
+
+// The random number generator for one GameState. Its whole state is one
+// number, so it can be saved in a GameStateSnapshot, and games running on
+// different threads never share a sequence the way they would with rand().
+class GameRandom {
+ public:
+  GameRandom() : state_(kDefaultSeed) {}
+
+  // Start a new sequence. Any seed is fine, including 0, and nearby seeds
+  // give unrelated sequences.
+  void Seed(uint32_t seed) { set_state(Mix(seed ^ kDefaultSeed)); }
+
+  // For saving and restoring the generator exactly.
+  uint32_t state() const { return state_; }
+  void set_state(uint32_t state) {
+    state_ = state == 0 ? kDefaultSeed : state;
+  }
+
+  // A random float in [0, 1).
+  float Chance() {
+    return static_cast<float>(Next() >> 8) * (1.0f / 16777216.0f);
+  }
+
+  // A random float in [min_value, max_value).
+  float Range(float min_value, float max_value) {
+    return min_value + Chance() * (max_value - min_value);
+  }
+
+  // A random integer in [0, count). 'count' must be positive.
+  int Below(int count) {
+    return static_cast<int>(Next() % static_cast<uint32_t>(count));
+  }
+
+ private:
+  static const uint32_t kDefaultSeed = 2463534242u;
+
+  // The MurmurHash3 finalizer. Spreads every bit of 'x' over the result.
+  static uint32_t Mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x85ebca6bu;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35u;
+    x ^= x >> 16;
+    return x;
+  }
+
+  // xorshift32. Never produces or reaches 0.
+  uint32_t Next() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 17;
+    state_ ^= state_ << 5;
+    return state_;
+  }
+
+  uint32_t state_;
+};
+
+}  // pie_noon
+}  // fpl
+
+#endif  // GAME_RANDOM_H
@@ -21,6 +21,7 @@
 #include "config_generated.h"
 #include "controller.h"
 #include "game_state.h"
+#include <limits>
 #include "motive/init.h"
 #include "motive/io/flatbuffers.h"
 #include "motive/util.h"
@@ -28,6 +29,7 @@
 #include "pie_noon_common_generated.h"
 #include "pindrop/pindrop.h"
 #include "scene_description.h"
+#include "state_hash.h"
 #include "timeline_generated.h"
 
 using flatbuffers::uoffset_t;
@@ -133,6 +135,8 @@ corgi::EntityRef PieNoonEntityFactory::CreateEntityFromData(
 
 GameState::GameState()
     : time_(0),
+      countdown_timer_(0),
+      pies_changed_(false),
       config_(nullptr),
       arrangement_(nullptr),
       sceneobject_component_(&engine_),
@@ -143,6 +147,17 @@ GameState::GameState()
 
 GameState::~GameState() {}
 
+void GameState::set_config(const Config* config) {
+  config_ = config;
+  pie_splatter_emitter_.Compile(*config->pie_splatter_def());
+  confetti_emitter_.Compile(*config->confetti_def());
+  joining_confetti_emitter_.Compile(*config->joining_confetti_def());
+  particle_manager_.RegisterEmitter(&pie_splatter_emitter_);
+  particle_manager_.RegisterEmitter(&confetti_emitter_);
+  particle_manager_.RegisterEmitter(&joining_confetti_emitter_);
+  particle_manager_.InitializeBudget(config->particle_budget());
+}
+
 // Calculate the direction a character is facing at the start of the game.
 // We want the characters to face their initial target.
 static Angle InitialFaceAngle(const CharacterArrangement* arrangement,
@@ -228,6 +243,8 @@ void GameState::Reset(AnalyticsMode analytics_mode) {
   camera_base_.target = LoadVec3(layout_config->camera_target());
   camera_.Initialize(camera_base_, &engine_);
   pies_.clear();
+  pies_changed_ = true;
+  ResetEventSchedules();
   arrangement_ =
       GetBestArrangement(layout_config, static_cast<int>(characters_.size()));
   analytics_mode_ = analytics_mode;
@@ -255,8 +272,13 @@ void GameState::Reset(AnalyticsMode analytics_mode) {
   player_character_component_.set_gamestate_ptr(this);
   cardboard_player_component_.set_gamestate_ptr(this);
   // Load Entities from flatbuffer!
+  // These are the props. They stay put until something shakes them.
   for (uoffset_t i = 0; i < layout_config->entity_list()->size(); i++) {
-    entity_manager_.CreateEntityFromData(layout_config->entity_list()->Get(i));
+    corgi::EntityRef prop = entity_manager_.CreateEntityFromData(
+        layout_config->entity_list()->Get(i));
+    SceneObjectData* so_data =
+        entity_manager_.GetComponentData<SceneObjectData>(prop);
+    if (so_data != nullptr) so_data->set_is_static(true);
   }
 
   // Reset characters to their initial state.
@@ -270,6 +292,8 @@ void GameState::Reset(AnalyticsMode analytics_mode) {
         InitialFaceAngle(arrangement_, id, target_id),
         LoadVec3(arrangement_->character_data()->Get(id)->position()),
         &engine_);
+    Controller* controller = characters_[id]->controller();
+    if (controller != nullptr) controller->OnGameReset();
   }
 
   // When in cardboard, we want to make the first character invisible
@@ -294,6 +318,171 @@ void GameState::Reset(AnalyticsMode analytics_mode) {
   }
 
   particle_manager_.RemoveAllParticles();
+  perception_.Update(characters_, pies_, time_);
+}
+
+void GameState::SaveSnapshot(GameStateSnapshot* snapshot,
+                             GameStateSnapshot::Contents contents) const {
+  const std::vector<Particle*>& particles =
+      particle_manager_.get_particle_list();
+  const bool save_particles =
+      contents == GameStateSnapshot::kSimulationAndParticles;
+
+  GameStateSnapshot::Header header = GameStateSnapshot::Header();
+  header.version = GameStateSnapshot::kVersion;
+  header.contents = contents;
+  header.time = time_;
+  header.countdown_timer = countdown_timer_;
+  header.random_state = random_.state();
+  header.num_characters = static_cast<uint32_t>(characters_.size());
+  header.num_pies = static_cast<uint32_t>(pies_.size());
+  header.num_particles =
+      save_particles ? static_cast<uint32_t>(particles.size()) : 0;
+
+  std::vector<uint8_t>& blob = snapshot->blob_;
+  blob.resize(sizeof(header) +
+              header.num_characters * sizeof(CharacterSnapshot) +
+              header.num_pies * sizeof(AirbornePieSnapshot) +
+              header.num_particles * sizeof(Particle));
+  uint8_t* out = blob.data();
+  memcpy(out, &header, sizeof(header));
+  out += sizeof(header);
+
+  for (auto it = characters_.begin(); it != characters_.end(); ++it) {
+    CharacterSnapshot character = CharacterSnapshot();
+    (*it)->SaveSnapshot(&character);
+    memcpy(out, &character, sizeof(character));
+    out += sizeof(character);
+  }
+
+  for (auto it = pies_.begin(); it != pies_.end(); ++it) {
+    AirbornePieSnapshot pie = AirbornePieSnapshot();
+    (*it)->SaveSnapshot(&pie);
+    memcpy(out, &pie, sizeof(pie));
+    out += sizeof(pie);
+  }
+
+  // Particles hold nothing but vectors and numbers, so they are copied
+  // byte for byte.
+  if (save_particles) {
+    for (auto it = particles.begin(); it != particles.end(); ++it) {
+      memcpy(out, static_cast<const void*>(*it), sizeof(Particle));
+      out += sizeof(Particle);
+    }
+  }
+}
+
+bool GameState::RestoreSnapshot(const GameStateSnapshot& snapshot) {
+  const std::vector<uint8_t>& blob = snapshot.blob_;
+  GameStateSnapshot::Header header;
+  if (blob.size() < sizeof(header)) return false;
+  memcpy(&header, blob.data(), sizeof(header));
+
+  const size_t expected_size =
+      sizeof(header) + header.num_characters * sizeof(CharacterSnapshot) +
+      header.num_pies * sizeof(AirbornePieSnapshot) +
+      header.num_particles * sizeof(Particle);
+  if (header.version != GameStateSnapshot::kVersion ||
+      header.num_characters != characters_.size() ||
+      header.num_particles >
+          static_cast<uint32_t>(ParticleManager::max_particles()) ||
+      blob.size() != expected_size) {
+    fplbase::LogError(fplbase::kApplication,
+                      "Snapshot does not match the current game.\n");
+    return false;
+  }
+
+  const uint8_t* in = blob.data() + sizeof(header);
+  const uint8_t* pies_in =
+      in + header.num_characters * sizeof(CharacterSnapshot);
+
+  // Check every index in the snapshot before changing anything. Its bytes
+  // may have come from anywhere; see GameStateSnapshot::Assign().
+  const CharacterId num_ids = static_cast<CharacterId>(characters_.size());
+  for (uint32_t i = 0; i < header.num_characters; ++i) {
+    CharacterSnapshot character;
+    memcpy(&character, in + i * sizeof(character), sizeof(character));
+    if (!Character::IsValidSnapshot(character, num_ids)) {
+      fplbase::LogError(fplbase::kApplication,
+                        "Snapshot has an invalid character.\n");
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i < header.num_pies; ++i) {
+    AirbornePieSnapshot pie;
+    memcpy(&pie, pies_in + i * sizeof(pie), sizeof(pie));
+    if (pie.original_source < 0 || pie.original_source >= num_ids ||
+        pie.source < 0 || pie.source >= num_ids || pie.target < 0 ||
+        pie.target >= num_ids) {
+      fplbase::LogError(fplbase::kApplication,
+                        "Snapshot has a pie with an invalid character.\n");
+      return false;
+    }
+  }
+
+  time_ = header.time;
+  countdown_timer_ = header.countdown_timer;
+  random_.set_state(header.random_state);
+
+  for (auto it = characters_.begin(); it != characters_.end(); ++it) {
+    CharacterSnapshot character;
+    memcpy(&character, in, sizeof(character));
+    in += sizeof(character);
+    (*it)->RestoreSnapshot(character, &engine_);
+  }
+
+  pies_.clear();
+  ResetEventSchedules();
+  for (uint32_t i = 0; i < header.num_pies; ++i) {
+    AirbornePieSnapshot pie;
+    memcpy(&pie, in, sizeof(pie));
+    in += sizeof(pie);
+    pies_.push_back(std::unique_ptr<AirbornePie>(new AirbornePie(pie)));
+    pie_impacts_.Schedule(pie.start_time + pie.flight_time,
+                          pies_.back().get());
+  }
+  pies_changed_ = true;
+  UpdatePiePositions();
+  perception_.Update(characters_, pies_, time_);
+
+  if (static_cast<GameStateSnapshot::Contents>(header.contents) ==
+      GameStateSnapshot::kSimulationAndParticles) {
+    particle_manager_.RemoveAllParticles();
+    for (uint32_t i = 0; i < header.num_particles; ++i) {
+      // Can't fail, since num_particles was checked above.
+      Particle* p = particle_manager_.CreateParticle();
+      assert(p != nullptr);
+      memcpy(static_cast<void*>(p), in, sizeof(Particle));
+      in += sizeof(Particle);
+    }
+  }
+  return true;
+}
+
+uint32_t GameState::StateHash() const {
+  StateHasher hasher;
+  hasher.Add(static_cast<uint32_t>(characters_.size()));
+  for (auto it = characters_.begin(); it != characters_.end(); ++it) {
+    const auto& character = *it;
+    hasher.Add(character->health());
+    hasher.Add(character->pie_damage());
+    hasher.Add(static_cast<uint32_t>(character->State()));
+    hasher.Add(character->target());
+    hasher.Add(character->score());
+  }
+  hasher.Add(static_cast<uint32_t>(pies_.size()));
+  for (auto it = pies_.begin(); it != pies_.end(); ++it) {
+    const auto& pie = *it;
+    hasher.Add(pie->original_source());
+    hasher.Add(pie->source());
+    hasher.Add(pie->target());
+    hasher.Add(pie->start_time());
+    hasher.Add(pie->flight_time());
+    hasher.Add(pie->original_damage());
+    hasher.Add(pie->damage());
+  }
+  hasher.Add(random_.state());
+  return hasher.hash();
 }
 
 // Sets up the players in joining mode, where all they can do is jump up
@@ -313,6 +502,8 @@ WorldTime GameState::GetAnimationTime(const Character& character) const {
 void GameState::ProcessSounds(pindrop::AudioEngine* audio_engine,
                               const Character& character,
                               WorldTime delta_time) const {
+  if (!audio_engine) return;
+
   // Process sounds in timeline.
   const Timeline* const timeline = character.CurrentTimeline();
   if (!timeline) return;
@@ -333,14 +524,14 @@ void GameState::ProcessSounds(pindrop::AudioEngine* audio_engine,
   }
 }
 
-static float CalculatePieHeight(const Config& config) {
+static float CalculatePieHeight(const Config& config, GameRandom* random) {
   return config.pie_arc_height() +
-         config.pie_arc_height_variance() * (mathfu::Random<float>() * 2 - 1);
+         config.pie_arc_height_variance() * random->Range(-1.0f, 1.0f);
 }
 
-static float CalculatePieRotations(const Config& config) {
+static float CalculatePieRotations(const Config& config, GameRandom* random) {
   const int variance = config.pie_rotation_variance();
-  const int bonus = variance == 0 ? 0 : (rand() % (variance * 2)) - variance;
+  const int bonus = variance == 0 ? 0 : random->Below(variance * 2) - variance;
   return config.pie_rotations() + bonus;
 }
 
@@ -366,18 +557,38 @@ void GameState::CreatePie(CharacterId original_source_id, CharacterId source_id,
                           CharacterId target_id,
                           CharacterHealth original_damage,
                           CharacterHealth damage) {
-  const float peak_height =
-      CalculatePieHeight(is_in_cardboard_ ? *cardboard_config_ : *config_);
-  const int rotations = CalculatePieRotations(*config_);
+  const float peak_height = CalculatePieHeight(
+      is_in_cardboard_ ? *cardboard_config_ : *config_, &random_);
+  const int rotations = CalculatePieRotations(*config_, &random_);
   const float y_rotation = CalculatePieYRotation(source_id, target_id);
   pies_.push_back(std::unique_ptr<AirbornePie>(new AirbornePie(
       original_source_id, *characters_[source_id], *characters_[target_id],
       time_, config_->pie_flight_time(), original_damage, damage,
-      config_->pie_initial_height(), peak_height, rotations, y_rotation,
-      &engine_)));
+      config_->pie_initial_height(), peak_height, rotations, y_rotation)));
+  AirbornePie* pie = pies_.back().get();
+  pie_impacts_.Schedule(pie->start_time() + pie->flight_time(), pie);
+  pies_changed_ = true;
+}
+
+void GameState::RemovePie(const AirbornePie* pie) {
+  for (auto it = pies_.begin(); it != pies_.end(); ++it) {
+    if (it->get() == pie) {
+      pies_.erase(it);
+      pies_changed_ = true;
+      return;
+    }
+  }
+}
+
+void GameState::UpdatePiePositions() {
+  if (pies_changed_) {
+    pie_trajectories_.Rebuild(pies_);
+    pies_changed_ = false;
+  }
+  pie_trajectories_.Evaluate(time_, pies_);
 }
 
-CharacterId GameState::DetermineDeflectionTarget(const ReceivedPie& pie) const {
+CharacterId GameState::DetermineDeflectionTarget(const ReceivedPie& pie) {
   switch (config_->pie_deflection_mode()) {
     case PieDeflectionMode_ToTargetOfTarget: {
       return characters_[pie.target_id]->target();
@@ -386,7 +597,7 @@ CharacterId GameState::DetermineDeflectionTarget(const ReceivedPie& pie) const {
       return pie.source_id;
     }
     case PieDeflectionMode_ToRandom: {
-      return rand() % characters_.size();
+      return random_.Below(static_cast<int>(characters_.size()));
     }
     default: {
       assert(0);
@@ -501,7 +712,7 @@ void GameState::ProcessEvent(pindrop::AudioEngine* audio_engine,
             config_->blocked_sound_id_for_pie_damage()->Length() - 1);
         const auto& sound_name =
             config_->blocked_sound_id_for_pie_damage()->Get(index);
-        audio_engine->PlaySound(sound_name->c_str());
+        if (audio_engine) audio_engine->PlaySound(sound_name->c_str());
 
         const CharacterHealth deflected_pie_damage =
             pie.damage + config_->pie_damage_change_when_deflected();
@@ -535,12 +746,12 @@ void GameState::ProcessEvent(pindrop::AudioEngine* audio_engine,
   }
 }
 
-static vec3 RandomInRangeVec3(const vec3& min_range, const vec3& max_range) {
-  // TODO: Fix mathfu::RandomInRange to take "const T&" instead of "T".
-  // Will avoid alignment error on Visual Studio.
-  return vec3(mathfu::RandomInRange(min_range.x(), max_range.x()),
-              mathfu::RandomInRange(min_range.y(), max_range.y()),
-              mathfu::RandomInRange(min_range.z(), max_range.z()));
+static vec3 RandomInRangeVec3(const vec3& min_range, const vec3& max_range,
+                              GameRandom* random) {
+  const float x = random->Range(min_range.x(), max_range.x());
+  const float y = random->Range(min_range.y(), max_range.y());
+  const float z = random->Range(min_range.z(), max_range.z());
+  return vec3(x, y, z);
 }
 
 void GameState::AddSplatterToProp(corgi::EntityRef prop) {
@@ -552,45 +763,81 @@ void GameState::AddSplatterToProp(corgi::EntityRef prop) {
         entity_manager_.CreateEntityFromData(config_->splatter_def());
     auto so_data = entity_manager_.GetComponentData<SceneObjectData>(splatter);
 
-    so_data->set_renderable_id(id_list[mathfu::RandomInRange(0, 3)]);
+    so_data->set_renderable_id(id_list[random_.Below(3)]);
     so_data->set_parent(prop);
 
     vec3 min_range = LoadVec3(config_->splatter_range_min());
     vec3 max_range = LoadVec3(config_->splatter_range_max());
 
-    const vec3 offset = RandomInRangeVec3(min_range, max_range);
+    const vec3 offset = RandomInRangeVec3(min_range, max_range, &random_);
     so_data->SetTranslation(offset);
 
     const Angle rotation_angle =
-        Angle::FromWithinThreePi(mathfu::RandomInRange(-M_PI_2, M_PI_2));
+        Angle::FromWithinThreePi(random_.Range(-kHalfPi, kHalfPi));
     so_data->SetRotationAboutZ(rotation_angle.ToRadians());
 
-    float scale = mathfu::RandomInRange(config_->splatter_scale_min(),
-                                        config_->splatter_scale_max());
+    float scale = random_.Range(config_->splatter_scale_min(),
+                                config_->splatter_scale_max());
     so_data->SetScale(vec3(scale));
 
     drip_and_vanish_component_.SetStartingValues(splatter);
   }
 }
 
+// Process the character's timeline events that are due before 'end_time',
+// and schedule the one after.
 void GameState::ProcessEvents(pindrop::AudioEngine* audio_engine,
                               Character* character, EventData* event_data,
-                              WorldTime delta_time) {
-  // Process events in timeline.
-  const Timeline* const timeline = character->CurrentTimeline();
-  if (!timeline) return;
-
-  const WorldTime anim_time = GetAnimationTime(*character);
-  const auto events = timeline->events();
-  const int start_index = TimelineIndexAfterTime(events, 0, anim_time);
-  const int end_index =
-      TimelineIndexAfterTime(events, start_index, anim_time + delta_time);
-
-  for (int i = start_index; i < end_index; ++i) {
-    const TimelineEvent* event = events->Get(i);
+                              WorldTime end_time) {
+  TimelineCursor& cursor = timeline_cursors_[character->id()];
+  const auto events = cursor.timeline->events();
+  const int num_events = static_cast<int>(events->Length());
+  while (cursor.next_event < num_events) {
+    const TimelineEvent* event = events->Get(cursor.next_event);
+    if (cursor.state_start_time + event->time() >= end_time) break;
+    cursor.next_event++;
     event_data->pie_damage = event->modifier();
     ProcessEvent(audio_engine, character, event->event(), *event_data);
   }
+  ScheduleNextTimelineEvent(character->id());
+}
+
+void GameState::ResetEventSchedules() {
+  pie_impacts_.Clear();
+  timeline_events_.Clear();
+  const TimelineCursor no_timeline = {nullptr, -1, 0};
+  timeline_cursors_.assign(characters_.size(), no_timeline);
+  timeline_events_due_.assign(characters_.size(), 0);
+}
+
+// Start following a new timeline if the character has changed state.
+void GameState::UpdateTimelineCursor(CharacterId id) {
+  const Character& character = *characters_[id];
+  const Timeline* timeline = character.CurrentTimeline();
+  const WorldTime start_time =
+      character.state_machine()->current_state_start_time();
+  TimelineCursor& cursor = timeline_cursors_[id];
+  if (cursor.timeline == timeline && cursor.state_start_time == start_time) {
+    return;
+  }
+  cursor.timeline = timeline;
+  cursor.state_start_time = start_time;
+  cursor.next_event =
+      timeline ? TimelineIndexAfterTime(timeline->events(), 0,
+                                        GetAnimationTime(character))
+               : 0;
+  ScheduleNextTimelineEvent(id);
+}
+
+void GameState::ScheduleNextTimelineEvent(CharacterId id) {
+  const TimelineCursor& cursor = timeline_cursors_[id];
+  if (!cursor.timeline || !cursor.timeline->events()) return;
+  const auto events = cursor.timeline->events();
+  if (cursor.next_event >= static_cast<int>(events->Length())) return;
+  const ScheduledTimelineEvent scheduled = {id, cursor.state_start_time};
+  timeline_events_.Schedule(
+      cursor.state_start_time + events->Get(cursor.next_event)->time(),
+      scheduled);
 }
 
 void GameState::PopulateConditionInputs(ConditionInputs* condition_inputs,
@@ -891,80 +1138,49 @@ uint32_t GameState::AllLogicalInputs() const {
 void GameState::CreatePieSplatter(pindrop::AudioEngine* audio_engine,
                                   const Character& character,
                                   CharacterHealth damage) {
-  const ParticleDef* def = config_->pie_splatter_def();
   SpawnParticles(
-      character.position(), def,
+      character.position(), pie_splatter_emitter_,
       static_cast<int>(damage) * config_->pie_noon_particles_per_damage());
   // Play a pie hit sound based upon the amount of damage applied (size of the
   // pie).
   const CharacterHealth index = mathfu::Clamp<CharacterHealth>(
       damage, 0, config_->hit_sound_id_for_pie_damage()->Length() - 1);
   const auto& sound_name = config_->hit_sound_id_for_pie_damage()->Get(index);
-  audio_engine->PlaySound(sound_name->c_str());
+  if (audio_engine) audio_engine->PlaySound(sound_name->c_str());
 }
 
 // Creates confetti when a character presses buttons on the join screen.
 void GameState::CreateJoinConfettiBurst(const Character& character) {
-  const ParticleDef* def = config_->joining_confetti_def();
   vec3 character_color =
       LoadVec3(config_->character_colors()->Get(character.id()));
   SpawnParticles(
-      character.position(), def, config_->joining_confetti_count(),
+      character.position(), joining_confetti_emitter_,
+      config_->joining_confetti_count(),
       vec4(character_color.x(), character_color.y(), character_color.z(), 1));
 }
 
-// Spawns a particle at the given position, using a particle definition.
+// Spawns particles at the given position, using a compiled particle
+// definition.
 void GameState::SpawnParticles(const mathfu::vec3& position,
-                               const ParticleDef* def, const int particle_count,
+                               const EmitterDesc& emitter,
+                               const int particle_count,
                                const mathfu::vec4& base_tint) {
-  const vec3 min_scale = LoadVec3(def->min_scale());
-  const vec3 max_scale = LoadVec3(def->max_scale());
-  const vec3 min_velocity = LoadVec3(def->min_velocity());
-  const vec3 max_velocity = LoadVec3(def->max_velocity());
-  const vec3 min_angular_velocity = LoadVec3(def->min_angular_velocity());
-  const vec3 max_angular_velocity = LoadVec3(def->max_angular_velocity());
-  const vec3 min_position_offset = LoadVec3(def->min_position_offset());
-  const vec3 max_position_offset = LoadVec3(def->max_position_offset());
-  const vec3 min_orientation_offset = LoadVec3(def->min_orientation_offset());
-  const vec3 max_orientation_offset = LoadVec3(def->max_orientation_offset());
-
   const Angle to_position = Angle::FromXZVector(position - camera().Position());
   const vec3 additional_rotation =
       is_in_cardboard() ? vec3(0.0f, -(to_position.ToRadians() + kHalfPi), 0.0f)
                         : mathfu::kZeros3f;
+  particle_manager_.SpawnParticles(emitter, position, additional_rotation,
+                                   base_tint, particle_count);
+}
 
-  for (int i = 0; i < particle_count; i++) {
-    Particle* p = particle_manager_.CreateParticle();
-    // if we got back a null, it means new particles can't be spawned right now.
-    if (p == nullptr) {
-      break;
+void GameState::UpdateCountdownTimer() {
+  if (config_->game_mode() == GameMode_HighScore) {
+    int countdown = (config_->game_time() - time_) / kMillisecondsPerSecond;
+    if (countdown != countdown_timer_) {
+      countdown_timer_ = countdown;
+      fplbase::LogInfo(fplbase::kApplication, "Timer remaining: %i\n",
+                       countdown_timer_);
     }
-    p->set_base_scale(
-        def->preserve_aspect()
-            ? vec3(mathfu::RandomInRange(min_scale.x(), max_scale.x()))
-            : vec3::RandomInRange(min_scale, max_scale));
-
-    p->set_base_velocity(vec3::RandomInRange(min_velocity, max_velocity));
-    p->set_acceleration(LoadVec3(def->acceleration()));
-    p->set_renderable_id(def->renderable()->Get(
-        mathfu::RandomInRange<int>(0, def->renderable()->size())));
-    mathfu::vec4 tint = LoadVec4(
-        def->tint()->Get(mathfu::RandomInRange<int>(0, def->tint()->size())));
-    p->set_base_tint(
-        mathfu::vec4(tint.x() * base_tint.x(), tint.y() * base_tint.y(),
-                     tint.z() * base_tint.z(), tint.w() * base_tint.w()));
-    p->set_duration(static_cast<float>(mathfu::RandomInRange<int32_t>(
-        def->min_duration(), def->max_duration())));
-    p->set_base_position(position + vec3::RandomInRange(min_position_offset,
-                                                        max_position_offset));
-    p->set_base_orientation(
-        additional_rotation +
-        vec3::RandomInRange(min_orientation_offset, max_orientation_offset));
-    p->set_rotational_velocity(
-        vec3::RandomInRange(min_angular_velocity, max_angular_velocity));
-    p->set_duration_of_shrink_out(
-        static_cast<TimeStep>(def->shrink_duration()));
-    p->set_duration_of_fade_out(static_cast<TimeStep>(def->fade_duration()));
   }
 }
 
@@ -975,15 +1191,18 @@ void GameState::AdvanceFrame(WorldTime delta_time,
   // include the delta_time. For example, GetAnimationTime needs to compare
   // against the time for *this* frame, not last frame.
   time_ += delta_time;
-  if (config_->game_mode() == GameMode_HighScore) {
-    int countdown = (config_->game_time() - time_) / kMillisecondsPerSecond;
-    if (countdown != countdown_timer_) {
-      countdown_timer_ = countdown;
-      fplbase::LogInfo(fplbase::kApplication, "Timer remaining: %i\n",
-                       countdown_timer_);
+  UpdateCountdownTimer();
+
+  // Characters are added after Reset(), so catch up with them here.
+  if (timeline_cursors_.size() != characters_.size()) {
+    ResetEventSchedules();
+    for (auto it = pies_.begin(); it != pies_.end(); ++it) {
+      pie_impacts_.Schedule((*it)->start_time() + (*it)->flight_time(),
+                            it->get());
     }
   }
-  SpawnParticles(mathfu::vec3(0, 10, 0), config_->confetti_def(), 1);
+
+  SpawnParticles(mathfu::vec3(0, 10, 0), confetti_emitter_, 1);
 
   // Damage is queued up per character then applied during event processing.
   std::vector<EventData> event_data(characters_.size());
@@ -1018,25 +1237,19 @@ void GameState::AdvanceFrame(WorldTime delta_time,
   // Update all the particles.
   particle_manager_.AdvanceFrame(static_cast<TimeStep>(delta_time));
 
-  // Update pies. Modify state machine input when character hit by pie.
-  for (auto it = pies_.begin(); it != pies_.end();) {
-    auto& pie = *it;
-
-    // Remove pies that have made contact.
-    const WorldTime time_since_launch = time_ - pie->start_time();
-    if (time_since_launch >= pie->flight_time()) {
-      auto& character = characters_[pie->target()];
-      ReceivedPie received_pie = {pie->original_source(), pie->source(),
-                                  pie->target(), pie->original_damage(),
-                                  pie->damage()};
-      event_data[pie->target()].received_pies.push_back(received_pie);
-      character->controller()->SetLogicalInputs(LogicalInputs_JustHit, true);
-      if (character->State() != StateId_Blocking)
-        CreatePieSplatter(audio_engine, *character, pie->damage());
-      it = pies_.erase(it);
-    } else {
-      ++it;
-    }
+  // Land pies that have made contact, in the order they land. Modify state
+  // machine input when character hit by pie.
+  AirbornePie* pie;
+  while (pie_impacts_.PopDue(time_, &pie)) {
+    auto& character = characters_[pie->target()];
+    ReceivedPie received_pie = {pie->original_source(), pie->source(),
+                                pie->target(), pie->original_damage(),
+                                pie->damage()};
+    event_data[pie->target()].received_pies.push_back(received_pie);
+    character->controller()->SetLogicalInputs(LogicalInputs_JustHit, true);
+    if (character->State() != StateId_Blocking)
+      CreatePieSplatter(audio_engine, *character, pie->damage());
+    RemovePie(pie);
   }
 
   // Update the character state machines and the facing angles.
@@ -1065,9 +1278,24 @@ void GameState::AdvanceFrame(WorldTime delta_time,
   }
 
   // Look to timeline to see what's happening. Make it happen.
+  // Events are looked up one frame ahead, as far as 'timeline_end'.
+  const WorldTime timeline_end = time_ + delta_time;
+  for (CharacterId id = 0; id < static_cast<CharacterId>(characters_.size());
+       ++id) {
+    UpdateTimelineCursor(id);
+  }
+  ScheduledTimelineEvent due;
+  while (timeline_events_.PopDue(timeline_end - 1, &due)) {
+    if (due.state_start_time == timeline_cursors_[due.id].state_start_time) {
+      timeline_events_due_[due.id] = 1;
+    }
+  }
+  // Process characters in order, whenever their events fall due.
   for (unsigned int i = 0; i < characters_.size(); ++i) {
+    if (!timeline_events_due_[i]) continue;
+    timeline_events_due_[i] = 0;
     ProcessEvents(audio_engine, characters_[i].get(), &event_data[i],
-                  delta_time);
+                  timeline_end);
   }
 
   for (unsigned int i = 0; i < characters_.size(); ++i) {
@@ -1089,6 +1317,110 @@ void GameState::AdvanceFrame(WorldTime delta_time,
   engine_.AdvanceFrame(delta_time);
 
   camera_.AdvanceFrame(delta_time);
+  UpdatePiePositions();
+  perception_.Update(characters_, pies_, time_);
+}
+
+// Earliest time at which 'character' might do something other than carry on
+// with its current animation, assuming nothing else happens to it first.
+WorldTime GameState::NextCharacterChangeTime(const Character& character) const {
+  const CharacterId id = character.id();
+  const Controller* controller = character.controller();
+  const TimelineCursor& cursor = timeline_cursors_[id];
+  const WorldTime start_time =
+      character.state_machine()->current_state_start_time();
+
+  // JustHit is cleared on the next frame. A cursor that's out of date means
+  // the character's timeline events aren't scheduled yet.
+  if ((controller->is_down() & LogicalInputs_JustHit) ||
+      cursor.timeline != character.CurrentTimeline() ||
+      cursor.state_start_time != start_time) {
+    return time_;
+  }
+
+  WorldTime next = std::numeric_limits<WorldTime>::max();
+  const WorldTime time_until_input = controller->TimeUntilInput();
+  if (time_until_input < next - time_) next = time_ + time_until_input;
+
+  const WorldTime anim_time = GetAnimationTime(character);
+  const Timeline* timeline = cursor.timeline;
+  if (timeline && anim_time < timeline->end_time()) {
+    next = std::min(next, start_time + timeline->end_time());
+  }
+
+  // Inputs hold steady until then, so conditions only change when their
+  // time window opens. One that already holds will act on the next frame.
+  ConditionInputs condition_inputs;
+  PopulateConditionInputs(&condition_inputs, character);
+  const auto state = character.state_machine()->current_state();
+  if (state->transitions()) {
+    for (auto it = state->transitions()->begin();
+         it != state->transitions()->end(); ++it) {
+      const Condition* condition = it->condition();
+      if (!condition) continue;
+      if (EvaluateCondition(condition, condition_inputs)) return time_;
+      if (condition->time() > anim_time) {
+        next = std::min(next, start_time + condition->time());
+      }
+    }
+  }
+  if (state->conditional_events()) {
+    for (auto it = state->conditional_events()->begin();
+         it != state->conditional_events()->end(); ++it) {
+      const Condition* condition = it->condition();
+      if (!condition) continue;
+      if (EvaluateCondition(condition, condition_inputs)) return time_;
+      if (condition->time() > anim_time) {
+        next = std::min(next, start_time + condition->time());
+      }
+    }
+  }
+  return next;
+}
+
+WorldTime GameState::NextScheduledTime(WorldTime frame_time) const {
+  if (timeline_cursors_.size() != characters_.size()) return time_;
+
+  WorldTime next = std::numeric_limits<WorldTime>::max();
+  if (!pie_impacts_.empty()) next = std::min(next, pie_impacts_.next_time());
+  // Timeline events are processed a frame early.
+  if (!timeline_events_.empty()) {
+    next = std::min(next, timeline_events_.next_time() - frame_time + 1);
+  }
+  if (config_->game_mode() == GameMode_HighScore) {
+    next = std::min(next, config_->game_time());
+  }
+  for (auto it = characters_.begin(); it != characters_.end(); ++it) {
+    next = std::min(next, NextCharacterChangeTime(**it));
+  }
+  return std::max(next, time_);
+}
+
+WorldTime GameState::SkipIdleFrames(WorldTime frame_time, WorldTime max_time) {
+  if (frame_time <= 0) return 0;
+
+  // Every frame that ends before 'next' is idle.
+  const WorldTime next = NextScheduledTime(frame_time);
+  const WorldTime idle_time =
+      next > max_time ? max_time - time_ : next - time_ - 1;
+  const int idle_frames = idle_time / frame_time;
+  if (idle_frames <= 0) return 0;
+
+  const WorldTime skipped = idle_frames * frame_time;
+  time_ += skipped;
+  UpdateCountdownTimer();
+  for (auto it = characters_.begin(); it != characters_.end(); ++it) {
+    (*it)->UpdatePreviousState();
+  }
+
+  // Nothing is drawn when headless, so don't bother aging the particles.
+  particle_manager_.RemoveAllParticles();
+  entity_manager_.UpdateComponents(skipped);
+  engine_.AdvanceFrame(skipped);
+  camera_.AdvanceFrame(skipped);
+  UpdatePiePositions();
+  perception_.Update(characters_, pies_, time_);
+  return skipped;
 }
 
 void GameState::PreGameLogging() const {
@@ -1134,12 +1466,12 @@ class CharacterDepthComparer {
 
 // Add anything in the list of particles into the scene description:
 void GameState::AddParticlesToScene(SceneDescription* scene) const {
-  auto plist = particle_manager_.get_particle_list();
-  for (auto it = plist.begin(); it != plist.end(); ++it) {
-    scene->renderables().push_back(std::unique_ptr<Renderable>(
-        new Renderable((*it)->renderable_id(), 0, (*it)->CalculateMatrix(),
-                       (*it)->CurrentTint())));
-  }
+  // Make room for every particle up front, so the particle manager can fill
+  // in its slots from several threads at once.
+  std::vector<std::unique_ptr<Renderable>>& renderables = scene->renderables();
+  const size_t first = renderables.size();
+  renderables.resize(first + particle_manager_.get_particle_list().size());
+  particle_manager_.AddToScene(renderables.data() + first);
 }
 
 void GameState::PopulateScene(SceneDescription* scene) {
@@ -1202,6 +1534,9 @@ void GameState::PopulateScene(SceneDescription* scene) {
         mat4::FromRotationMatrix(
             Quat::FromAngleAxis(kPi, mathfu::kAxisY3f).ToMatrix()))));
   }
+
+  // Cache what the renderer needs in each renderable's own space.
+  scene->UpdateObjectSpace(camera_.Position());
 }
 
 }  // pie_noon
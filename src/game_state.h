@@ -17,6 +17,7 @@
 
 #include <memory>
 #include <vector>
+#include "ai_perception.h"
 #include "character.h"
 #include "components/cardboard_player.h"
 #include "components/drip_and_vanish.h"
@@ -25,11 +26,15 @@
 #include "components/shakeable_prop.h"
 #include "corgi/entity.h"
 #include "corgi/entity_manager.h"
+#include "event_schedule.h"
 #include "game_camera.h"
+#include "game_random.h"
+#include "game_state_snapshot.h"
 #include "motive/engine.h"
 #include "motive/processor.h"
 #include "motive/util.h"
 #include "particles.h"
+#include "pie_trajectory.h"
 
 namespace pindrop {
 class AudioEngine;
@@ -69,8 +74,24 @@ class GameState {
   void Reset();
 
   // Update controller and state machine for each character.
+  // 'audio_engine' may be null when running headless.
   void AdvanceFrame(WorldTime delta_time, pindrop::AudioEngine* audio_engine);
 
+  // Earliest time at which a frame of length 'frame_time' could change the
+  // game: a pie landing, a timeline event, a state machine condition
+  // starting to hold, or a controller producing input. Returns time() if
+  // the very next frame might.
+  WorldTime NextScheduledTime(WorldTime frame_time) const;
+
+  // For headless play. Jump over every frame of length 'frame_time' that
+  // ends before NextScheduledTime(), but not past 'max_time'. Characters,
+  // pies and scores end up exactly as if AdvanceFrame() had been called for
+  // each skipped frame; motion that is only for show is advanced in one
+  // step and particles are dropped. Returns the time skipped, which is 0 if
+  // the next frame has something to do. The caller should advance its
+  // controllers by the same amount.
+  WorldTime SkipIdleFrames(WorldTime frame_time, WorldTime max_time);
+
   // To be run before starting a game and after ending one to log data about
   // gameplay.
   void PreGameLogging() const;
@@ -79,6 +100,29 @@ class GameState {
   // Fill in the position of the characters and pies.
   void PopulateScene(SceneDescription* scene);
 
+  // Record the current simulation state in 'snapshot', overwriting whatever
+  // it held. Doesn't allocate once the snapshot's buffer is big enough.
+  // The camera and the scenery entities (prop shakes, splatters) are not
+  // recorded; they don't affect play.
+  void SaveSnapshot(GameStateSnapshot* snapshot,
+                    GameStateSnapshot::Contents contents =
+                        GameStateSnapshot::kSimulation) const;
+
+  // Return to the state recorded in 'snapshot'. Particles are only touched
+  // if the snapshot includes them. Returns false, and changes nothing, if
+  // the snapshot was taken from a game with a different number of
+  // characters or is otherwise malformed.
+  bool RestoreSnapshot(const GameStateSnapshot& snapshot);
+
+  // Hash of the state that decides the outcome of the game: every
+  // character's health, pie damage, state, target and score, every pie in
+  // flight, and the random number generator. Two games that have stayed in
+  // step hash the same, whichever build or device they ran on, so the
+  // headless runner uses it to check determinism. Hashed from scratch on each
+  // call: it's one pass over a few characters and pies, and is only wanted
+  // once a game is over.
+  uint32_t StateHash() const;
+
   // Angle between two characters.
   motive::Angle AngleBetweenCharacters(CharacterId source_id,
                                        CharacterId target_id) const;
@@ -122,9 +166,18 @@ class GameState {
 
   const CharacterArrangement& arrangement() const { return *arrangement_; }
 
+  // What the AI sees, as of the end of the last frame.
+  const AiPerception& perception() const { return perception_; }
+
   WorldTime time() const { return time_; }
 
-  void set_config(const Config* config) { config_ = config; }
+  // Start the game's random sequence again from 'seed'. The sequence is
+  // part of the snapshot, so a restored game makes the same choices.
+  void SeedRandom(uint32_t seed) { random_.Seed(seed); }
+
+  // Also compiles the particle emitters, so call it once the config has
+  // finished loading.
+  void set_config(const Config* config);
 
   void set_cardboard_config(const Config* config) {
     cardboard_config_ = config;
@@ -163,7 +216,7 @@ class GameState {
                  CharacterHealth damage);
   float CalculatePieYRotation(CharacterId source_id,
                               CharacterId target_id) const;
-  CharacterId DetermineDeflectionTarget(const ReceivedPie& pie) const;
+  CharacterId DetermineDeflectionTarget(const ReceivedPie& pie);
   void ProcessEvent(pindrop::AudioEngine* audio_engine, Character* character,
                     unsigned int event, const EventData& event_data);
   void PopulateConditionInputs(ConditionInputs* condition_inputs,
@@ -176,8 +229,14 @@ class GameState {
   void ProcessConditionalEvents(pindrop::AudioEngine* audio_engine,
                                 Character* character, EventData* event_data);
   void ProcessEvents(pindrop::AudioEngine* audio_engine, Character* character,
-                     EventData* data, WorldTime delta_time);
-  void UpdatePiePosition(AirbornePie* pie) const;
+                     EventData* data, WorldTime end_time);
+  void ResetEventSchedules();
+  void UpdateTimelineCursor(CharacterId id);
+  void ScheduleNextTimelineEvent(CharacterId id);
+  WorldTime NextCharacterChangeTime(const Character& character) const;
+  void RemovePie(const AirbornePie* pie);
+  void UpdateCountdownTimer();
+  void UpdatePiePositions();
   CharacterId CalculateCharacterTarget(CharacterId id) const;
   float CalculateCharacterFacingAngleVelocity(const Character* character,
                                               WorldTime delta_time) const;
@@ -190,7 +249,7 @@ class GameState {
   void CreatePieSplatter(pindrop::AudioEngine* audio_engine,
                          const Character& character, int damage);
   void CreateJoinConfettiBurst(const Character& character);
-  void SpawnParticles(const mathfu::vec3& position, const ParticleDef* def,
+  void SpawnParticles(const mathfu::vec3& position, const EmitterDesc& emitter,
                       const int particle_count,
                       const mathfu::vec4& base_tint = mathfu::vec4(1, 1, 1, 1));
   void ShakeProps(float percent, const mathfu::vec3& damage_position);
@@ -205,10 +264,46 @@ class GameState {
   GameCameraState camera_base_;
   std::vector<std::unique_ptr<Character>> characters_;
   std::vector<std::unique_ptr<AirbornePie>> pies_;
+  // All of the game's random choices. Never rand(), which would be shared
+  // with every other GameState, such as those in RolloutPlanner's workers.
+  GameRandom random_;
+
+  // Where each character is in the events of its current timeline.
+  struct TimelineCursor {
+    const Timeline* timeline;
+    WorldTime state_start_time;
+    // Index of the next event to process.
+    int next_event;
+  };
+  struct ScheduledTimelineEvent {
+    CharacterId id;
+    // Lets us drop the event if the character has changed state since.
+    WorldTime state_start_time;
+  };
+
+  // Calculates the matrices of all pies_ at once.
+  PieTrajectoryBatch pie_trajectories_;
+  // Set when pies_ gains or loses a pie, so pie_trajectories_ is rebuilt.
+  bool pies_changed_;
+
+  AiPerception perception_;
+
+  // Every pie in flight, by the time it lands.
+  EventSchedule<AirbornePie*> pie_impacts_;
+  // The next timeline event of each character.
+  EventSchedule<ScheduledTimelineEvent> timeline_events_;
+  // Indexed by CharacterId.
+  std::vector<TimelineCursor> timeline_cursors_;
+  std::vector<uint8_t> timeline_events_due_;
+
   motive::MotiveEngine engine_;
   const Config* config_;
   const CharacterArrangement* arrangement_;
   ParticleManager particle_manager_;
+  // The config's ParticleDefs, compiled by set_config().
+  EmitterDesc pie_splatter_emitter_;
+  EmitterDesc confetti_emitter_;
+  EmitterDesc joining_confetti_emitter_;
   AnalyticsMode analytics_mode_;
 
   // Entity manager that tracks all of our entities.
@@ -0,0 +1,120 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GAME_STATE_SNAPSHOT_H
+#define GAME_STATE_SNAPSHOT_H
+
+#include <cstdint>
+#include <vector>
+#include "character.h"
+
+namespace fpl {
+namespace pie_noon {
+
+// Everything about a Character that changes during a game. Plain data, so
+// it can be copied straight into and out of a GameStateSnapshot.
+struct CharacterSnapshot {
+  CharacterId target;
+  CharacterHealth health;
+  CharacterHealth pie_damage;
+  float position[3];
+  float face_angle;
+  float face_angle_velocity;
+  int32_t state;
+  WorldTime state_start_time;
+  uint16_t state_last_update;
+  uint8_t just_joined_game;
+  uint8_t visible;
+  int32_t score;
+  int32_t victory_state;
+  uint32_t is_down;
+  uint32_t went_down;
+  uint32_t went_up;
+  uint64_t player_stats[kMaxStats];
+};
+
+// The launch parameters of an AirbornePie. The pie's motion is a function of
+// these and the time since launch, so its Motivator can be rebuilt from them.
+struct AirbornePieSnapshot {
+  CharacterId original_source;
+  CharacterId source;
+  CharacterId target;
+  WorldTime start_time;
+  WorldTime flight_time;
+  CharacterHealth original_damage;
+  CharacterHealth damage;
+  float source_position[3];
+  float target_position[3];
+  float start_height;
+  float peak_height;
+  int32_t rotations;
+  float y_rotation;
+};
+
+// The simulation state of a GameState, packed into one contiguous block of
+// memory. Filled by GameState::SaveSnapshot() and consumed by
+// GameState::RestoreSnapshot().
+//
+// Reusing a snapshot object avoids any allocation once its buffer has grown
+// to fit, so keep a few around (e.g. in a ring for rollback) instead of
+// creating new ones each frame.
+//
+// The blob is only meaningful to a GameState with the same config and
+// number of characters. It holds no pointers, so it can be copied and kept
+// as long as you like, but it is not a stable file or network format.
+class GameStateSnapshot {
+ public:
+  enum Contents {
+    // Only what affects the outcome of the game: time, characters and pies.
+    kSimulation,
+    // Also the particles, so the scene looks the same after a restore.
+    kSimulationAndParticles
+  };
+
+  GameStateSnapshot() {}
+
+  const uint8_t* data() const { return blob_.data(); }
+  size_t size() const { return blob_.size(); }
+  bool empty() const { return blob_.empty(); }
+
+  // Replace the contents with a blob previously read from data().
+  void Assign(const uint8_t* data, size_t size) {
+    blob_.assign(data, data + size);
+  }
+
+ private:
+  friend class GameState;
+
+  // Always the first thing in the blob. The variable-length arrays follow it
+  // in the order of the counts.
+  struct Header {
+    uint32_t version;
+    uint32_t contents;
+    WorldTime time;
+    int32_t countdown_timer;
+    uint32_t random_state;
+    uint32_t num_characters;
+    uint32_t num_pies;
+    uint32_t num_particles;
+  };
+
+  static const uint32_t kVersion = 2;
+
+  std::vector<uint8_t> blob_;
+};
+
+}  // pie_noon
+}  // fpl
+
+#endif  // GAME_STATE_SNAPSHOT_H
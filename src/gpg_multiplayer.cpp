@@ -14,15 +14,48 @@
 
 #include "precompiled.h"
 #include <algorithm>
+#include <chrono>
 #include "fplbase/utilities.h"
 #include "gpg_multiplayer.h"
 
 namespace fpl {
 
+// How long the network thread sleeps between ticks. Short enough that sends
+// and incoming messages aren't noticeably delayed, long enough that the thread
+// isn't spinning.
+static const int kNetworkUpdateIntervalMicroseconds = 4000;
+
+// How often the network thread posts a fresh copy of its counters.
+static const int64_t kStatsPublishIntervalMicroseconds = 250000;
+
+// Monotonic clock for latency measurements. Safe to call from any thread.
+static int64_t NowMicroseconds() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
 GPGMultiplayer::GPGMultiplayer()
-    : message_mutex_(PTHREAD_MUTEX_INITIALIZER),
+    : state_(kIdle),
+      max_connected_players_allowed_(-1),
+      network_thread_started_(false),
+      network_thread_running_(false),
+      reset_count_requested_(0),
+      reset_count_processed_(0),
+      stats_publish_time_(0),
+      message_mutex_(PTHREAD_MUTEX_INITIALIZER),
       instance_mutex_(PTHREAD_MUTEX_INITIALIZER),
-      state_mutex_(PTHREAD_MUTEX_INITIALIZER) {}
+      state_mutex_(PTHREAD_MUTEX_INITIALIZER),
+      is_hosting_(false),
+      auto_connect_(false),
+      allow_reconnecting_(true) {}
+
+GPGMultiplayer::~GPGMultiplayer() {
+  if (network_thread_started_) {
+    network_thread_running_ = false;
+    pthread_join(network_thread_, nullptr);
+  }
+}
 
 bool GPGMultiplayer::Initialize(const std::string& service_id) {
   state_ = kIdle;
@@ -46,6 +79,18 @@ bool GPGMultiplayer::Initialize(const std::string& service_id) {
     return false;
   }
 
+  if (!network_thread_started_) {
+    network_thread_running_ = true;
+    if (pthread_create(&network_thread_, nullptr, NetworkThreadMain, this) !=
+        0) {
+      network_thread_running_ = false;
+      fplbase::LogError(fplbase::kApplication,
+                        "GPGMultiplayer: Unable to start the network thread.");
+      return false;
+    }
+    network_thread_started_ = true;
+  }
+
   return true;
 }
 
@@ -55,9 +100,387 @@ void GPGMultiplayer::AddAppIdentifier(const std::string& identifier) {
   app_identifiers_.push_back(id);
 }
 
-void GPGMultiplayer::StartAdvertising() { QueueNextState(kAdvertising); }
+// Public interface, called from the game thread. Each call is handed to the
+// network thread as a command; see ProcessCommand() for the other side.
+
+void GPGMultiplayer::StartAdvertising() {
+  PostCommand(kCommandStartAdvertising);
+}
+
+void GPGMultiplayer::StopAdvertising() { PostCommand(kCommandStopAdvertising); }
+
+void GPGMultiplayer::StartDiscovery() { PostCommand(kCommandStartDiscovery); }
+
+void GPGMultiplayer::StopDiscovery() { PostCommand(kCommandStopDiscovery); }
+
+void GPGMultiplayer::ResetToIdle() {
+  // Anything still in flight from before the reset is stale; Update() drops
+  // events tagged with an older count. PostCommand() never drops a reset, so
+  // the network thread is sure to catch up with this count.
+  PostCommand(kCommandResetToIdle);
+  reset_count_requested_++;
+  game_connected_instances_.clear();
+  game_connected_instances_reverse_.clear();
+  while (!game_incoming_messages_.empty()) game_incoming_messages_.pop();
+  while (!game_reconnected_players_.empty()) game_reconnected_players_.pop();
+  game_network_stats_ = NetworkStats();
+}
+
+void GPGMultiplayer::DisconnectInstance(const std::string& instance_id) {
+  NetworkCommand command;
+  command.type = kCommandDisconnectInstance;
+  command.instance_id = instance_id;
+  PostCommand(&command);
+}
+
+void GPGMultiplayer::DisconnectAll() { PostCommand(kCommandDisconnectAll); }
+
+void GPGMultiplayer::set_my_instance_name(const std::string& my_instance_name) {
+  NetworkCommand command;
+  command.type = kCommandSetInstanceName;
+  command.instance_id = my_instance_name;
+  PostCommand(&command);
+}
+
+bool GPGMultiplayer::SendMessage(const std::string& instance_id,
+                                 const std::vector<uint8_t>& payload,
+                                 bool reliable) {
+  if (GetPlayerNumberByInstanceId(instance_id) == -1) {
+    // Ensure we are actually connected to the specified instance.
+    return false;
+  }
+  NetworkCommand command;
+  command.type = kCommandSendMessage;
+  command.instance_id = instance_id;
+  command.payload = payload;
+  command.reliable = reliable;
+  return PostCommand(&command);
+}
+
+bool GPGMultiplayer::BroadcastMessage(const std::vector<uint8_t>& payload,
+                                      bool reliable) {
+  NetworkCommand command;
+  command.type = kCommandBroadcastMessage;
+  command.payload = payload;
+  command.reliable = reliable;
+  return PostCommand(&command);
+}
+
+bool GPGMultiplayer::PostCommand(NetworkCommandType type) {
+  NetworkCommand command;
+  command.type = type;
+  return PostCommand(&command);
+}
+
+bool GPGMultiplayer::PostCommand(NetworkCommand* command) {
+  command->post_time = NowMicroseconds();
+  // Keep commands in order: once anything is held back, everything after it
+  // has to wait its turn too.
+  FlushCommands();
+  if (held_commands_.empty() && command_queue_.Push(std::move(*command))) {
+    return true;
+  }
+  // Unreliable messages may be lost anyway, so don't let them pile up
+  // behind a network thread that has fallen behind. Everything else waits.
+  const bool droppable = (command->type == kCommandSendMessage ||
+                          command->type == kCommandBroadcastMessage) &&
+                         !command->reliable;
+  if (droppable) {
+    fplbase::LogError(fplbase::kApplication,
+                      "GPGMultiplayer: Command queue full, dropping "
+                      "unreliable message");
+    return false;
+  }
+  held_commands_.push(std::move(*command));
+  return true;
+}
+
+void GPGMultiplayer::FlushCommands() {
+  while (!held_commands_.empty() &&
+         command_queue_.Push(std::move(held_commands_.front()))) {
+    held_commands_.pop();
+  }
+}
+
+// Call me once a frame, from the game thread!
+void GPGMultiplayer::Update() {
+  FlushCommands();
+  NetworkEvent event;
+  while (event_queue_.Pop(&event)) {
+    if (event.reset_count != reset_count_requested_) {
+      // Posted before our most recent ResetToIdle().
+      continue;
+    }
+    switch (event.type) {
+      case kEventMessage: {
+        game_incoming_messages_.push(
+            SenderAndMessage(event.instance_id, std::move(event.payload)));
+        break;
+      }
+      case kEventReconnectedPlayer: {
+        game_reconnected_players_.push(event.player);
+        break;
+      }
+      case kEventConnectedInstances: {
+        game_connected_instances_.swap(event.instances);
+        game_connected_instances_reverse_.clear();
+        for (unsigned int i = 0; i < game_connected_instances_.size(); i++) {
+          game_connected_instances_reverse_[game_connected_instances_[i]] = i;
+        }
+        break;
+      }
+      case kEventStats: {
+        game_network_stats_ = std::move(event.stats);
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+  }
+}
+
+bool GPGMultiplayer::HasMessage() const {
+  return !game_incoming_messages_.empty();
+}
+
+GPGMultiplayer::SenderAndMessage GPGMultiplayer::GetNextMessage() {
+  if (HasMessage()) {
+    SenderAndMessage message;
+    message.first.swap(game_incoming_messages_.front().first);
+    message.second.swap(game_incoming_messages_.front().second);
+    game_incoming_messages_.pop();
+    return message;
+  } else {
+    SenderAndMessage blank{"", {}};
+    return blank;
+  }
+}
+
+bool GPGMultiplayer::HasReconnectedPlayer() const {
+  return !game_reconnected_players_.empty();
+}
+
+int GPGMultiplayer::GetReconnectedPlayer() {
+  if (game_reconnected_players_.empty()) {
+    return -1;
+  }
+  int player = game_reconnected_players_.front();
+  game_reconnected_players_.pop();
+  return player;
+}
+
+int GPGMultiplayer::GetNumConnectedPlayers() const {
+  int num_players = 0;
+  for (const auto& instance_id : game_connected_instances_) {
+    if (instance_id != "") {
+      num_players++;
+    }
+  }
+  return num_players;
+}
+
+int GPGMultiplayer::GetPlayerNumberByInstanceId(
+    const std::string& instance_id) const {
+  auto i = game_connected_instances_reverse_.find(instance_id);
+  return (i != game_connected_instances_reverse_.end()) ? i->second : -1;
+}
+
+std::string GPGMultiplayer::GetInstanceIdByPlayerNumber(
+    unsigned int player) const {
+  return (player < game_connected_instances_.size())
+             ? game_connected_instances_[player]
+             : "";
+}
+
+// The network thread. Everything from here down runs either on it or on one
+// of the NearbyConnections callback threads, never on the game thread.
+
+void* GPGMultiplayer::NetworkThreadMain(void* data) {
+  GPGMultiplayer* multiplayer = static_cast<GPGMultiplayer*>(data);
+  fplbase::LogInfo(fplbase::kApplication,
+                   "GPGMultiplayer: Network thread started");
+  while (multiplayer->network_thread_running_) {
+    multiplayer->NetworkUpdate();
+    usleep(kNetworkUpdateIntervalMicroseconds);
+  }
+  fplbase::LogInfo(fplbase::kApplication,
+                   "GPGMultiplayer: Network thread stopped");
+  return nullptr;
+}
+
+void GPGMultiplayer::NetworkUpdate() {
+  // Carry out everything the game thread asked for since last tick, in order.
+  network_stats_.command_queue_depth = command_queue_.Size();
+  network_stats_.max_command_queue_depth =
+      std::max(network_stats_.max_command_queue_depth,
+               network_stats_.command_queue_depth);
+  NetworkCommand command;
+  while (command_queue_.Pop(&command)) {
+    ProcessCommand(&command);
+  }
+
+  UpdateConnection();
+
+  // Publish the connected instances before anything that refers to them, so
+  // the game thread can look up the senders of the messages below.
+  PublishConnectedInstances();
 
-void GPGMultiplayer::StopAdvertising() {
+  pthread_mutex_lock(&instance_mutex_);
+  std::queue<int> reconnected_players;
+  reconnected_players.swap(reconnected_players_);
+  pthread_mutex_unlock(&instance_mutex_);
+  while (!reconnected_players.empty()) {
+    NetworkEvent event;
+    event.type = kEventReconnectedPlayer;
+    event.player = reconnected_players.front();
+    reconnected_players.pop();
+    PostEvent(&event);
+  }
+
+  pthread_mutex_lock(&message_mutex_);
+  MessageQueue incoming_messages;
+  incoming_messages.swap(incoming_messages_);
+  pthread_mutex_unlock(&message_mutex_);
+  while (!incoming_messages.empty()) {
+    InstanceStats& stats =
+        network_stats_.instances[incoming_messages.front().first];
+    stats.messages_received++;
+    stats.bytes_received += incoming_messages.front().second.size();
+
+    NetworkEvent event;
+    event.type = kEventMessage;
+    event.instance_id.swap(incoming_messages.front().first);
+    event.payload.swap(incoming_messages.front().second);
+    incoming_messages.pop();
+    PostEvent(&event);
+  }
+
+  FlushEvents();
+
+  network_stats_.event_queue_depth = event_queue_.Size() + held_events_.size();
+  network_stats_.max_event_queue_depth = std::max(
+      network_stats_.max_event_queue_depth, network_stats_.event_queue_depth);
+  const int64_t now = NowMicroseconds();
+  if (now - stats_publish_time_ >= kStatsPublishIntervalMicroseconds) {
+    stats_publish_time_ = now;
+    NetworkEvent event;
+    event.type = kEventStats;
+    event.stats = network_stats_;
+    PostEvent(&event);
+  }
+}
+
+void GPGMultiplayer::RecordSend(const std::string& instance_id,
+                                const NetworkCommand& command, int64_t now) {
+  InstanceStats& stats = network_stats_.instances[instance_id];
+  const uint64_t latency =
+      static_cast<uint64_t>(std::max<int64_t>(now - command.post_time, 0));
+  stats.messages_sent++;
+  stats.bytes_sent += command.payload.size();
+  stats.total_send_latency += latency;
+  stats.max_send_latency = std::max(stats.max_send_latency, latency);
+}
+
+void GPGMultiplayer::ProcessCommand(NetworkCommand* command) {
+  switch (command->type) {
+    case kCommandStartAdvertising: {
+      QueueNextState(kAdvertising);
+      break;
+    }
+    case kCommandStopAdvertising: {
+      StopAdvertisingInternal();
+      break;
+    }
+    case kCommandStartDiscovery: {
+      QueueNextState(kDiscovering);
+      break;
+    }
+    case kCommandStopDiscovery: {
+      StopDiscoveryInternal();
+      break;
+    }
+    case kCommandDisconnectInstance: {
+      DisconnectInstanceInternal(command->instance_id);
+      break;
+    }
+    case kCommandDisconnectAll: {
+      DisconnectAllInternal();
+      break;
+    }
+    case kCommandResetToIdle: {
+      ResetToIdleInternal();
+      break;
+    }
+    case kCommandSetInstanceName: {
+      my_instance_name_ = command->instance_id;
+      break;
+    }
+    case kCommandSendMessage: {
+      if (command->reliable) {
+        nearby_connections_->SendReliableMessage(command->instance_id,
+                                                 command->payload);
+      } else {
+        nearby_connections_->SendUnreliableMessage(command->instance_id,
+                                                   command->payload);
+      }
+      RecordSend(command->instance_id, *command, NowMicroseconds());
+      break;
+    }
+    case kCommandBroadcastMessage: {
+      pthread_mutex_lock(&instance_mutex_);
+      std::vector<std::string> all_instances{connected_instances_.begin(),
+                                             connected_instances_.end()};
+      pthread_mutex_unlock(&instance_mutex_);
+      if (command->reliable) {
+        nearby_connections_->SendReliableMessage(all_instances,
+                                                 command->payload);
+      } else {
+        nearby_connections_->SendUnreliableMessage(all_instances,
+                                                   command->payload);
+      }
+      const int64_t now = NowMicroseconds();
+      for (const auto& instance_id : all_instances) {
+        if (instance_id != "") RecordSend(instance_id, *command, now);
+      }
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+}
+
+void GPGMultiplayer::PostEvent(NetworkEvent* event) {
+  event->reset_count = reset_count_processed_;
+  // Keep events in order: once anything is held back, everything after it
+  // has to wait its turn too.
+  if (!held_events_.empty() || !event_queue_.Push(std::move(*event))) {
+    held_events_.push(std::move(*event));
+  }
+}
+
+void GPGMultiplayer::FlushEvents() {
+  while (!held_events_.empty() &&
+         event_queue_.Push(std::move(held_events_.front()))) {
+    held_events_.pop();
+  }
+}
+
+void GPGMultiplayer::PublishConnectedInstances() {
+  pthread_mutex_lock(&instance_mutex_);
+  const bool changed = connected_instances_ != published_instances_;
+  if (changed) published_instances_ = connected_instances_;
+  pthread_mutex_unlock(&instance_mutex_);
+  if (changed) {
+    NetworkEvent event;
+    event.type = kEventConnectedInstances;
+    event.instances = published_instances_;
+    PostEvent(&event);
+  }
+}
+
+void GPGMultiplayer::StopAdvertisingInternal() {
   pthread_mutex_lock(&instance_mutex_);
   int num_connected_instances = connected_instances_.size();
   pthread_mutex_unlock(&instance_mutex_);
@@ -68,9 +491,7 @@ void GPGMultiplayer::StopAdvertising() {
   }
 }
 
-void GPGMultiplayer::StartDiscovery() { QueueNextState(kDiscovering); }
-
-void GPGMultiplayer::StopDiscovery() {
+void GPGMultiplayer::StopDiscoveryInternal() {
   // check if we are connected
   pthread_mutex_lock(&instance_mutex_);
   int num_connected_instances = connected_instances_.size();
@@ -82,9 +503,9 @@ void GPGMultiplayer::StopDiscovery() {
   }
 }
 
-void GPGMultiplayer::ResetToIdle() {
+void GPGMultiplayer::ResetToIdleInternal() {
   QueueNextState(kIdle);
-  DisconnectAll();
+  DisconnectAllInternal();
 
   pthread_mutex_lock(&instance_mutex_);
   connected_instances_.clear();
@@ -97,9 +518,17 @@ void GPGMultiplayer::ResetToIdle() {
   pthread_mutex_lock(&message_mutex_);
   while (!incoming_messages_.empty()) incoming_messages_.pop();
   pthread_mutex_unlock(&message_mutex_);
+
+  // The game thread already dropped its copy of all of the above when it
+  // posted the reset. Anything still held back is from before the reset.
+  reset_count_processed_++;
+  published_instances_.clear();
+  while (!held_events_.empty()) held_events_.pop();
+  network_stats_ = NetworkStats();
 }
 
-void GPGMultiplayer::DisconnectInstance(const std::string& instance_id) {
+void GPGMultiplayer::DisconnectInstanceInternal(
+    const std::string& instance_id) {
   fplbase::LogInfo(fplbase::kApplication,
           "GPGMultiplayer: Disconnect player (instance_id='%s')",
           instance_id.c_str());
@@ -120,7 +549,7 @@ void GPGMultiplayer::DisconnectInstance(const std::string& instance_id) {
   }
 }
 
-void GPGMultiplayer::DisconnectAll() {
+void GPGMultiplayer::DisconnectAllInternal() {
   fplbase::LogInfo(fplbase::kApplication,
                    "GPGMultiplayer: Disconnect all players");
   // In case there are any connection requests outstanding, reject them.
@@ -232,11 +661,11 @@ void GPGMultiplayer::RejectAllConnectionRequests() {
   pthread_mutex_unlock(&instance_mutex_);
 }
 
-// Call me once a frame!
-void GPGMultiplayer::Update() {
+// Call me once per network thread tick.
+void GPGMultiplayer::UpdateConnection() {
   pthread_mutex_lock(&state_mutex_);  // unlocked in two places below
   if (!next_states_.empty()) {
-    // Transition at most one state per frame.
+    // Transition at most one state per tick.
     MultiplayerState next_state = next_states_.front();
     next_states_.pop();
     pthread_mutex_unlock(&state_mutex_);
@@ -305,7 +734,7 @@ void GPGMultiplayer::Update() {
           // Not a disconnected instance. Reject.
           RejectConnectionRequest(pending_instances_.front());
         } else if (max_connected_players_allowed() >= 0 &&
-                   GetNumConnectedPlayers() >=
+                   CountConnectedInstances() >=
                        max_connected_players_allowed()) {
           // Too many players to allow us back. Reject. But we might be
           // allowed back again in the future.
@@ -324,7 +753,7 @@ void GPGMultiplayer::Update() {
 
       if (has_pending_instance) {
         if (max_connected_players_allowed() >= 0 &&
-            GetNumConnectedPlayers() >= max_connected_players_allowed()) {
+            CountConnectedInstances() >= max_connected_players_allowed()) {
           // Already have a full game, auto-reject any additional players.
           RejectConnectionRequest(pending_instances_.front());
         } else {
@@ -508,76 +937,6 @@ void GPGMultiplayer::QueueNextState(MultiplayerState next_state) {
   pthread_mutex_unlock(&state_mutex_);
 }
 
-bool GPGMultiplayer::SendMessage(const std::string& instance_id,
-                                 const std::vector<uint8_t>& payload,
-                                 bool reliable) {
-  if (GetPlayerNumberByInstanceId(instance_id) == -1) {
-    // Ensure we are actually connected to the specified instance.
-    return false;
-  } else {
-  }
-
-  if (reliable) {
-    nearby_connections_->SendReliableMessage(instance_id, payload);
-  } else {
-    nearby_connections_->SendUnreliableMessage(instance_id, payload);
-  }
-  return true;
-}
-
-void GPGMultiplayer::BroadcastMessage(const std::vector<uint8_t>& payload,
-                                      bool reliable) {
-  pthread_mutex_lock(&instance_mutex_);
-  std::vector<std::string> all_instances{connected_instances_.begin(),
-                                         connected_instances_.end()};
-  pthread_mutex_unlock(&instance_mutex_);
-  if (reliable) {
-    nearby_connections_->SendReliableMessage(all_instances, payload);
-  } else {
-    nearby_connections_->SendUnreliableMessage(all_instances, payload);
-  }
-}
-
-bool GPGMultiplayer::HasMessage() {
-  pthread_mutex_lock(&message_mutex_);
-  bool empty = incoming_messages_.empty();
-  pthread_mutex_unlock(&message_mutex_);
-  return !empty;
-}
-
-GPGMultiplayer::SenderAndMessage GPGMultiplayer::GetNextMessage() {
-  if (HasMessage()) {
-    pthread_mutex_lock(&message_mutex_);
-    auto message = incoming_messages_.front();
-    incoming_messages_.pop();
-    pthread_mutex_unlock(&message_mutex_);
-    return message;
-  } else {
-    SenderAndMessage blank{"", {}};
-    return blank;
-  }
-}
-
-bool GPGMultiplayer::HasReconnectedPlayer() {
-  pthread_mutex_lock(&instance_mutex_);
-  bool has_reconnected_player = !reconnected_players_.empty();
-  pthread_mutex_unlock(&instance_mutex_);
-  return has_reconnected_player;
-}
-
-int GPGMultiplayer::GetReconnectedPlayer() {
-  pthread_mutex_lock(&instance_mutex_);
-  if (reconnected_players_.empty()) {
-    pthread_mutex_unlock(&instance_mutex_);
-    return -1;
-  } else {
-    int player = reconnected_players_.front();
-    reconnected_players_.pop();
-    pthread_mutex_unlock(&instance_mutex_);
-    return player;
-  }
-}
-
 // Callbacks are below.
 
 // Callback on the host when it starts advertising.
@@ -672,7 +1031,7 @@ void GPGMultiplayer::MessageReceivedCallback(
 // Callback on host or client when a connected instance disconnects.
 void GPGMultiplayer::DisconnectedCallback(const std::string& instance_id) {
   if (allow_reconnecting() && is_hosting() && IsConnected() &&
-      GetNumConnectedPlayers() > 1) {
+      CountConnectedInstances() > 1) {
     // We are connected, and we have other instances connected besides this one.
     // Rather than simply disconnecting this instance, let's remember it so we
     // can give it back its connection slot if it tries to reconnect.
@@ -702,7 +1061,7 @@ void GPGMultiplayer::DisconnectedCallback(const std::string& instance_id) {
       UpdateConnectedInstances();
     }
     pthread_mutex_unlock(&instance_mutex_);
-    if (IsConnected() && GetNumConnectedPlayers() == 0) {
+    if (IsConnected() && CountConnectedInstances() == 0) {
       QueueNextState(kIdle);
     }
   }
@@ -766,7 +1125,7 @@ void GPGMultiplayer::ClearDisconnectedInstances() {
   while (!reconnected_players_.empty()) reconnected_players_.pop();
 }
 
-int GPGMultiplayer::GetNumConnectedPlayers() {
+int GPGMultiplayer::CountConnectedInstances() {
   int num_players = 0;
   pthread_mutex_lock(&instance_mutex_);
   for (auto instance_id : connected_instances_) {
@@ -778,26 +1137,9 @@ int GPGMultiplayer::GetNumConnectedPlayers() {
   return num_players;
 }
 
-int GPGMultiplayer::GetPlayerNumberByInstanceId(
-    const std::string& instance_id) {
-  pthread_mutex_lock(&instance_mutex_);
-  auto i = connected_instances_reverse_.find(instance_id);
-  int player_num = ((i != connected_instances_reverse_.end()) ? i->second : -1);
-  pthread_mutex_unlock(&instance_mutex_);
-  return player_num;
-}
-
-std::string GPGMultiplayer::GetInstanceIdByPlayerNumber(unsigned int player) {
-  pthread_mutex_lock(&instance_mutex_);
-  // Copy out of thread-unsafe storage.
-  std::string instance_id = (player < connected_instances_.size())
-                                ? connected_instances_[player]
-                                : "";
-  pthread_mutex_unlock(&instance_mutex_);
-  return instance_id;
-}
-
 // JNI calls for displaying the connection prompt and getting the results.
+// These are made from the network thread; fplbase::AndroidGetJNIEnv() attaches
+// it to the VM the first time through.
 
 // Show a dialog box, allowing the user to reply to a Yes or No question.
 bool GPGMultiplayer::DisplayConnectionDialog(const char* title,
@@ -28,6 +28,14 @@
 // frame, and then retreive incoming messages from a queue whenever is
 // convenient.
 //
+// All connection management (discovery, advertising, prompting, reconnection)
+// and all outgoing sends happen on a dedicated network thread, started by
+// Initialize(). The game thread never waits on it: the public functions below
+// post commands to a lock-free queue, and Update() drains a lock-free queue of
+// events (incoming messages, reconnections, and changes to the set of
+// connected instances) coming back the other way. The query functions only
+// look at the game thread's copy of that data, so none of them take a lock.
+//
 // To start, call Initialize() and pass in a unique service ID for your game.
 // After this point you should start calling Update() each frame. You can also
 // call set_my_instance_name() to set a human-readable name for your instance
@@ -52,12 +60,15 @@
 #ifndef GPG_MULTIPLAYER_H
 #define GPG_MULTIPLAYER_H
 
+#include <atomic>
 #include <list>
 #include <map>
 #include <queue>
 #include <string>
 #include <vector>
 
+#include "spsc_queue.h"
+
 namespace fpl {
 
 class GPGMultiplayer {
@@ -86,6 +97,47 @@ class GPGMultiplayer {
     kError = 8
   };
 
+  // Traffic counters for one connected instance.
+  struct InstanceStats {
+    InstanceStats()
+        : messages_sent(0),
+          bytes_sent(0),
+          messages_received(0),
+          bytes_received(0),
+          total_send_latency(0),
+          max_send_latency(0) {}
+    uint64_t messages_sent;
+    uint64_t bytes_sent;
+    uint64_t messages_received;
+    uint64_t bytes_received;
+    // Send latency is the time, in microseconds, between the game thread
+    // calling SendMessage() or BroadcastMessage() and the network thread
+    // handing the message to NearbyConnections.
+    uint64_t total_send_latency;
+    uint64_t max_send_latency;
+    uint64_t AverageSendLatency() const {
+      return messages_sent ? total_send_latency / messages_sent : 0;
+    }
+  };
+
+  // Counters for the whole connection, keyed by instance ID. Instances stay in
+  // the map after they disconnect, until ResetToIdle().
+  struct NetworkStats {
+    NetworkStats()
+        : command_queue_depth(0),
+          max_command_queue_depth(0),
+          event_queue_depth(0),
+          max_event_queue_depth(0) {}
+    std::map<std::string, InstanceStats> instances;
+    // Commands waiting for the network thread, as of its last tick.
+    size_t command_queue_depth;
+    size_t max_command_queue_depth;
+    // Events waiting for the game thread (including any held back because the
+    // event queue was full), as of the network thread's last tick.
+    size_t event_queue_depth;
+    size_t max_event_queue_depth;
+  };
+
   // The user's response to a connection dialog.
   enum DialogResponse {
     // The user responded "No" to the prompt.
@@ -99,16 +151,21 @@ class GPGMultiplayer {
   // Initializes mutexes only.
   GPGMultiplayer();
 
-  // Initialize the connection manager, set up callbacks, etc.
-  // Call this before doing anything else but after initializing
-  // GameServices. service_id should be unique for your game.
+  // Stops and joins the network thread, if it was started.
+  ~GPGMultiplayer();
+
+  // Initialize the connection manager, set up callbacks, etc., and start the
+  // network thread. Call this before doing anything else but after
+  // initializing GameServices. service_id should be unique for your game.
   bool Initialize(const std::string& service_id);
 
   // Add an app identifier that is used for linking to your device's app store,
-  // if a user scanning for games doesn't have this one installed.
+  // if a user scanning for games doesn't have this one installed. Call this
+  // before Initialize().
   void AddAppIdentifier(const std::string& identifier);
 
-  // Update, call this once per frame if you can.
+  // Update, call this once per frame from the game thread. Picks up whatever
+  // the network thread has posted since the last call. Never blocks.
   void Update();
 
   // Broadcast that you are hosting a game. To change the name from the default,
@@ -135,12 +192,11 @@ class GPGMultiplayer {
 
   // Set the name that will be shown to clients performing discovery,
   // or shown to hosts when you send a connection request.
-  void set_my_instance_name(const std::string& my_instance_name) {
-    my_instance_name_ = my_instance_name;
-  }
+  void set_my_instance_name(const std::string& my_instance_name);
 
-  // Get the current multiplayer state.
-  MultiplayerState state() const { return state_; }
+  // Get the current multiplayer state. Owned by the network thread, so this
+  // may change between two calls in the same frame.
+  MultiplayerState state() const { return state_.load(); }
 
   // Are you fully connected and no longer advertising or discovering?
   bool IsConnected() const {
@@ -160,41 +216,47 @@ class GPGMultiplayer {
   bool HasError() const { return state() == kError; }
 
   // Get the number of players we have connected. If you are a client, this will
-  // be at most 1, since you are only connected to the host.
-  int GetNumConnectedPlayers();
+  // be at most 1, since you are only connected to the host. As of the last
+  // Update().
+  int GetNumConnectedPlayers() const;
 
   // Return true if this user is the host, false if you are a client.
-  bool is_hosting() const { return is_hosting_; }
+  bool is_hosting() const { return is_hosting_.load(); }
 
   // Get the instance ID of a connected instance by player number, or empty if
-  // you pass in an invalid player number. This locks a mutex so you're best off
-  // caching this value for performance.
-  std::string GetInstanceIdByPlayerNumber(unsigned int player);
+  // you pass in an invalid player number. As of the last Update().
+  std::string GetInstanceIdByPlayerNumber(unsigned int player) const;
 
   // Get the player number of a connected instance by instance ID (the reverse
   // of GetInstanceIdByPlayerNumber), or -1 if there is no such connected
-  // instance. This locks a mutex so you're best off caching this value for
-  // performance.
-  int GetPlayerNumberByInstanceId(const std::string& instance_id);
+  // instance. As of the last Update().
+  int GetPlayerNumberByInstanceId(const std::string& instance_id) const;
 
   // Send a message to a specific instance. Returns false if you are not
-  // connected to that instance (in which case nothing is sent).
+  // connected to that instance, or if the message is unreliable and the
+  // network thread has fallen too far behind to take it (in which case
+  // nothing is sent). Reliable messages wait their turn instead.
   bool SendMessage(const std::string& instance_id,
                    const std::vector<uint8_t>& payload, bool reliable);
 
   // For the host: broadcast to all clients. For the client, sends just to host.
-  void BroadcastMessage(const std::vector<uint8_t>& payload, bool reliable);
+  // Returns false if an unreliable message was dropped, as for SendMessage().
+  bool BroadcastMessage(const std::vector<uint8_t>& payload, bool reliable);
 
   // Returns true if there are one or more messages available in the queue.
   // You would then call GetNextMessage() to retrieve the next message.
-  bool HasMessage();
+  bool HasMessage() const;
 
   // Get the latest incoming message, or a blank sender and message if there are
   // none.
   SenderAndMessage GetNextMessage();
 
   // Returns true if a player has just reconnected.
-  bool HasReconnectedPlayer();
+  bool HasReconnectedPlayer() const;
+
+  // Traffic counters, as published by the network thread a few times a
+  // second. Updated by Update().
+  const NetworkStats& network_stats() const { return game_network_stats_; }
 
   // Gets the player ID of a player that has just reconnected. There may
   // be more than one, so keep checking this until HasReconnectedPlayer()
@@ -205,30 +267,90 @@ class GPGMultiplayer {
   // counting the host itself). Set this to a negative number to allow an
   // unlimited number of players.
   void set_max_connected_players_allowed(int players) {
-    max_connected_players_allowed_ = players;
+    max_connected_players_allowed_.store(players);
   }
   int max_connected_players_allowed() const {
-    return max_connected_players_allowed_;
+    return max_connected_players_allowed_.load();
   }
 
   // On the host, set this to true to automatically allow users to connect.
   // On the client, set this to true to automatically connect to the first host.
-  void set_auto_connect(bool b) { auto_connect_ = b; }
+  void set_auto_connect(bool b) { auto_connect_.store(b); }
 
   // If true, we will automatically connect.
-  bool auto_connect() const { return auto_connect_; }
+  bool auto_connect() const { return auto_connect_.load(); }
 
   // Set to true to allow a disconnected user to reconnect into their previous
   // slot. If you allow this, you can find a reconnected player by calling
   // GetReconnectedPlayer().
-  void set_allow_reconnecting(bool b) { allow_reconnecting_ = b; }
+  void set_allow_reconnecting(bool b) { allow_reconnecting_.store(b); }
 
   // If true, we allow disconnected users to reconnect.
-  bool allow_reconnecting() const { return allow_reconnecting_; }
+  bool allow_reconnecting() const { return allow_reconnecting_.load(); }
 
  private:
   typedef std::queue<SenderAndMessage> MessageQueue;
 
+  // Requests from the game thread to the network thread.
+  enum NetworkCommandType {
+    kCommandNone,
+    kCommandStartAdvertising,
+    kCommandStopAdvertising,
+    kCommandStartDiscovery,
+    kCommandStopDiscovery,
+    kCommandDisconnectInstance,
+    kCommandDisconnectAll,
+    kCommandResetToIdle,
+    kCommandSetInstanceName,
+    kCommandSendMessage,
+    kCommandBroadcastMessage,
+  };
+
+  struct NetworkCommand {
+    NetworkCommand() : type(kCommandNone), reliable(false), post_time(0) {}
+    NetworkCommandType type;
+    // Target of kCommandSendMessage and kCommandDisconnectInstance, or the new
+    // name for kCommandSetInstanceName.
+    std::string instance_id;
+    std::vector<uint8_t> payload;
+    bool reliable;
+    // When the game thread posted this, in microseconds. Used to measure
+    // send latency.
+    int64_t post_time;
+  };
+
+  // Notifications from the network thread to the game thread.
+  enum NetworkEventType {
+    kEventNone,
+    // A message arrived from 'instance_id'.
+    kEventMessage,
+    // 'player' has reconnected into its old slot.
+    kEventReconnectedPlayer,
+    // 'instances' is the new list of connected instance IDs, by player.
+    kEventConnectedInstances,
+    // 'stats' is the latest copy of network_stats_.
+    kEventStats,
+  };
+
+  struct NetworkEvent {
+    NetworkEvent() : type(kEventNone), player(-1), reset_count(0) {}
+    NetworkEventType type;
+    std::string instance_id;
+    std::vector<uint8_t> payload;
+    int player;
+    std::vector<std::string> instances;
+    NetworkStats stats;
+    // The number of ResetToIdle() calls the network thread had processed when
+    // this event was posted. Lets the game thread drop stale events.
+    unsigned int reset_count;
+  };
+
+  // Big enough to absorb a burst of messages during a long frame. If the
+  // network thread does fill the event queue, it holds on to the overflow
+  // until the game thread catches up, so nothing is dropped.
+  static const size_t kCommandQueueSize = 256;
+  static const size_t kEventQueueSize = 256;
+
   // Listens for hosts that are advertising.
   class DiscoveryListener : public gpg::IEndpointDiscoveryListener {
    public:
@@ -280,6 +402,54 @@ class GPGMultiplayer {
     std::function<void(const std::string&)> disconnected_callback_;
   };
 
+  // Entry point of the network thread. 'data' is the GPGMultiplayer.
+  static void* NetworkThreadMain(void* data);
+
+  // One tick of the network thread: run queued commands, advance the
+  // connection state machine, and post events for the game thread.
+  void NetworkUpdate();
+
+  // The connection state machine. Runs on the network thread only.
+  void UpdateConnection();
+
+  // Carry out a command posted by the game thread. Network thread only.
+  void ProcessCommand(NetworkCommand* command);
+
+  // Hand a command to the network thread. Game thread only. If the command
+  // queue is full, the command is held back until there's room, except for
+  // unreliable messages, which are dropped and return false.
+  bool PostCommand(NetworkCommandType type);
+  bool PostCommand(NetworkCommand* command);
+
+  // Push as many held-back commands as will fit into command_queue_.
+  void FlushCommands();
+
+  // Queue an event for the game thread. Network thread only.
+  void PostEvent(NetworkEvent* event);
+
+  // Push as many held-back events as will fit into event_queue_.
+  void FlushEvents();
+
+  // Count a message handed to NearbyConnections for 'instance_id'.
+  void RecordSend(const std::string& instance_id, const NetworkCommand& command,
+                  int64_t now);
+
+  // Post kEventConnectedInstances if connected_instances_ changed since the
+  // last time we posted it.
+  void PublishConnectedInstances();
+
+  // The network-thread implementations of the public functions of the same
+  // names.
+  void StopAdvertisingInternal();
+  void StopDiscoveryInternal();
+  void DisconnectInstanceInternal(const std::string& instance_id);
+  void DisconnectAllInternal();
+  void ResetToIdleInternal();
+
+  // Number of non-empty slots in connected_instances_. Locks instance_mutex_,
+  // so never call this from the game thread.
+  int CountConnectedInstances();
+
   // Enter a new state, exiting the previous one first.
   void TransitionState(MultiplayerState old_state, MultiplayerState new_state);
 
@@ -359,16 +529,51 @@ class GPGMultiplayer {
   // so the user code can send them a game state update.
   std::queue<int> reconnected_players_;
 
-  // List of incoming messages. Lock message_mutex_ before using.
+  // List of incoming messages, filled in by the message callback and emptied
+  // by the network thread. Lock message_mutex_ before using.
   MessageQueue incoming_messages_;
 
-  // Our current state.
-  MultiplayerState state_;
-  // Our next state(s). Will enter the next one during the next Update().
+  // Our current state. Only the network thread writes this.
+  std::atomic<MultiplayerState> state_;
+  // Our next state(s). Will enter the next one during the next network tick.
   std::queue<MultiplayerState> next_states_;
 
+  // Network thread only.
   std::string my_instance_name_;
-  int max_connected_players_allowed_;  // 0 to allow any number
+  std::atomic<int> max_connected_players_allowed_;  // 0 to allow any number
+
+  // The network thread, and whether it should keep running.
+  pthread_t network_thread_;
+  bool network_thread_started_;
+  std::atomic<bool> network_thread_running_;
+
+  // Game thread -> network thread.
+  SpscQueue<NetworkCommand, kCommandQueueSize> command_queue_;
+  // Commands that didn't fit in command_queue_ yet. Game thread only.
+  std::queue<NetworkCommand> held_commands_;
+  // Network thread -> game thread.
+  SpscQueue<NetworkEvent, kEventQueueSize> event_queue_;
+  // Events that didn't fit in event_queue_ yet. Network thread only.
+  std::queue<NetworkEvent> held_events_;
+  // Network thread only. The connected_instances_ we last told the game
+  // thread about.
+  std::vector<std::string> published_instances_;
+  // ResetToIdle() calls made (game thread) and processed (network thread).
+  unsigned int reset_count_requested_;
+  unsigned int reset_count_processed_;
+
+  // Network thread only. The running counters, and when we last posted a copy
+  // of them to the game thread.
+  NetworkStats network_stats_;
+  int64_t stats_publish_time_;
+
+  // The game thread's view of the network state, rebuilt from events in
+  // Update(). Game thread only, so no locking.
+  std::vector<std::string> game_connected_instances_;
+  std::map<std::string, int> game_connected_instances_reverse_;
+  MessageQueue game_incoming_messages_;
+  std::queue<int> game_reconnected_players_;
+  NetworkStats game_network_stats_;
 
   // Mutex for the incoming_messages_ queue.
   pthread_mutex_t message_mutex_;
@@ -381,12 +586,14 @@ class GPGMultiplayer {
   // callback setting an error condition.
   pthread_mutex_t state_mutex_;
 
-  bool is_hosting_;    // This is set to true if we are the host.
-  bool auto_connect_;  // If this is true, connections will be automatically
-                       // approved without prompting.
-  bool allow_reconnecting_;  // If this is true, a client disconnecting while a
-                             // host is connected will have its slot reserved
-                             // for reconnection.
+  std::atomic<bool> is_hosting_;    // This is set to true if we are the host.
+  std::atomic<bool> auto_connect_;  // If this is true, connections will be
+                                    // automatically approved without
+                                    // prompting.
+  std::atomic<bool> allow_reconnecting_;  // If this is true, a client
+                                          // disconnecting while a host is
+                                          // connected will have its slot
+                                          // reserved for reconnection.
 };
 
 }  // namespace fpl
@@ -0,0 +1,87 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+
+#include "headless_game.h"
+
+namespace fpl {
+namespace pie_noon {
+
+HeadlessGame::HeadlessGame() : config_(nullptr) {}
+
+void HeadlessGame::Initialize(
+    const Config* config, const CharacterStateMachineDef* state_machine_def,
+    std::vector<std::unique_ptr<AiController>>* controllers) {
+  config_ = config;
+  controllers_.swap(*controllers);
+  game_state_.set_config(config);
+  for (size_t i = 0; i < controllers_.size(); ++i) {
+    game_state_.characters().push_back(std::unique_ptr<Character>(
+        new Character(static_cast<CharacterId>(i), controllers_[i].get(),
+                      *config, state_machine_def)));
+  }
+  // Reset() registers components with the entity system, which isn't safe
+  // to do from several threads, so later games restore this snapshot
+  // instead.
+  game_state_.Reset(GameState::kNoAnalytics);
+  game_state_.SaveSnapshot(&start_);
+  InitializeControllers(0);
+}
+
+void HeadlessGame::Restart(uint32_t seed) {
+  Restore(start_, seed);
+  game_state_.SeedRandom(seed);
+}
+
+bool HeadlessGame::Restore(const GameStateSnapshot& snapshot,
+                           uint32_t seed) {
+  InitializeControllers(seed);
+  return game_state_.RestoreSnapshot(snapshot);
+}
+
+void HeadlessGame::InitializeControllers(uint32_t seed) {
+  for (size_t i = 0; i < controllers_.size(); ++i) {
+    controllers_[i]->Initialize(&game_state_, config_,
+                                static_cast<CharacterId>(i));
+    controllers_[i]->Seed(seed);
+  }
+}
+
+void HeadlessGame::PlayUntil(WorldTime end_time, WorldTime frame_time) {
+  frame_time = std::max(frame_time, 1);
+  // GameState::IsGameOver() waits for the humans, and there are none here.
+  while (game_state_.time() < end_time && NumStanding() > 1) {
+    const WorldTime skipped = game_state_.SkipIdleFrames(frame_time, end_time);
+    const WorldTime delta_time = skipped > 0 ? skipped : frame_time;
+    for (auto it = controllers_.begin(); it != controllers_.end(); ++it) {
+      (*it)->AdvanceFrame(delta_time);
+    }
+    if (skipped == 0) {
+      game_state_.AdvanceFrame(frame_time, nullptr);
+    }
+  }
+}
+
+int HeadlessGame::NumStanding() const {
+  int num_standing = 0;
+  const auto& characters = game_state_.characters();
+  for (auto it = characters.begin(); it != characters.end(); ++it) {
+    if ((*it)->health() > 0) num_standing++;
+  }
+  return num_standing;
+}
+
+}  // pie_noon
+}  // fpl
@@ -0,0 +1,77 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HEADLESS_GAME_H
+#define HEADLESS_GAME_H
+
+#include <memory>
+#include <vector>
+#include "ai_controller.h"
+#include "game_state.h"
+#include "game_state_snapshot.h"
+
+namespace fpl {
+namespace pie_noon {
+
+// A game between AiControllers that nobody watches or hears: no rendering,
+// no audio, and idle stretches skipped with GameState::SkipIdleFrames().
+// Used to try out moves and tunings. Each HeadlessGame is independent, so
+// several can be played at once on different threads.
+class HeadlessGame {
+ public:
+  HeadlessGame();
+
+  // Create one character per controller, which we take ownership of. Sets
+  // up the game, so must be called on one thread at a time. 'config' and
+  // 'state_machine_def' must outlive us, and the motivator types must
+  // already be registered.
+  void Initialize(const Config* config,
+                  const CharacterStateMachineDef* state_machine_def,
+                  std::vector<std::unique_ptr<AiController>>* controllers);
+
+  // Go back to the start of a game, with the game's and the controllers'
+  // random sequences started from 'seed'. Games restarted with the same
+  // seed play out the same, whichever thread they're on.
+  void Restart(uint32_t seed);
+
+  // Go back to the game saved in 'snapshot', with the controllers'
+  // random sequences started from 'seed'. Returns false if it is from a
+  // game with a different number of characters.
+  bool Restore(const GameStateSnapshot& snapshot, uint32_t seed = 0);
+
+  // Advance in frames of 'frame_time' until 'end_time', or until at most
+  // one character has health left.
+  void PlayUntil(WorldTime end_time, WorldTime frame_time);
+
+  // Characters that still have health left.
+  int NumStanding() const;
+
+  const GameState& game_state() const { return game_state_; }
+  AiController* controller(CharacterId id) { return controllers_[id].get(); }
+
+ private:
+  void InitializeControllers(uint32_t seed);
+
+  const Config* config_;
+  // The characters point at these, so they go before game_state_.
+  std::vector<std::unique_ptr<AiController>> controllers_;
+  GameState game_state_;
+  // The game just after Reset().
+  GameStateSnapshot start_;
+};
+
+}  // pie_noon
+}  // fpl
+
+#endif  // HEADLESS_GAME_H
@@ -0,0 +1,78 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "precompiled.h"
+
+#include "job_thread.h"
+
+namespace fpl {
+
+JobThread::JobThread() : busy_(false), quit_(false) {}
+
+JobThread::~JobThread() { Shutdown(); }
+
+void JobThread::Initialize() {
+  Shutdown();
+  quit_ = false;
+  thread_ = std::thread(&JobThread::ThreadMain, this);
+}
+
+void JobThread::Shutdown() {
+  if (!thread_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  job_ready_.notify_one();
+  thread_.join();
+}
+
+void JobThread::Start(const std::function<void()>& job) {
+  if (!thread_.joinable()) {
+    job();
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  job_done_.wait(lock, [this] { return !busy_; });
+  job_ = job;
+  busy_ = true;
+  job_ready_.notify_one();
+}
+
+void JobThread::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  job_done_.wait(lock, [this] { return !busy_; });
+}
+
+void JobThread::ThreadMain() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    // Finish the job in hand before quitting, so that Wait() can't hang.
+    job_ready_.wait(lock, [this] { return quit_ || busy_; });
+    if (busy_) {
+      lock.unlock();
+      job_();
+      lock.lock();
+      job_ = nullptr;
+      busy_ = false;
+      job_done_.notify_one();
+      continue;
+    }
+    if (quit_) return;
+  }
+}
+
+}  // namespace fpl
@@ -0,0 +1,71 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef JOB_THREAD_H
+#define JOB_THREAD_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace fpl {
+
+// A thread that runs one job at a time, so that whoever hands it the job can
+// get on with something else in the meantime. Start() returns as soon as the
+// job is handed over; Wait() returns once it has finished.
+//
+// Only one thread may call Start() and Wait().
+class JobThread {
+ public:
+  JobThread();
+  ~JobThread();
+
+  // Start the thread. Until this is called, Start() runs each job on the
+  // calling thread before returning.
+  void Initialize();
+
+  // Run 'job' on the thread. Waits for the previous job first, if it hasn't
+  // finished.
+  void Start(const std::function<void()>& job);
+
+  // Return once the last job passed to Start() has finished.
+  void Wait();
+
+  bool running() const { return thread_.joinable(); }
+
+ private:
+  void ThreadMain();
+  void Shutdown();
+
+  std::thread thread_;
+
+  // Everything below is protected by mutex_.
+  std::mutex mutex_;
+  // Signalled when a job is posted, or when the thread is shutting down.
+  std::condition_variable job_ready_;
+  // Signalled when a job finishes.
+  std::condition_variable job_done_;
+  std::function<void()> job_;
+  bool busy_;
+  bool quit_;
+
+  JobThread(const JobThread&);
+  void operator=(const JobThread&);
+};
+
+}  // namespace fpl
+
+#endif  // JOB_THREAD_H
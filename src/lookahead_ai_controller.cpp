@@ -0,0 +1,83 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "lookahead_ai_controller.h"
+
+namespace fpl {
+namespace pie_noon {
+
+LookaheadAiController::LookaheadAiController()
+    : Controller(kTypeAI),
+      gamestate_(nullptr),
+      config_(nullptr),
+      planner_(nullptr),
+      frame_snapshot_(nullptr),
+      waiting_for_plan_(false),
+      action_end_(0) {
+  action_.type = LookaheadAction::kCharge;
+  action_.target = kNoCharacter;
+}
+
+void LookaheadAiController::Initialize(
+    GameState* gamestate, const Config* config, CharacterId character_id,
+    RolloutPlanner* planner, const GameStateSnapshot* frame_snapshot) {
+  gamestate_ = gamestate;
+  config_ = config;
+  character_id_ = character_id;
+  planner_ = planner;
+  frame_snapshot_ = frame_snapshot;
+  waiting_for_plan_ = false;
+  action_end_ = 0;
+}
+
+void LookaheadAiController::AdvanceFrame(WorldTime /*delta_time*/) {
+  if (character_id_ == kNoCharacter) {
+    return;
+  }
+  ClearAllLogicalInputs();
+  if (!gamestate_->characters()[character_id_]->CanAct()) return;
+
+  // Plans arrive a few frames after they're asked for, so always have the
+  // next one on the way.
+  LookaheadAction planned;
+  if (planner_->TakePlan(character_id_, &planned)) {
+    action_ = planned;
+    action_end_ = gamestate_->time() + config_->ai_lookahead_commit_time();
+    waiting_for_plan_ = false;
+  }
+  if (!waiting_for_plan_) {
+    planner_->RequestPlan(character_id_, *frame_snapshot_);
+    waiting_for_plan_ = true;
+  }
+
+  if (gamestate_->time() >= action_end_) return;
+  if (action_.type == LookaheadAction::kBlock &&
+      gamestate_->is_in_cardboard()) {
+    return;
+  }
+  ApplyLookaheadAction(action_, *gamestate_->characters()[character_id_],
+                       this);
+}
+
+void LookaheadAiController::OnGameReset() {
+  if (waiting_for_plan_) planner_->CancelPlan(character_id_);
+  waiting_for_plan_ = false;
+  action_.type = LookaheadAction::kCharge;
+  action_.target = kNoCharacter;
+  action_end_ = 0;
+}
+
+}  // pie_noon
+}  // fpl
@@ -0,0 +1,65 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LOOKAHEAD_AI_CONTROLLER_H_
+#define LOOKAHEAD_AI_CONTROLLER_H_
+
+#include "common.h"
+#include "config_generated.h"
+#include "controller.h"
+#include "game_state.h"
+#include "rollout_planner.h"
+
+namespace fpl {
+namespace pie_noon {
+
+// The hardest computer player. It keeps a RolloutPlanner busy working out
+// its next move from the latest state of the game, and carries out each
+// move it gets back for ai_lookahead_commit_time. Planning happens off the
+// game thread, and plans start from a snapshot taken before the AIs run,
+// so AdvanceFrame() is safe to run alongside the other controllers.
+class LookaheadAiController : public Controller {
+ public:
+  LookaheadAiController();
+
+  // Give the AI everything it will need. 'planner' and 'frame_snapshot'
+  // must outlive it, and 'frame_snapshot' must hold the current game
+  // whenever AdvanceFrame() is called.
+  void Initialize(GameState* gamestate, const Config* config,
+                  CharacterId character_id, RolloutPlanner* planner,
+                  const GameStateSnapshot* frame_snapshot);
+
+  // Pick up a new plan if one is ready, and carry out the current one.
+  virtual void AdvanceFrame(WorldTime delta_time);
+
+  // Drop the current plan, and any plan still on its way, since they were
+  // made for the old game.
+  virtual void OnGameReset();
+
+ private:
+  GameState* gamestate_;     // Pointer to the gamestate object
+  const Config* config_;     // Pointer to the config structure
+  RolloutPlanner* planner_;  // Shared by all lookahead AIs
+  // The game as of the start of this frame. Shared by all lookahead AIs.
+  const GameStateSnapshot* frame_snapshot_;
+  bool waiting_for_plan_;
+
+  LookaheadAction action_;
+  WorldTime action_end_;
+};
+
+}  // pie_noon
+}  // fpl
+
+#endif  // LOOKAHEAD_AI_CONTROLLER_H_
@@ -22,7 +22,7 @@ namespace fpl {
 namespace pie_noon {
 
 MultiplayerDirector::MultiplayerDirector()
-    : turn_timer_(0), debug_input_system_(nullptr) {}
+    : turn_timer_(0), debug_input_system_(nullptr), last_ping_time_(0) {}
 
 void MultiplayerDirector::Initialize(GameState* gamestate,
                                      const Config* config) {
@@ -42,6 +42,7 @@ void MultiplayerDirector::RegisterController(
   controllers_.push_back(controller);
   commands_.push_back(Command());
   character_splats_.push_back(0);
+  player_network_stats_.push_back(PlayerNetworkStats());
 }
 
 void MultiplayerDirector::StartGame() {
@@ -54,6 +55,7 @@ void MultiplayerDirector::StartGame() {
     commands_[i].aim_at = (i + 1) % commands_.size();
     commands_[i].is_firing = false;
     commands_[i].is_blocking = false;
+    commands_[i].sequence = 0;
   }
   for (unsigned int i = 0; i < controllers_.size(); i++) {
     controllers_[i]->Reset();
@@ -61,6 +63,9 @@ void MultiplayerDirector::StartGame() {
   for (unsigned int i = 0; i < character_splats_.size(); i++) {
     character_splats_[i] = 0;
   }
+  for (unsigned int i = 0; i < player_network_stats_.size(); i++) {
+    player_network_stats_[i] = PlayerNetworkStats();
+  }
 }
 
 void MultiplayerDirector::EndGame() {
@@ -211,13 +216,19 @@ bool MultiplayerDirector::IsAIPlayer(CharacterId player) {
 void MultiplayerDirector::InputPlayerCommand(
     CharacterId id, const multiplayer::PlayerCommand& player_command) {
   Command command;
-  if (player_command.aim_at() >= 0) {
-    command.aim_at = (CharacterId)player_command.aim_at();
-  } else {
+  const CharacterId aim_at = player_command.aim_at();
+  if (aim_at < 0) {
     command.aim_at = kNoCharacter;
+  } else if (aim_at == id || aim_at >= static_cast<int>(commands_.size())) {
+    // Can't aim at yourself or at nobody. Keep the previous target; the
+    // client will pick that up from the next PlayerStatus.
+    command.aim_at = commands_[id].aim_at;
+  } else {
+    command.aim_at = aim_at;
   }
   command.is_firing = player_command.is_firing() != 0;
   command.is_blocking = player_command.is_blocking() != 0;
+  command.sequence = player_command.sequence();
   commands_[id] = command;
 }
 
@@ -256,98 +267,45 @@ void MultiplayerDirector::ChooseAICommand(CharacterId id) {
   // If action is still > 0, command has the action from the previous turn,
   // don't change it.
 
-  unsigned int self = static_cast<unsigned int>(id);  // for comparison
-  std::vector<unsigned int> candidate_targets;
+  const AiPerception& perception = gamestate_->perception();
+  candidate_targets_.clear();
   // Choose how to target opponents.
   float target = mathfu::Random<float>();
   if (target < options->ai_chance_to_target_largest_pie()) {
-    // First get the max pie damage. Then put everyone with that pie damage
-    // into the candidate targets list.
     fplbase::LogInfo(fplbase::kApplication,
                      "MultiplayerDirector: AI %d targeting largest pie",
             id);
-
-    int max_pie = -1;
-    for (unsigned int i = 0; i < controllers_.size(); i++) {
-      const Character& enemy = controllers_[i]->GetCharacter();
-      if (i == self || enemy.health() <= 0) continue;  // ignore self/dead enemy
-      if (enemy.pie_damage() > max_pie) {
-        max_pie = enemy.pie_damage();
-      }
-    }
-    for (unsigned int i = 0; i < controllers_.size(); i++) {
-      const Character& enemy = controllers_[i]->GetCharacter();
-      if (i == self || enemy.health() <= 0) continue;  // ignore self/dead enemy
-      if (enemy.pie_damage() == max_pie) {
-        candidate_targets.push_back(i);
-      }
-    }
+    perception.LargestPieTargets(id, &candidate_targets_);
   }
   target -= options->ai_chance_to_target_largest_pie();
   if (target >= 0 && target < options->ai_chance_to_target_lowest_health()) {
-    // First get the lowest enemy health. Then put everyone with that health
-    // into the candidate targets list.
     fplbase::LogInfo(fplbase::kApplication,
                      "MultiplayerDirector: AI %d targeting lowest health",
             id);
-    int min_health = config_->character_health() + 1;
-    for (unsigned int i = 0; i < controllers_.size(); i++) {
-      const Character& enemy = controllers_[i]->GetCharacter();
-      if (i == self || enemy.health() <= 0) continue;  // ignore self/dead enemy
-      if (enemy.health() < min_health) {
-        min_health = enemy.health();
-      }
-    }
-    for (unsigned int i = 0; i < controllers_.size(); i++) {
-      const Character& enemy = controllers_[i]->GetCharacter();
-      if (i == self || enemy.health() <= 0) continue;  // ignore self/dead enemy
-      if (enemy.health() == min_health) {
-        candidate_targets.push_back(i);
-      }
-    }
+    perception.LowestHealthTargets(id, &candidate_targets_);
   }
   target -= options->ai_chance_to_target_lowest_health();
   if (target >= 0 && target < options->ai_chance_to_target_highest_health()) {
-    // First get the highest enemy health. Then put everyone with that health
-    // into the candidate targets list.
     fplbase::LogInfo(fplbase::kApplication,
                      "MultiplayerDirector: AI %d targeting highest health",
             id);
-    int max_health = -1;
-    for (unsigned int i = 0; i < controllers_.size(); i++) {
-      const Character& enemy = controllers_[i]->GetCharacter();
-      if (i == self || enemy.health() <= 0) continue;  // ignore self/dead enemy
-      if (enemy.health() > max_health) {
-        max_health = enemy.health();
-      }
-    }
-    for (unsigned int i = 0; i < controllers_.size(); i++) {
-      const Character& enemy = controllers_[i]->GetCharacter();
-      if (i == self || enemy.health() <= 0) continue;  // ignore self/dead enemy
-      if (enemy.health() == max_health) {
-        candidate_targets.push_back(i);
-      }
-    }
+    perception.HighestHealthTargets(id, &candidate_targets_);
   }
   target -= options->ai_chance_to_target_highest_health();
   if (target >= 0 && target < options->ai_chance_to_target_random()) {
     fplbase::LogInfo(fplbase::kApplication,
                      "MultiplayerDirector: AI %d targeting randomly", id);
     // Just put all living enemies in the list.
-    for (unsigned int i = 0; i < controllers_.size(); i++) {
-      const Character& enemy = controllers_[i]->GetCharacter();
-      if (i == self || enemy.health() <= 0) continue;  // ignore self/dead enemy
-      candidate_targets.push_back(i);
-    }
+    perception.AllTargets(id, &candidate_targets_);
   }
   target -= options->ai_chance_to_target_random();
   // If target is still > 0, command has the action from the previous turn,
   // don't change it.
 
-  if (candidate_targets.size() > 0) {
+  if (candidate_targets_.size() > 0) {
     int which = mathfu::RandomInRange<int>(
-        0, static_cast<int>(candidate_targets.size()));
-    command.aim_at = candidate_targets[which];
+        0, static_cast<int>(candidate_targets_.size()));
+    command.aim_at = candidate_targets_[which];
   }
   // If we have no candidate targets, we won't change aim at all.
 
@@ -499,15 +457,27 @@ void MultiplayerDirector::SendPlayerAssignmentMsg(const std::string& instance,
   gpg_multiplayer_->SendMessage(instance, message, true);
 }
 
-void MultiplayerDirector::SendStartTurnMsg(unsigned int seconds) {
-  // read the player healths
+flatbuffers::Offset<multiplayer::PlayerStatus>
+MultiplayerDirector::BuildPlayerStatus(flatbuffers::FlatBufferBuilder* builder) {
   std::vector<uint8_t> health_vec = ReadPlayerHealth();
   std::vector<uint8_t> splats_vec = ReadPlayerSplats();
+  std::vector<multiplayer::CommandAck> commands_vec;
+  for (auto it = commands_.begin(); it != commands_.end(); ++it) {
+    commands_vec.push_back(multiplayer::CommandAck(
+        static_cast<int8_t>(it->aim_at), it->is_firing, it->is_blocking,
+        it->sequence));
+  }
+
+  auto health = builder->CreateVector(health_vec);
+  auto splats = builder->CreateVector(splats_vec);
+  auto commands = builder->CreateVectorOfStructs(commands_vec);
+  return multiplayer::CreatePlayerStatus(*builder, health, splats,
+                                         gamestate_->time(), commands);
+}
 
+void MultiplayerDirector::SendStartTurnMsg(unsigned int seconds) {
   flatbuffers::FlatBufferBuilder builder;
-  auto health = builder.CreateVector(health_vec);
-  auto splats = builder.CreateVector(splats_vec);
-  auto player_status = multiplayer::CreatePlayerStatus(builder, health, splats);
+  auto player_status = BuildPlayerStatus(&builder);
   auto message_root = multiplayer::CreateMessageRoot(
       builder, multiplayer::Data_StartTurn,
       multiplayer::CreateStartTurn(builder, (unsigned short)seconds,
@@ -521,13 +491,8 @@ void MultiplayerDirector::SendStartTurnMsg(unsigned int seconds) {
 }
 
 void MultiplayerDirector::SendEndGameMsg() {
-  std::vector<uint8_t> health_vec = ReadPlayerHealth();
-  std::vector<uint8_t> splats_vec = ReadPlayerSplats();
-
   flatbuffers::FlatBufferBuilder builder;
-  auto health = builder.CreateVector(health_vec);
-  auto splats = builder.CreateVector(splats_vec);
-  auto player_status = multiplayer::CreatePlayerStatus(builder, health, splats);
+  auto player_status = BuildPlayerStatus(&builder);
   auto message_root = multiplayer::CreateMessageRoot(
       builder, multiplayer::Data_EndGame,
       multiplayer::CreateEndGame(builder, player_status).Union());
@@ -539,15 +504,10 @@ void MultiplayerDirector::SendEndGameMsg() {
 }
 
 void MultiplayerDirector::SendPlayerStatusMsg() {
-  std::vector<uint8_t> health_vec = ReadPlayerHealth();
-  std::vector<uint8_t> splats_vec = ReadPlayerSplats();
-
   flatbuffers::FlatBufferBuilder builder;
-  auto health = builder.CreateVector(health_vec);
-  auto splats = builder.CreateVector(splats_vec);
   auto message_root = multiplayer::CreateMessageRoot(
       builder, multiplayer::Data_PlayerStatus,
-      multiplayer::CreatePlayerStatus(builder, health, splats).Union());
+      BuildPlayerStatus(&builder).Union());
   builder.Finish(message_root);
 
   std::vector<uint8_t> message(builder.GetBufferPointer(),
@@ -555,8 +515,66 @@ void MultiplayerDirector::SendPlayerStatusMsg() {
   gpg_multiplayer_->BroadcastMessage(message, false);  // Send unreliably.
 }
 
+void MultiplayerDirector::SendPingMsgs(WorldTime world_time) {
+  const int interval =
+      config_->multiscreen_options()->ping_interval_milliseconds();
+  if (interval <= 0 || world_time - last_ping_time_ < interval) return;
+  last_ping_time_ = world_time;
+
+  flatbuffers::FlatBufferBuilder builder;
+  auto message_root = multiplayer::CreateMessageRoot(
+      builder, multiplayer::Data_Ping,
+      multiplayer::CreatePing(builder, world_time).Union());
+  builder.Finish(message_root);
+
+  std::vector<uint8_t> message(builder.GetBufferPointer(),
+                               builder.GetBufferPointer() + builder.GetSize());
+  for (unsigned int i = 0; i < player_network_stats_.size(); i++) {
+    const std::string instance =
+        gpg_multiplayer_->GetInstanceIdByPlayerNumber(i);
+    // Unreliable, so retransmissions don't hide how the radio is doing.
+    if (instance != "" &&
+        gpg_multiplayer_->SendMessage(instance, message, false)) {
+      player_network_stats_[i].pings_sent++;
+    }
+  }
+}
+
+void MultiplayerDirector::SendPongMsg(const std::string& instance,
+                                      const multiplayer::Ping& ping) {
+  flatbuffers::FlatBufferBuilder builder;
+  auto message_root = multiplayer::CreateMessageRoot(
+      builder, multiplayer::Data_Pong,
+      multiplayer::CreatePong(builder, ping.timestamp()).Union());
+  builder.Finish(message_root);
+
+  std::vector<uint8_t> message(builder.GetBufferPointer(),
+                               builder.GetBufferPointer() + builder.GetSize());
+  gpg_multiplayer_->SendMessage(instance, message, false);
+}
+
 #endif  // PIE_NOON_USES_GOOGLE_PLAY_GAMES
 
+void MultiplayerDirector::ReceivePong(CharacterId player,
+                                      const multiplayer::Pong& pong,
+                                      WorldTime world_time) {
+  if (player < 0 || player >= static_cast<int>(player_network_stats_.size()))
+    return;
+  const WorldTime round_trip = world_time - pong.timestamp();
+  // A Pong for a ping sent before a reset of the world clock.
+  if (round_trip < 0) return;
+
+  PlayerNetworkStats& stats = player_network_stats_[player];
+  stats.smoothed_round_trip =
+      stats.pongs_received == 0
+          ? round_trip
+          : stats.smoothed_round_trip +
+                (round_trip - stats.smoothed_round_trip) / 8;
+  stats.pongs_received++;
+  stats.last_round_trip = round_trip;
+  stats.max_round_trip = std::max(stats.max_round_trip, round_trip);
+}
+
 std::vector<uint8_t> MultiplayerDirector::ReadPlayerHealth() {
   std::vector<uint8_t> vec;
   for (auto iter = controllers_.begin(); iter != controllers_.end(); ++iter) {
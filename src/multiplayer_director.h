@@ -30,6 +30,23 @@
 namespace fpl {
 namespace pie_noon {
 
+// Round-trip times to one player, measured by Ping and Pong messages.
+// All times are in milliseconds.
+struct PlayerNetworkStats {
+  PlayerNetworkStats()
+      : pings_sent(0),
+        pongs_received(0),
+        last_round_trip(0),
+        smoothed_round_trip(0),
+        max_round_trip(0) {}
+  int pings_sent;
+  int pongs_received;
+  WorldTime last_round_trip;
+  // Moving average, weighted 1/8 towards each new sample.
+  WorldTime smoothed_round_trip;
+  WorldTime max_round_trip;
+};
+
 // MultiplayerDirector is used for the multiscreen version of Pie Noon.
 //
 // It is responsible for managing the timings of all of the turns, receiving the
@@ -78,8 +95,22 @@ class MultiplayerDirector {
   void SendEndGameMsg();
   // Broadcast player health to the players.
   void SendPlayerStatusMsg();
+  // On the host, ping every connected player if it has been at least
+  // ping_interval_milliseconds since the last round of pings.
+  void SendPingMsgs(WorldTime world_time);
+  // On the client, answer a Ping from the host.
+  void SendPongMsg(const std::string &instance, const multiplayer::Ping &ping);
 #endif
 
+  // On the host, record the round trip for a Pong received from 'player'.
+  void ReceivePong(CharacterId player, const multiplayer::Pong &pong,
+                   WorldTime world_time);
+
+  // Round-trip statistics for 'player', as measured on the host.
+  const PlayerNetworkStats &player_network_stats(CharacterId player) const {
+    return player_network_stats_[player];
+  }
+
   // Takes effect when the next turn starts.
   void set_seconds_per_turn(unsigned int seconds) {
     seconds_per_turn_ = seconds;
@@ -117,7 +148,10 @@ class MultiplayerDirector {
     CharacterId aim_at;
     bool is_firing;
     bool is_blocking;
-    Command() : aim_at(-1), is_firing(false), is_blocking(false) {}
+    // Sequence number of the PlayerCommand this came from.
+    uint16_t sequence;
+    Command()
+        : aim_at(-1), is_firing(false), is_blocking(false), sequence(0) {}
   };
 
   void TriggerStartOfTurn();
@@ -127,6 +161,13 @@ class MultiplayerDirector {
   // Get all the players' healths so we can send them in an update
   std::vector<uint8_t> ReadPlayerHealth();
 
+#ifdef PIE_NOON_USES_GOOGLE_PLAY_GAMES
+  // Build the PlayerStatus that goes in StartTurn, EndGame and PlayerStatus
+  // messages.
+  flatbuffers::Offset<multiplayer::PlayerStatus> BuildPlayerStatus(
+      flatbuffers::FlatBufferBuilder *builder);
+#endif
+
   // Tell the multiplayer director to choose AI commands for this player.
   void ChooseAICommand(CharacterId id);
 
@@ -152,6 +193,13 @@ class MultiplayerDirector {
   fplbase::InputSystem *debug_input_system_;
 
   std::vector<Command> commands_;
+  // Scratch space for ChooseAICommand. Kept so it's only allocated once.
+  std::vector<CharacterId> candidate_targets_;
+
+  // Per player, indexed like controllers_.
+  std::vector<PlayerNetworkStats> player_network_stats_;
+  // When we last sent out a round of pings.
+  WorldTime last_ping_time_;
 
 #ifdef PIE_NOON_USES_GOOGLE_PLAY_GAMES
   GPGMultiplayer *gpg_multiplayer_ = nullptr;
@@ -1,10 +1,148 @@
+#include <math.h>
+#include <algorithm>
 #include "particles.h"
+#include "fplbase/flatbuffer_utils.h"
+#include "particles_generated.h"
+#include "worker_pool.h"
 
 namespace fpl {
 namespace pie_noon {
 
 const int kMaxParticles = 1000;
 
+// Particles are split into chunks of this many for the worker threads.
+// Large enough that each chunk is worth handing to another thread.
+const int kParticlesPerChunk = 128;
+
+// The random values SpawnParticles draws for each particle. spawn_values_
+// holds one column of 'count' values for each of these, in this order.
+enum SpawnValue {
+  kSpawnScaleX,
+  kSpawnVelocityX = kSpawnScaleX + 3,
+  kSpawnPositionX = kSpawnVelocityX + 3,
+  kSpawnOrientationX = kSpawnPositionX + 3,
+  kSpawnAngularVelocityX = kSpawnOrientationX + 3,
+  kSpawnDuration = kSpawnAngularVelocityX + 3,
+  kSpawnTint,
+  kSpawnRenderable,
+  kNumSpawnValues
+};
+
+EmitterDesc::EmitterDesc()
+    : min_scale(mathfu::kOnes3f),
+      scale_range(mathfu::kZeros3f),
+      preserve_aspect(false),
+      min_velocity(mathfu::kZeros3f),
+      velocity_range(mathfu::kZeros3f),
+      min_position_offset(mathfu::kZeros3f),
+      position_offset_range(mathfu::kZeros3f),
+      min_orientation_offset(mathfu::kZeros3f),
+      orientation_offset_range(mathfu::kZeros3f),
+      min_angular_velocity(mathfu::kZeros3f),
+      angular_velocity_range(mathfu::kZeros3f),
+      acceleration(mathfu::kZeros3f),
+      min_duration(0),
+      duration_range(0),
+      shrink_duration(0),
+      fade_duration(0),
+      priority(0),
+      budget_share(0.0f),
+      emitter_id(kNoEmitter) {}
+
+void EmitterDesc::Compile(const ParticleDef& def) {
+  min_scale = LoadVec3(def.min_scale());
+  scale_range = LoadVec3(def.max_scale()) - min_scale;
+  preserve_aspect = def.preserve_aspect();
+  min_velocity = LoadVec3(def.min_velocity());
+  velocity_range = LoadVec3(def.max_velocity()) - min_velocity;
+  min_position_offset = LoadVec3(def.min_position_offset());
+  position_offset_range =
+      LoadVec3(def.max_position_offset()) - min_position_offset;
+  min_orientation_offset = LoadVec3(def.min_orientation_offset());
+  orientation_offset_range =
+      LoadVec3(def.max_orientation_offset()) - min_orientation_offset;
+  min_angular_velocity = LoadVec3(def.min_angular_velocity());
+  angular_velocity_range =
+      LoadVec3(def.max_angular_velocity()) - min_angular_velocity;
+  acceleration = LoadVec3(def.acceleration());
+  min_duration = static_cast<float>(def.min_duration());
+  duration_range = static_cast<float>(def.max_duration() - def.min_duration());
+  shrink_duration = static_cast<TimeStep>(def.shrink_duration());
+  fade_duration = static_cast<TimeStep>(def.fade_duration());
+  priority = std::max(def.priority(), 0);
+  budget_share = mathfu::Clamp(def.budget_share(), 0.0f, 1.0f);
+
+  tints.clear();
+  if (def.tint()) {
+    for (auto it = def.tint()->begin(); it != def.tint()->end(); ++it) {
+      tints.push_back(LoadVec4(*it));
+    }
+  }
+  renderables.clear();
+  if (def.renderable()) {
+    for (auto it = def.renderable()->begin(); it != def.renderable()->end();
+         ++it) {
+      renderables.push_back(static_cast<uint16_t>(*it));
+    }
+  }
+}
+
+// Weight given to the newest frame time in the budget's running average.
+static const float kFrameTimeSmoothing = 0.1f;
+// The budget only grows once frames are this far under target, so it doesn't
+// flip-flop around the target.
+static const float kGrowThreshold = 0.9f;
+
+ParticleBudget::ParticleBudget()
+    : def_(nullptr),
+      max_particles_(kMaxParticles),
+      max_priority_(0),
+      cap_(static_cast<float>(kMaxParticles)),
+      average_frame_time_(0) {}
+
+void ParticleBudget::Initialize(const ParticleBudgetDef* def,
+                                int max_particles) {
+  def_ = def;
+  max_particles_ = max_particles;
+  cap_ = static_cast<float>(max_particles);
+  average_frame_time_ = 0;
+}
+
+void ParticleBudget::AdvanceFrame(TimeStep frame_time) {
+  if (def_ == nullptr) return;
+  average_frame_time_ =
+      average_frame_time_ == 0
+          ? frame_time
+          : average_frame_time_ +
+                (frame_time - average_frame_time_) * kFrameTimeSmoothing;
+
+  const float target = def_->target_frame_milliseconds();
+  if (average_frame_time_ > target) {
+    cap_ -= cap_ * def_->shrink_rate();
+  } else if (average_frame_time_ < target * kGrowThreshold) {
+    cap_ += static_cast<float>(def_->grow_rate());
+  }
+  const float min_particles = static_cast<float>(
+      std::min(def_->min_particles(), max_particles_));
+  cap_ = mathfu::Clamp(cap_, min_particles,
+                       static_cast<float>(max_particles_));
+}
+
+float ParticleBudget::SpawnScale(int priority) const {
+  if (def_ == nullptr || max_priority_ <= 0) return 1.0f;
+  const float min_particles = static_cast<float>(def_->min_particles());
+  const float headroom = static_cast<float>(max_particles_) - min_particles;
+  if (headroom <= 0.0f) return 1.0f;
+
+  // 0 at the full budget, 1 at the minimum.
+  const float pressure = (max_particles_ - cap_) / headroom;
+  // Each priority below the highest is cut back over its own band of
+  // pressure, lowest priority first.
+  const float scale =
+      static_cast<float>(priority + 1) - pressure * max_priority_;
+  return mathfu::Clamp(scale, 0.0f, 1.0f);
+}
+
 void Particle::reset() {
   base_position_ = mathfu::vec3(0, 0, 0);
   base_velocity_ = mathfu::vec3(0, 0, 0);
@@ -17,6 +155,7 @@ void Particle::reset() {
   age_ = 0;
   duration_of_fade_out_ = 0;
   duration_of_shrink_out_ = 0;
+  emitter_id_ = kNoEmitter;
 }
 
 mathfu::mat4 Particle::CalculateMatrix() const {
@@ -64,16 +203,98 @@ mathfu::vec3 Particle::CurrentScale() const {
               : 1.0f);
 }
 
-void ParticleManager::AdvanceFrame(TimeStep delta_time) {
-  for (auto it = particle_list_.begin(); it != particle_list_.end();) {
-    (*it)->AdvanceFrame(delta_time);
-    if ((*it)->IsFinished()) {
-      inactive_particle_list_.push_back(*it);
-      it = particle_list_.erase(it);
+void ParticleManager::ForEachChunk(
+    int count, const std::function<void(int, int)>& chunk) const {
+  const int num_chunks = (count + kParticlesPerChunk - 1) / kParticlesPerChunk;
+  auto job = [count, &chunk](int index) {
+    const int begin = index * kParticlesPerChunk;
+    chunk(begin, std::min(begin + kParticlesPerChunk, count));
+  };
+  if (worker_pool_ != nullptr) {
+    worker_pool_->ParallelFor(num_chunks, job);
+  } else {
+    for (int i = 0; i < num_chunks; ++i) job(i);
+  }
+}
+
+void ParticleManager::AdvanceChunk(int begin, int end, TimeStep delta_time,
+                                   ChunkResult* result) {
+  result->finished.clear();
+  result->emitter_counts.assign(emitters_.size(), 0);
+  int live = begin;
+  for (int i = begin; i < end; ++i) {
+    Particle* p = particle_list_[i];
+    p->AdvanceFrame(delta_time);
+    if (p->IsFinished()) {
+      result->finished.push_back(p);
     } else {
-      ++it;
+      // Never overtakes 'i', so only this chunk's range is touched.
+      particle_list_[live++] = p;
+      const uint16_t emitter_id = p->emitter_id();
+      if (emitter_id < result->emitter_counts.size()) {
+        result->emitter_counts[emitter_id]++;
+      }
+    }
+  }
+  result->num_live = live - begin;
+}
+
+void ParticleManager::AdvanceFrame(TimeStep delta_time) {
+  const int num_particles = static_cast<int>(particle_list_.size());
+  const size_t num_chunks = static_cast<size_t>(
+      (num_particles + kParticlesPerChunk - 1) / kParticlesPerChunk);
+  if (chunk_results_.size() < num_chunks) chunk_results_.resize(num_chunks);
+  ForEachChunk(num_particles, [this, delta_time](int begin, int end) {
+    AdvanceChunk(begin, end, delta_time,
+                 &chunk_results_[begin / kParticlesPerChunk]);
+  });
+
+  // Stitch the chunks back together in order. The counts are rebuilt from
+  // scratch, so they also pick up particles created without SpawnParticles
+  // (e.g. restored from a snapshot).
+  std::fill(emitter_particle_counts_.begin(), emitter_particle_counts_.end(),
+            0);
+  auto live_end = particle_list_.begin();
+  for (size_t c = 0; c < num_chunks; ++c) {
+    const ChunkResult& result = chunk_results_[c];
+    auto chunk_begin = particle_list_.begin() + c * kParticlesPerChunk;
+    live_end = std::copy(chunk_begin, chunk_begin + result.num_live, live_end);
+    inactive_particle_list_.insert(inactive_particle_list_.end(),
+                                   result.finished.begin(),
+                                   result.finished.end());
+    for (size_t e = 0; e < result.emitter_counts.size(); ++e) {
+      emitter_particle_counts_[e] += result.emitter_counts[e];
+    }
+  }
+  particle_list_.erase(live_end, particle_list_.end());
+}
+
+void ParticleManager::AddToScene(std::unique_ptr<Renderable>* out) const {
+  ForEachChunk(static_cast<int>(particle_list_.size()),
+               [this, out](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      const Particle* p = particle_list_[i];
+      out[i].reset(new Renderable(p->renderable_id(), 0, p->CalculateMatrix(),
+                                  p->CurrentTint()));
     }
+  });
+}
+
+void ParticleManager::RegisterEmitter(EmitterDesc* desc) {
+  if (desc->emitter_id != kNoEmitter) return;
+  desc->emitter_id = static_cast<uint16_t>(emitters_.size());
+  emitters_.push_back(desc);
+  emitter_particle_counts_.push_back(0);
+
+  int max_priority = 0;
+  for (auto it = emitters_.begin(); it != emitters_.end(); ++it) {
+    max_priority = std::max(max_priority, (*it)->priority);
   }
+  budget_.set_max_priority(max_priority);
+}
+
+void ParticleManager::InitializeBudget(const ParticleBudgetDef* def) {
+  budget_.Initialize(def, kMaxParticles);
 }
 
 Particle* ParticleManager::CreateParticle() {
@@ -88,15 +309,154 @@ Particle* ParticleManager::CreateParticle() {
     result = new Particle();
   }
   result->set_age(0);
+  result->set_emitter_id(kNoEmitter);
   particle_list_.push_back(result);
   return result;
 }
 
-void ParticleManager::RemoveAllParticles() {
-  for (auto it = particle_list_.begin(); it != particle_list_.end();) {
-    inactive_particle_list_.push_back(*it);
-    it = particle_list_.erase(it);
+int ParticleManager::max_particles() { return kMaxParticles; }
+
+int ParticleManager::RemoveLowerPriorityParticles(int priority, int count) {
+  const float cap = static_cast<float>(budget_.cap());
+  int removed = 0;
+  auto live_end = particle_list_.begin();
+  for (auto it = particle_list_.begin(); it != particle_list_.end(); ++it) {
+    const uint16_t emitter_id = (*it)->emitter_id();
+    if (removed < count && emitter_id < emitters_.size() &&
+        emitters_[emitter_id]->priority < priority &&
+        emitter_particle_counts_[emitter_id] >
+            emitters_[emitter_id]->budget_share * cap) {
+      emitter_particle_counts_[emitter_id]--;
+      inactive_particle_list_.push_back(*it);
+      removed++;
+    } else {
+      *live_end++ = *it;
+    }
+  }
+  particle_list_.erase(live_end, particle_list_.end());
+  return removed;
+}
+
+// Turn random values in [0, 1) into values in [min, min + range).
+static void MapToRange(float* values, size_t count, float min, float range) {
+  for (size_t i = 0; i < count; ++i) {
+    values[i] = min + range * values[i];
+  }
+}
+
+void ParticleManager::SpawnParticles(const EmitterDesc& desc,
+                                     const mathfu::vec3& position,
+                                     const mathfu::vec3& additional_rotation,
+                                     const mathfu::vec4& base_tint,
+                                     int count) {
+  if (count <= 0 || desc.tints.empty() || desc.renderables.empty()) return;
+
+  // Thin out the burst as the budget shrinks. Round randomly, so that
+  // emitters spawning one particle at a time thin out too.
+  const float scale = budget_.SpawnScale(desc.priority);
+  if (scale < 1.0f) {
+    float round;
+    random_.Fill(&round, 1);
+    count = static_cast<int>(count * scale + round);
+  }
+
+  const int cap = budget_.cap();
+  int room = cap - static_cast<int>(particle_list_.size());
+  if (count > room && desc.emitter_id < emitters_.size()) {
+    // Make room within our share by removing less important particles.
+    const int share = static_cast<int>(desc.budget_share * cap) -
+                      emitter_particle_counts_[desc.emitter_id];
+    const int wanted = std::min(count, share) - room;
+    if (wanted > 0) {
+      room += RemoveLowerPriorityParticles(desc.priority, wanted);
+    }
+  }
+  count = std::min(count, room);
+  if (count <= 0) return;
+  if (desc.emitter_id < emitters_.size()) {
+    emitter_particle_counts_[desc.emitter_id] += count;
+  }
+
+  const size_t n = static_cast<size_t>(count);
+  spawn_values_.resize(n * kNumSpawnValues);
+  random_.Fill(spawn_values_.data(), spawn_values_.size());
+  float* values[kNumSpawnValues];
+  for (int i = 0; i < kNumSpawnValues; ++i) {
+    values[i] = &spawn_values_[static_cast<size_t>(i) * n];
   }
+
+  for (int axis = 0; axis < 3; ++axis) {
+    MapToRange(values[kSpawnScaleX + axis], n, desc.min_scale[axis],
+               desc.scale_range[axis]);
+    MapToRange(values[kSpawnVelocityX + axis], n, desc.min_velocity[axis],
+               desc.velocity_range[axis]);
+    MapToRange(values[kSpawnPositionX + axis], n,
+               position[axis] + desc.min_position_offset[axis],
+               desc.position_offset_range[axis]);
+    MapToRange(values[kSpawnOrientationX + axis], n,
+               additional_rotation[axis] + desc.min_orientation_offset[axis],
+               desc.orientation_offset_range[axis]);
+    MapToRange(values[kSpawnAngularVelocityX + axis], n,
+               desc.min_angular_velocity[axis],
+               desc.angular_velocity_range[axis]);
+  }
+  if (desc.preserve_aspect) {
+    // Scale all axes by the random x scale.
+    std::copy(values[kSpawnScaleX], values[kSpawnScaleX] + n,
+              values[kSpawnScaleX + 1]);
+    std::copy(values[kSpawnScaleX], values[kSpawnScaleX] + n,
+              values[kSpawnScaleX + 2]);
+  }
+  // Shorten lifetimes by up to half along with the spawn count.
+  const float lifetime_scale = 0.5f + 0.5f * scale;
+  MapToRange(values[kSpawnDuration], n, desc.min_duration * lifetime_scale,
+             desc.duration_range * lifetime_scale);
+  MapToRange(values[kSpawnTint], n, 0.0f,
+             static_cast<float>(desc.tints.size()));
+  MapToRange(values[kSpawnRenderable], n, 0.0f,
+             static_cast<float>(desc.renderables.size()));
+
+  const size_t last_tint = desc.tints.size() - 1;
+  const size_t last_renderable = desc.renderables.size() - 1;
+  for (size_t i = 0; i < n; ++i) {
+    Particle* p = CreateParticle();
+    p->set_base_scale(mathfu::vec3(values[kSpawnScaleX][i],
+                                   values[kSpawnScaleX + 1][i],
+                                   values[kSpawnScaleX + 2][i]));
+    p->set_base_velocity(mathfu::vec3(values[kSpawnVelocityX][i],
+                                      values[kSpawnVelocityX + 1][i],
+                                      values[kSpawnVelocityX + 2][i]));
+    p->set_acceleration(desc.acceleration);
+    p->set_base_position(mathfu::vec3(values[kSpawnPositionX][i],
+                                      values[kSpawnPositionX + 1][i],
+                                      values[kSpawnPositionX + 2][i]));
+    p->set_base_orientation(mathfu::vec3(values[kSpawnOrientationX][i],
+                                         values[kSpawnOrientationX + 1][i],
+                                         values[kSpawnOrientationX + 2][i]));
+    p->set_rotational_velocity(
+        mathfu::vec3(values[kSpawnAngularVelocityX][i],
+                     values[kSpawnAngularVelocityX + 1][i],
+                     values[kSpawnAngularVelocityX + 2][i]));
+    // Durations are whole milliseconds.
+    p->set_duration(floorf(values[kSpawnDuration][i]));
+    const size_t tint =
+        std::min(static_cast<size_t>(values[kSpawnTint][i]), last_tint);
+    p->set_base_tint(desc.tints[tint] * base_tint);
+    const size_t renderable = std::min(
+        static_cast<size_t>(values[kSpawnRenderable][i]), last_renderable);
+    p->set_renderable_id(desc.renderables[renderable]);
+    p->set_duration_of_shrink_out(desc.shrink_duration);
+    p->set_duration_of_fade_out(desc.fade_duration);
+    p->set_emitter_id(desc.emitter_id);
+  }
+}
+
+void ParticleManager::RemoveAllParticles() {
+  inactive_particle_list_.insert(inactive_particle_list_.end(),
+                                 particle_list_.begin(), particle_list_.end());
+  particle_list_.clear();
+  std::fill(emitter_particle_counts_.begin(), emitter_particle_counts_.end(),
+            0);
 }
 
 }  // pie_noon
@@ -15,15 +15,122 @@
 #ifndef PARTICLES_H
 #define PARTICLES_H
 
-#include <list>
+#include <functional>
+#include <memory>
+#include <vector>
 #include "common.h"
 #include "scene_description.h"
 
 namespace fpl {
+
+struct ParticleBudgetDef;
+struct ParticleDef;
+class WorkerPool;
+
 namespace pie_noon {
 
 typedef float TimeStep;
 
+// A ParticleDef unpacked into plain values, so spawning particles doesn't
+// have to decode the FlatBuffer every time. Compile one per ParticleDef when
+// the config is loaded.
+struct EmitterDesc {
+  EmitterDesc();
+
+  void Compile(const ParticleDef& def);
+
+  // Each random range is stored as its minimum and its size.
+  mathfu::vec3 min_scale;
+  mathfu::vec3 scale_range;
+  bool preserve_aspect;
+  mathfu::vec3 min_velocity;
+  mathfu::vec3 velocity_range;
+  mathfu::vec3 min_position_offset;
+  mathfu::vec3 position_offset_range;
+  mathfu::vec3 min_orientation_offset;
+  mathfu::vec3 orientation_offset_range;
+  mathfu::vec3 min_angular_velocity;
+  mathfu::vec3 angular_velocity_range;
+  mathfu::vec3 acceleration;
+  float min_duration;
+  float duration_range;
+  TimeStep shrink_duration;
+  TimeStep fade_duration;
+  std::vector<mathfu::vec4> tints;
+  std::vector<uint16_t> renderables;
+
+  // See ParticleDef in particles.fbs.
+  int priority;
+  float budget_share;
+
+  // Set by ParticleManager::RegisterEmitter(). kNoEmitter until then.
+  uint16_t emitter_id;
+};
+
+static const uint16_t kNoEmitter = 0xFFFF;
+
+// Total number of particles allowed, adjusted every frame to keep the
+// frame time under a target. When the budget is below its maximum, spawns
+// from low-priority emitters are thinned out before higher ones are
+// touched.
+class ParticleBudget {
+ public:
+  ParticleBudget();
+
+  // Without a def (or before this is called) the budget never changes from
+  // 'max_particles'.
+  void Initialize(const ParticleBudgetDef* def, int max_particles);
+
+  // Feed in how much CPU time, in milliseconds, the last frame took.
+  void AdvanceFrame(TimeStep frame_time);
+
+  // Emitter priorities run from 0 up to this. Spawn scaling is spread
+  // across them.
+  void set_max_priority(int max_priority) { max_priority_ = max_priority; }
+
+  // Fraction (0-1) of requested particles to spawn for an emitter of
+  // 'priority'. At full budget everyone gets 1. As the budget drops to its
+  // minimum, priority 0 is cut to nothing first, then priority 1 and so on.
+  // The highest priority is never cut.
+  float SpawnScale(int priority) const;
+
+  int cap() const { return static_cast<int>(cap_); }
+  TimeStep average_frame_time() const { return average_frame_time_; }
+
+ private:
+  const ParticleBudgetDef* def_;
+  int max_particles_;
+  int max_priority_;
+  float cap_;
+  TimeStep average_frame_time_;
+};
+
+// Small, fast generator for the random numbers particles need. Particles
+// only affect how the game looks, so they have their own generator rather
+// than sharing the GameState's GameRandom sequence.
+class ParticleRandom {
+ public:
+  ParticleRandom() : state_(kDefaultSeed) {}
+
+  // Write 'count' random floats in [0, 1) to 'out'.
+  void Fill(float* out, size_t count) {
+    uint32_t x = state_;
+    for (size_t i = 0; i < count; ++i) {
+      // xorshift32.
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      out[i] = static_cast<float>(x >> 8) * (1.0f / 16777216.0f);
+    }
+    state_ = x;
+  }
+
+ private:
+  static const uint32_t kDefaultSeed = 2463534242u;
+
+  uint32_t state_;
+};
+
 class Particle {
  public:
   Particle() { reset(); }
@@ -83,6 +190,10 @@ class Particle {
     duration_of_shrink_out_ = duration_of_shrink_out;
   }
 
+  // Which EmitterDesc spawned this particle, or kNoEmitter.
+  uint16_t emitter_id() const { return emitter_id_; }
+  void set_emitter_id(uint16_t emitter_id) { emitter_id_ = emitter_id; }
+
   uint16_t renderable_id() const { return renderable_id_; }
   void set_renderable_id(uint16_t renderable_id) {
     renderable_id_ = renderable_id;
@@ -125,13 +236,42 @@ class Particle {
 
   // the renderable ID we should use when drawing this particle.
   uint16_t renderable_id_;
+
+  uint16_t emitter_id_;
 };
 
 class ParticleManager {
  public:
+  ParticleManager() : worker_pool_(nullptr) {}
+
+  // Particles are aged and culled in chunks, spread across the worker pool.
+  // Surviving particles keep their order.
   void AdvanceFrame(TimeStep delta_time);
 
-  const std::list<Particle*>& get_particle_list() const {
+  // Write a Renderable for every particle to out[0] to out[n - 1], where n
+  // is get_particle_list().size(), in the same order as the list. The
+  // chunks are filled in on the worker pool, so the result is the same
+  // however many threads there are.
+  void AddToScene(std::unique_ptr<Renderable>* out) const;
+
+  // Split AdvanceFrame() and AddToScene() across 'worker_pool'. With
+  // nullptr (the default), everything runs on the calling thread.
+  void set_worker_pool(WorkerPool* worker_pool) { worker_pool_ = worker_pool; }
+
+  // Let the budget track 'desc', and give it an emitter_id. 'desc' must
+  // outlive the ParticleManager. Registering twice does nothing.
+  void RegisterEmitter(EmitterDesc* desc);
+
+  void InitializeBudget(const ParticleBudgetDef* def);
+  const ParticleBudget& budget() const { return budget_; }
+
+  // Let the budget adapt to what the last frame cost, in milliseconds of
+  // CPU time. Only the real game calls this; headless games keep the full
+  // budget, since their frame times say nothing about the device.
+  void RecordFrameCost(TimeStep cpu_time) { budget_.AdvanceFrame(cpu_time); }
+
+  // Oldest particle first.
+  const std::vector<Particle*>& get_particle_list() const {
     return particle_list_;
   }
 
@@ -142,12 +282,64 @@ class ParticleManager {
   // Particle::reset().
   Particle* CreateParticle();
 
+  // The most particles there can be at once. CreateParticle() returns
+  // nullptr beyond this, whatever the budget.
+  static int max_particles();
+
   // Removes all active particles.
   void RemoveAllParticles();
 
+  // Create up to 'count' particles from 'desc' around 'position'. The
+  // budget may ask for fewer, shorter-lived particles. If the budget is full
+  // and 'desc' is under its share, particles from lower-priority emitters
+  // that are over their share are removed to make room.
+  // The random values for the whole burst are drawn up front and stored
+  // field by field, so each field is filled in one tight loop.
+  // 'additional_rotation' is added to every particle's orientation, and
+  // every tint is multiplied by 'base_tint'.
+  void SpawnParticles(const EmitterDesc& desc, const mathfu::vec3& position,
+                      const mathfu::vec3& additional_rotation,
+                      const mathfu::vec4& base_tint, int count);
+
  private:
-  std::list<Particle*> particle_list_;
-  std::list<Particle*> inactive_particle_list_;
+  // What each chunk of AdvanceFrame() found, for the main thread to merge.
+  struct ChunkResult {
+    int num_live;
+    std::vector<Particle*> finished;
+    std::vector<int> emitter_counts;
+  };
+
+  // Call chunk(begin, end) for consecutive ranges of 'count' particles, on
+  // the worker pool if there is one.
+  void ForEachChunk(int count,
+                    const std::function<void(int, int)>& chunk) const;
+
+  // Age the particles in [begin, end) and move the survivors to the front
+  // of that range.
+  void AdvanceChunk(int begin, int end, TimeStep delta_time,
+                    ChunkResult* result);
+
+  std::vector<Particle*> particle_list_;
+  std::vector<Particle*> inactive_particle_list_;
+
+  WorkerPool* worker_pool_;
+  // One per chunk. Kept so the vectors inside are only allocated once.
+  std::vector<ChunkResult> chunk_results_;
+
+  // Removes up to 'count' of the oldest particles whose emitter has a
+  // lower priority than 'priority' and is over its share of the budget.
+  // Returns how many were removed.
+  int RemoveLowerPriorityParticles(int priority, int count);
+
+  ParticleRandom random_;
+  // Scratch space for SpawnParticles. Kept so that it's only allocated once.
+  std::vector<float> spawn_values_;
+
+  ParticleBudget budget_;
+  // Indexed by emitter_id.
+  std::vector<const EmitterDesc*> emitters_;
+  // Number of live particles from each emitter, indexed by emitter_id.
+  std::vector<int> emitter_particle_counts_;
 };
 
 }  // pie_noon
@@ -13,8 +13,11 @@
 // limitations under the License.
 
 #include "precompiled.h"
+#include <chrono>
+#include <limits>
 #include "SDL_events.h"
 #include "analytics_tracking.h"
+#include "atlas_generated.h"
 #include "audio_config_generated.h"
 #include "character_state_machine.h"
 #include "character_state_machine_def_generated.h"
@@ -30,9 +33,9 @@
 #include "touchscreen_controller.h"
 
 #include "SDL.h"
+#include "fplbase/glplatform.h"
 
 #ifdef ANDROID_HMD
-#include "fplbase/glplatform.h"
 #include "fplbase/renderer_hmd.h"
 #endif  // ANDROID_HMD
 
@@ -99,6 +102,15 @@ static const char kConfigFileName[] = "config.pieconfig";
 
 static const char kDefaultOverlayFile[] = "default_overlay.txt";
 
+static const char kAtlasFileName[] = "cardboard_atlas.pieatlas";
+
+// Levels per color channel that the atlas palettes are indexed by.
+static const int kPaletteSize = 32;
+// Slices of constant blue per row of a palette, in palette_texture_.
+static const int kPaletteSlicesPerRow = 8;
+// Texture unit that the cardboard shaders read palette_texture_ from.
+static const int kPaletteTextureUnit = 2;
+
 #ifdef ANDROID_HMD
 static const char kCardboardConfigFileName[] = "cardboard_config.pieconfig";
 #endif
@@ -147,15 +159,26 @@ PieNoonGame::PieNoonGame()
     : state_(kUninitialized),
       state_entry_time_(0),
       matman_(renderer_),
-      stick_front_(nullptr),
-      stick_back_(nullptr),
+      quad_mesh_(nullptr),
+      palette_texture_(0),
+      num_palettes_(0),
       shader_lit_textured_normal_(nullptr),
       shader_simple_shadow_(nullptr),
       shader_textured_(nullptr),
+      shader_textured_quad_(nullptr),
       shader_grayscale_(nullptr),
+      shader_color_(nullptr),
       shadow_mat_(nullptr),
+      num_scene_views_(1),
+      static_layer_resolution_(0, 0),
+      debug_render_stats_time_(0),
+      frame_input_time_(0),
+      multiscreen_displayed_splats_(0),
+      multiscreen_command_sequence_(0),
+      scene_index_(0),
       prev_world_time_(0),
       debug_previous_states_(),
+      debug_network_stats_time_(0),
       full_screen_fader_(&renderer_),
       fade_exit_state_(kUninitialized),
       ambience_channel_(),
@@ -164,28 +187,17 @@ PieNoonGame::PieNoonGame()
       next_achievement_index_(0) {
   fplbase::SetLoadFileFunction(PieNoonGame::LoadFile);
   version_ = kVersion;
-  for (size_t i = 0; i < RenderableId_Count; ++i) {
-    cardboard_backs_[i] = nullptr;
-  }
+  std::fill(static_layer_camera_, static_layer_camera_ + 16, 0.0f);
 }
 
 PieNoonGame::~PieNoonGame() {
-  for (int i = 0; i < RenderableId_Count; ++i) {
-    std::vector<fplbase::Mesh*>& fronts = cardboard_fronts_[i];
-    for (size_t j = 0; j < fronts.size(); ++j) {
-      delete fronts[j];
-      fronts[j] = nullptr;
-    }
+  delete quad_mesh_;
+  quad_mesh_ = nullptr;
 
-    delete cardboard_backs_[i];
-    cardboard_backs_[i] = nullptr;
+  if (palette_texture_ != 0) {
+    GL_CALL(glDeleteTextures(1, &palette_texture_));
+    palette_texture_ = 0;
   }
-
-  delete stick_front_;
-  stick_front_ = nullptr;
-
-  delete stick_back_;
-  stick_back_ = nullptr;
 }
 
 bool PieNoonGame::InitializeConfig() {
@@ -268,9 +280,12 @@ struct NormalMappedVertex {
 };
 
 // Initializes 'vertices' at the specified position, aligned up-and-down.
-// 'vertices' must be an array of length kQuadNumVertices.
+// The texture coordinates of the quad's corners are 'coord_top_left' and
+// 'coord_bottom_right'. 'vertices' must be an array of length
+// kQuadNumVertices.
 static void CreateVerticalQuad(const vec3& offset, const vec2& geo_size,
-                               const vec2& texture_coord_size,
+                               const vec2& coord_top_left,
+                               const vec2& coord_bottom_right,
                                NormalMappedVertex* vertices) {
   const float half_width = geo_size[0] * 0.5f;
   const vec3 bottom_left = offset + vec3(-half_width, 0.0f, 0.0f);
@@ -281,10 +296,8 @@ static void CreateVerticalQuad(const vec3& offset, const vec2& geo_size,
   vertices[2].pos = vec3(bottom_left[0], top_right[1], offset[2]);
   vertices[3].pos = top_right;
 
-  const float coord_half_width = texture_coord_size[0] * 0.5f;
-  const vec2 coord_bottom_left(0.5f - coord_half_width, 1.0f);
-  const vec2 coord_top_right(0.5f + coord_half_width,
-                             1.0f - texture_coord_size[1]);
+  const vec2 coord_bottom_left(coord_top_left[0], coord_bottom_right[1]);
+  const vec2 coord_top_right(coord_bottom_right[0], coord_top_left[1]);
 
   vertices[0].tc = coord_bottom_left;
   vertices[1].tc = vec2(coord_top_right[0], coord_bottom_left[1]);
@@ -295,41 +308,140 @@ static void CreateVerticalQuad(const vec3& offset, const vec2& geo_size,
       kQuadNumVertices, kQuadNumIndices);
 }
 
-// Creates a mesh of a single quad (two triangles) vertically upright.
+// Returns where build_assets.py packed the art of 'material_name' into the
+// texture atlas, or nullptr if it isn't in the atlas.
+const AtlasEntry* PieNoonGame::FindAtlasEntry(
+    const char* material_name) const {
+  if (atlas_source_.empty()) return nullptr;
+  auto entries = GetAtlas(atlas_source_.c_str())->entries();
+  if (entries == nullptr) return nullptr;
+
+  // The entries are sorted by material name.
+  int low = 0;
+  int high = static_cast<int>(entries->size());
+  while (low < high) {
+    const int mid = (low + high) / 2;
+    const AtlasEntry* entry = entries->Get(mid);
+    const int order = strcmp(entry->material()->c_str(), material_name);
+    if (order == 0) return entry;
+    if (order < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return nullptr;
+}
+
+// Works out how to draw a vertically upright quad with quad_mesh_.
 // The quad's has x and y size determined by the size of the texture.
 // The quad is offset in (x,y,z) space by the 'offset' variable.
-// Returns a mesh with the quad and texture, or nullptr if anything went wrong.
-fplbase::Mesh* PieNoonGame::CreateVerticalQuadMesh(
+// Returns the quad, or one without a material if anything went wrong.
+CardboardQuad PieNoonGame::CreateCardboardQuad(
     const flatbuffers::String* material_name, const vec3& offset,
     const vec2& pixel_bounds, float pixel_to_world_scale) {
+  CardboardQuad quad;
+
   // Don't try to load obviously invalid materials. Suppresses error logs from
   // the material manager.
   if (material_name == nullptr || material_name->c_str()[0] == '\0')
-    return nullptr;
+    return quad;
 
-  // Load the material from file, and check validity.
-  auto material = matman_.LoadMaterial(material_name->c_str());
+  // Art that was packed into the texture atlas is drawn from its page, so
+  // most cutouts share a handful of textures. Anything else has a texture of
+  // its own, with the art at the bottom center, padded to a power of two.
+  assert(pixel_bounds.x() && pixel_bounds.y());
+  const AtlasEntry* atlas_entry = FindAtlasEntry(material_name->c_str());
+  fplbase::Material* material;
+  vec2 coord_top_left;
+  vec2 coord_bottom_right;
+  if (atlas_entry != nullptr) {
+    auto page = GetAtlas(atlas_source_.c_str())->pages()->Get(
+        atlas_entry->page());
+    material = matman_.LoadMaterial(page->material()->c_str());
+    coord_top_left = LoadVec2(atlas_entry->uv_min());
+    coord_bottom_right = LoadVec2(atlas_entry->uv_max());
+    if (atlas_entry->palette() < num_palettes_) {
+      quad.palette = atlas_entry->palette();
+    }
+  } else {
+    material = matman_.LoadMaterial(material_name->c_str());
+    const vec2 texture_size =
+        vec2(mathfu::RoundUpToPowerOf2(pixel_bounds.x()),
+             mathfu::RoundUpToPowerOf2(pixel_bounds.y()));
+    const vec2 texture_coord_size = pixel_bounds / texture_size;
+    coord_top_left = vec2(0.5f - texture_coord_size.x() * 0.5f,
+                          1.0f - texture_coord_size.y());
+    coord_bottom_right = vec2(0.5f + texture_coord_size.x() * 0.5f, 1.0f);
+  }
+
+  // Check the material's validity.
   bool material_valid = material != nullptr && material->textures().size() > 0;
-  if (!material_valid) return nullptr;
+  if (!material_valid) return quad;
 
-  // Create vertex geometry in proportion to the texture size.
+  // Size the geometry in proportion to the texture size.
   // This is nice for the artist since everything is at the scale of the
   // original artwork.
-  assert(pixel_bounds.x() && pixel_bounds.y());
-  const vec2 texture_size = vec2(mathfu::RoundUpToPowerOf2(pixel_bounds.x()),
-                                 mathfu::RoundUpToPowerOf2(pixel_bounds.y()));
-  const vec2 texture_coord_size = pixel_bounds / texture_size;
-  const vec2 geo_size = pixel_bounds * vec2(pixel_to_world_scale);
-
-  // Initialize a vertex array in the requested position.
-  NormalMappedVertex vertices[kQuadNumVertices];
-  CreateVerticalQuad(offset, geo_size, texture_coord_size, vertices);
+  quad.material = material;
+  quad.offset = offset;
+  quad.size = pixel_bounds * vec2(pixel_to_world_scale);
+  quad.texture_rect = vec4(coord_top_left.x(), coord_top_left.y(),
+                           coord_bottom_right.x(), coord_bottom_right.y());
+  return quad;
+}
+
+// Uploads the atlas' palettes into palette_texture_. The three dimensional
+// palettes are flattened into two: each palette is a grid of slices, one for
+// each level of blue, kPaletteSlicesPerRow to a row. Across each slice red
+// increases, and down it green does. The palettes are stacked one above the
+// other. Sampled without filtering, since neighbouring entries are unrelated.
+void PieNoonGame::InitializePalettes() {
+  if (atlas_source_.empty()) return;
+  auto palettes = GetAtlas(atlas_source_.c_str())->palettes();
+  if (palettes == nullptr || palettes->size() == 0) return;
+
+  const int kPaletteEntries = kPaletteSize * kPaletteSize * kPaletteSize;
+  const int width = kPaletteSize * kPaletteSlicesPerRow;
+  const int palette_height = kPaletteEntries / width;
+  const int height = palette_height * static_cast<int>(palettes->size());
+
+  // Palettes that are missing or malformed don't change any colors.
+  std::vector<uint8_t> texels(width * height * 3, 128);
+  for (int i = 0; i < static_cast<int>(palettes->size()); ++i) {
+    auto deltas = palettes->Get(i)->deltas();
+    if (deltas == nullptr ||
+        deltas->size() != static_cast<size_t>(3 * kPaletteEntries)) {
+      fplbase::LogError(fplbase::kError, "Malformed atlas palette %d.\n", i);
+      continue;
+    }
+    for (int entry = 0; entry < kPaletteEntries; ++entry) {
+      const int red = entry % kPaletteSize;
+      const int green = (entry / kPaletteSize) % kPaletteSize;
+      const int blue = entry / (kPaletteSize * kPaletteSize);
+      const int x = (blue % kPaletteSlicesPerRow) * kPaletteSize + red;
+      const int y = i * palette_height +
+                    (blue / kPaletteSlicesPerRow) * kPaletteSize + green;
+      for (int channel = 0; channel < 3; ++channel) {
+        texels[(y * width + x) * 3 + channel] =
+            deltas->Get(entry * 3 + channel);
+      }
+    }
+  }
 
-  // Create mesh and add in quad indices.
-  auto mesh = new fplbase::Mesh(vertices, kQuadNumVertices,
-                                sizeof(NormalMappedVertex), kQuadMeshFormat);
-  mesh->AddIndices(kQuadIndices, kQuadNumIndices, material);
-  return mesh;
+  GL_CALL(glActiveTexture(GL_TEXTURE0 + kPaletteTextureUnit));
+  GL_CALL(glGenTextures(1, &palette_texture_));
+  GL_CALL(glBindTexture(GL_TEXTURE_2D, palette_texture_));
+  GL_CALL(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+  GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
+                       GL_UNSIGNED_BYTE, &texels[0]));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+  GL_CALL(
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+  GL_CALL(
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+  GL_CALL(glActiveTexture(GL_TEXTURE0));
+  num_palettes_ = static_cast<int>(palettes->size());
 }
 
 // Load textures for cardboard into 'materials_'. The 'renderer_' and 'matman_'
@@ -352,7 +464,25 @@ bool PieNoonGame::InitializeRenderingAssets() {
   matman_.LoadMaterial(config.loading_logo()->c_str());
   matman_.LoadMaterial(config.fade_material()->c_str());
 
-  // Create a mesh for the front and back of each cardboard cutout.
+  // Use the texture atlas, if the assets were built with one.
+  if (!LoadFile(kAtlasFileName, &atlas_source_)) {
+    atlas_source_.clear();
+    fplbase::LogInfo(fplbase::kApplication,
+                     "No texture atlas, cardboard uses its own textures.\n");
+  }
+  InitializePalettes();
+
+  // Create the quad that all cardboard is drawn with. Its texture coordinates
+  // run from 0 at the top left to 1 at the bottom right, so that the shaders
+  // can map them onto each CardboardQuad's texture_rect.
+  NormalMappedVertex vertices[kQuadNumVertices];
+  CreateVerticalQuad(mathfu::kZeros3f, mathfu::kOnes2f, mathfu::kZeros2f,
+                     mathfu::kOnes2f, vertices);
+  quad_mesh_ = new fplbase::Mesh(vertices, kQuadNumVertices,
+                                 sizeof(NormalMappedVertex), kQuadMeshFormat);
+  quad_mesh_->AddIndices(kQuadIndices, kQuadNumIndices, nullptr);
+
+  // Work out how to draw the front and back of each cardboard cutout.
   const vec3 front_z_offset(0.0f, 0.0f, config.cardboard_front_z_offset());
   const vec3 back_z_offset(0.0f, 0.0f, config.cardboard_back_z_offset());
   for (int id = 0; id < RenderableId_Count; ++id) {
@@ -370,19 +500,19 @@ bool PieNoonGame::InitializeRenderingAssets() {
         renderable->geometry_scale() * config.pixel_to_world_scale();
 
     const auto front = renderable->cardboard_fronts();
-    cardboard_fronts_[id].resize(front->size(), nullptr);
+    cardboard_fronts_[id].resize(front->size());
     for (size_t i = 0; i < front->size(); ++i) {
-      cardboard_fronts_[id][i] = CreateVerticalQuadMesh(
+      cardboard_fronts_[id][i] = CreateCardboardQuad(
           front->Get(i), front_offset, pixel_bounds, pixel_to_world_scale);
     }
 
     cardboard_backs_[id] =
-        CreateVerticalQuadMesh(renderable->cardboard_back(), back_offset,
-                               pixel_bounds, pixel_to_world_scale);
+        CreateCardboardQuad(renderable->cardboard_back(), back_offset,
+                            pixel_bounds, pixel_to_world_scale);
   }
 
   // We default to the invalid texture, so it has to exist.
-  if (!cardboard_fronts_[RenderableId_Invalid][0]) {
+  if (!cardboard_fronts_[RenderableId_Invalid][0].material) {
     fplbase::LogError(fplbase::kError, "Can't load backup texture.\n");
     return false;
   }
@@ -392,12 +522,13 @@ bool PieNoonGame::InitializeRenderingAssets() {
                                 config.stick_front_z_offset());
   const vec3 stick_back_offset(0.0f, config.stick_y_offset(),
                                config.stick_back_z_offset());
-  stick_front_ = CreateVerticalQuadMesh(
+  stick_front_ = CreateCardboardQuad(
       config.stick_front(), stick_front_offset, LoadVec2(config.stick_bounds()),
       config.pixel_to_world_scale());
-  stick_back_ = CreateVerticalQuadMesh(config.stick_back(), stick_back_offset,
-                                       LoadVec2(config.stick_bounds()),
-                                       config.pixel_to_world_scale());
+  stick_back_ = CreateCardboardQuad(config.stick_back(), stick_back_offset,
+                                    LoadVec2(config.stick_bounds()),
+                                    config.pixel_to_world_scale());
+  InitializeRenderableBounds();
 
   // Load all shaders we use:
   shader_lit_textured_normal_ =
@@ -405,9 +536,12 @@ bool PieNoonGame::InitializeRenderingAssets() {
   shader_cardboard = matman_.LoadShader("shaders/cardboard");
   shader_simple_shadow_ = matman_.LoadShader("shaders/simple_shadow");
   shader_textured_ = matman_.LoadShader("shaders/textured");
+  shader_textured_quad_ = matman_.LoadShader("shaders/textured_quad");
   shader_grayscale_ = matman_.LoadShader("shaders/grayscale");
+  shader_color_ = matman_.LoadShader("shaders/color");
   if (!(shader_lit_textured_normal_ && shader_cardboard &&
-        shader_simple_shadow_ && shader_textured_ && shader_grayscale_))
+        shader_simple_shadow_ && shader_textured_ && shader_textured_quad_ &&
+        shader_grayscale_ && shader_color_))
     return false;
 
   // Load shadow material:
@@ -456,6 +590,10 @@ bool PieNoonGame::InitializeGameState() {
   game_state_.set_config(&config);
   game_state_.set_cardboard_config(&GetCardboardConfig());
 
+  worker_pool_.Initialize(std::max(config.worker_thread_count(), 0));
+  if (config.pipelined_simulation()) simulation_thread_.Initialize();
+  game_state_.particle_manager().set_worker_pool(&worker_pool_);
+
   // Register the motivator types with the MotiveEngine.
   motive::OvershootInit::Register();
   motive::SplineInit::Register();
@@ -500,14 +638,35 @@ bool PieNoonGame::InitializeGameState() {
 
   AddController(cardboard_controller_);
 
+  ai_scheduler_.Initialize(&game_state_, config.ai_min_parallel_batch());
+  ai_scheduler_.set_worker_pool(&worker_pool_);
+
   // Create characters.
   for (unsigned int i = 0; i < config.character_count(); ++i) {
-    AiController* controller = new AiController();
-    controller->Initialize(&game_state_, &config, i);
+    Controller* controller;
+    if (config.ai_type() == AiType_Utility) {
+      UtilityAiController* utility_controller = new UtilityAiController();
+      utility_controller->Initialize(&game_state_, &config, i);
+      controller = utility_controller;
+    } else if (config.ai_type() == AiType_Lookahead) {
+      LookaheadAiController* lookahead_controller =
+          new LookaheadAiController();
+      lookahead_controller->Initialize(&game_state_, &config, i,
+                                       &rollout_planner_, &ai_frame_snapshot_);
+      controller = lookahead_controller;
+    } else {
+      AiController* random_controller = new AiController();
+      random_controller->Initialize(&game_state_, &config, i);
+      controller = random_controller;
+    }
     game_state_.characters().push_back(std::unique_ptr<Character>(
         new Character(i, controller, config, state_machine_def)));
     AddController(controller);
-    controller->Initialize(&game_state_, &config, i);
+    ai_scheduler_.AddController(controller);
+  }
+  if (config.ai_type() == AiType_Lookahead) {
+    rollout_planner_.Initialize(&config, state_machine_def,
+                                config.character_count());
   }
 
   multiplayer_director_.reset(new MultiplayerDirector());
@@ -680,11 +839,13 @@ bool PieNoonGame::Initialize(const char* const binary_directory) {
   return true;
 }
 
-// Returns the mesh for renderable_id, if we have one, or the pajama mesh
-// (a mesh with a texture that's obviously wrong), if we don't.
-fplbase::Mesh* PieNoonGame::GetCardboardFront(int renderable_id, int variant) {
-  // Return the invalid mesh if the indices are out of bounds.
-  auto invalid_front = cardboard_fronts_[RenderableId_Invalid][0];
+// Returns the quad for renderable_id, if we have one, or the pajama quad
+// (a quad with a texture that's obviously wrong), if we don't.
+const CardboardQuad& PieNoonGame::GetCardboardFront(int renderable_id,
+                                                    int variant) {
+  // Return the invalid quad if the indices are out of bounds.
+  const CardboardQuad& invalid_front =
+      cardboard_fronts_[RenderableId_Invalid][0];
   if (renderable_id < 0 || RenderableId_Count <= renderable_id) {
     return invalid_front;
   }
@@ -694,29 +855,104 @@ fplbase::Mesh* PieNoonGame::GetCardboardFront(int renderable_id, int variant) {
   auto& fronts = cardboard_fronts_[renderable_id];
   const int variant_clamped =
       mathfu::Clamp(variant, 0, static_cast<int>(fronts.size()) - 1);
-  auto front = fronts[variant_clamped];
-  return front == nullptr ? invalid_front : front;
-}
-
-void PieNoonGame::RenderCardboard(const SceneDescription& scene,
-                                  const mat4& camera_transform) {
+  const CardboardQuad& front = fronts[variant_clamped];
+  return front.material == nullptr ? invalid_front : front;
+}
+
+// Tell 'shader', which must be the current shader, how to place and texture
+// quad_mesh_ for 'quad'.
+static void SetCardboardQuadUniforms(const CardboardQuad& quad,
+                                     fplbase::Shader* shader) {
+  shader->SetUniform("quad_offset", vec3(quad.offset));
+  shader->SetUniform("quad_size", vec2(quad.size));
+  shader->SetUniform("quad_texture_rect", vec4(quad.texture_rect));
+}
+
+// Draws quad_mesh_ as 'quad', with 'quad's material, into each of the
+// 'num_views' scene 'views', through the matching 'mvps'. 'shader' must
+// already be set; if there's only one view, with its transform. Returns the
+// number of draw calls it took.
+int PieNoonGame::RenderCardboardQuad(const CardboardQuad& quad,
+                                     fplbase::Shader* shader, const int* views,
+                                     const mat4* mvps, int num_views) {
+  SetCardboardQuadUniforms(quad, shader);
+
+  // Character variants are recolored from the base character's art. The
+  // shaders count palettes from one, so that zero, the value uniforms start
+  // out with, leaves the art alone.
+  shader->SetUniform("variant_palette", static_cast<float>(quad.palette + 1));
+  if (quad.palette >= 0) {
+    const int width = kPaletteSize * kPaletteSlicesPerRow;
+    const int height = kPaletteSize * kPaletteSize * kPaletteSize / width;
+    shader->SetUniform("palette_texel_size",
+                       vec2(1.0f / width, 1.0f / (height * num_palettes_)));
+    GL_CALL(glActiveTexture(GL_TEXTURE0 + kPaletteTextureUnit));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, palette_texture_));
+  }
+  quad.material->Set(renderer_);
+
+  // Everything but the transform is shared between views, so is only set up
+  // once.
+  for (int i = 0; i < num_views; ++i) {
+    SetSceneViewport(views[i]);
+    if (num_views > 1) SetViewTransform(shader, mvps[i]);
+    quad_mesh_->Render(renderer_, true);
+  }
+  return num_views;
+}
+
+// Point 'shader', which must be the current shader, at another view's
+// transform. Only that one uniform changes, where Shader::Set() would upload
+// every uniform the renderer tracks.
+void PieNoonGame::SetViewTransform(fplbase::Shader* shader, const mat4& mvp) {
+  renderer_.set_model_view_projection(mvp);
+  shader->SetUniform("model_view_projection", &mvp[0], 16);
+}
+
+// Forget the scenes filled in from the game before it was reset, so that
+// pipelined simulation doesn't draw a frame of the old game. Nothing is drawn
+// until the simulation thread fills in a new scene.
+void PieNoonGame::DiscardScenes() {
+  for (int i = 0; i < kNumSceneBuffers; ++i) scenes_[i].Clear();
+}
+
+// Point rendering at the part of the screen that scene view 'view' covers.
+// Nothing to do when there's only one.
+void PieNoonGame::SetSceneViewport(int view) {
+  if (num_scene_views_ <= 1) return;
+  const int* viewport = scene_views_[view].viewport;
+  GL_CALL(glViewport(viewport[0], viewport[1], viewport[2], viewport[3]));
+}
+
+// Draws the renderables of 'scene' at 'indices', in that order, into every
+// scene view. Returns the number of draw calls it took.
+int PieNoonGame::RenderCardboard(const SceneDescription& scene,
+                                 const std::vector<int>& indices) {
   const Config& config = GetConfig();
 
-  for (size_t i = 0; i < scene.renderables().size(); ++i) {
-    const auto& renderable = scene.renderables()[i];
+  int num_draws = 0;
+  for (auto it = indices.begin(); it != indices.end(); ++it) {
+    const auto& renderable = scene.renderables()[*it];
     const int id = renderable->id();
 
-    // Set up vertex transformation into projection space.
-    const mat4 mvp = camera_transform * renderable->world_matrix();
-    renderer_.set_model_view_projection(mvp);
+    // Set up vertex transformation into projection space, for each view that
+    // might see it.
+    int views[kMaxSceneViews];
+    mat4 mvps[kMaxSceneViews];
+    int num_views = 0;
+    for (int view = 0; view < num_scene_views_; ++view) {
+      if (!scene_views_[view].visible[*it]) continue;
+      views[num_views] = view;
+      mvps[num_views] =
+          scene_views_[view].camera_transform * renderable->world_matrix();
+      num_views++;
+    }
+    if (num_views == 0) continue;
+    renderer_.set_model_view_projection(mvps[0]);
 
     // Set the camera and light positions in object space.
-    const mat4 world_matrix_inverse = renderable->world_matrix().Inverse();
-    renderer_.set_camera_pos(world_matrix_inverse *
-                             game_state_.camera().Position());
-
-    // TODO: check amount of lights.
-    renderer_.set_light_pos(world_matrix_inverse * (*scene.lights()[0]));
+    renderer_.set_camera_pos(renderable->object_camera_pos());
+    renderer_.set_light_pos(renderable->object_light_pos());
 
     // The popsicle stick and cardboard back are always uncolored.
     renderer_.set_color(mathfu::kOnes4f);
@@ -726,22 +962,27 @@ void PieNoonGame::RenderCardboard(const SceneDescription& scene,
     //
     // If we have a back, draw the back too, slightly offset.
     // The back is the *inside* of the cardboard, representing corrugation.
-    if (cardboard_backs_[id]) {
+    if (cardboard_backs_[id].material) {
       shader_cardboard->Set(renderer_);
-      cardboard_backs_[id]->Render(renderer_);
+      num_draws += RenderCardboardQuad(cardboard_backs_[id], shader_cardboard,
+                                       views, mvps, num_views);
     }
 
     // Draw the popsicle stick that props up the cardboard.
-    if (config.renderables()->Get(id)->stick() && stick_front_ != nullptr &&
-        stick_back_ != nullptr) {
-      shader_textured_->Set(renderer_);
-      stick_front_->Render(renderer_);
-      stick_back_->Render(renderer_);
+    if (config.renderables()->Get(id)->stick() && stick_front_.material &&
+        stick_back_.material) {
+      shader_textured_quad_->Set(renderer_);
+      num_draws += RenderCardboardQuad(stick_front_, shader_textured_quad_,
+                                       views, mvps, num_views);
+      num_draws += RenderCardboardQuad(stick_back_, shader_textured_quad_,
+                                       views, mvps, num_views);
     }
 
     renderer_.set_color(renderable->color());
 
+    fplbase::Shader* front_shader;
     if (config.renderables()->Get(id)->cardboard()) {
+      front_shader = shader_cardboard;
       shader_cardboard->Set(renderer_);
       shader_cardboard->SetUniform(
           "ambient_material", LoadVec3(config.cardboard_ambient_material()));
@@ -753,14 +994,25 @@ void PieNoonGame::RenderCardboard(const SceneDescription& scene,
       shader_cardboard->SetUniform("normalmap_scale",
                                    config.cardboard_normalmap_scale());
     } else {
-      shader_textured_->Set(renderer_);
+      front_shader = shader_textured_quad_;
+      shader_textured_quad_->Set(renderer_);
     }
-    auto front = GetCardboardFront(id, renderable->variant());
-    front->Render(renderer_);
+    num_draws += RenderCardboardQuad(
+        GetCardboardFront(id, renderable->variant()), front_shader, views,
+        mvps, num_views);
   }
+  return num_draws;
+}
+
+// Monotonic clock for latency measurements.
+static int64_t NowMicroseconds() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
 }
 
 void PieNoonGame::Render(const SceneDescription& scene) {
+  UpdateCullingSpheres(scene);
   if (game_state_.is_in_cardboard()) {
     RenderForCardboard(scene);
   } else {
@@ -774,69 +1026,139 @@ void PieNoonGame::RenderForDefault(const SceneDescription& scene) {
 
 void PieNoonGame::RenderForCardboard(const SceneDescription& scene) {
 #ifdef ANDROID_HMD
+  // The whole simulation has run since the head pose was read. Read it again
+  // now, so the eyes look where the head is rather than where it was. Only
+  // the view changes; what the game did with the old pose stays done.
+  int64_t latch_time = frame_input_time_;
+  if (GetConfig().late_latch_head_pose()) {
+    latch_time = NowMicroseconds();
+    input_.head_mounted_display_input().UpdateTransforms();
+  }
+
   fplbase::HeadMountedDisplayViewSettings view_settings;
   HeadMountedDisplayRenderStart(
       input_.head_mounted_display_input(), &renderer_, mathfu::kZeros4f,
       game_state_.use_undistort_rendering(), &view_settings);
   auto res = renderer_.window_size();
   vec2i half_res(res.x() / 2.0f, res.y());
-  // Perform two render passes, one for each half of the screen
-  for (int i = 0; i < 2; i++) {
-    GL_CALL(glViewport(view_settings.viewport_extents[i][0],
-                       view_settings.viewport_extents[i][1],
-                       view_settings.viewport_extents[i][2],
-                       view_settings.viewport_extents[i][3]));
-    // Convert the transforms from cardboard space to game space
-    CorrectCardboardCamera(view_settings.viewport_transforms[i]);
-    RenderScene(scene, view_settings.viewport_transforms[i], half_res);
+  const bool single_pass = GetConfig().single_pass_stereo();
+  const int64_t render_start_time = NowMicroseconds();
+  int num_draws = 0;
+  if (single_pass) {
+    // Draw the 3D elements into both halves of the screen at once, setting
+    // up each item only once, then the 2D elements into each half.
+    for (int i = 0; i < 2; i++) {
+      CorrectCardboardCamera(view_settings.viewport_transforms[i]);
+      SceneView& view = scene_views_[i];
+      view.camera_transform = CameraTransform(
+          scene, view_settings.viewport_transforms[i], half_res);
+      for (int j = 0; j < 4; j++) {
+        view.viewport[j] = view_settings.viewport_extents[i][j];
+      }
+    }
+    num_draws = Render3DElements(scene, half_res, 2);
+    for (int i = 0; i < 2; i++) {
+      GL_CALL(glViewport(view_settings.viewport_extents[i][0],
+                         view_settings.viewport_extents[i][1],
+                         view_settings.viewport_extents[i][2],
+                         view_settings.viewport_extents[i][3]));
+      Render2DElements(scene, view_settings.viewport_transforms[i]);
+    }
+  } else {
+    // Perform two render passes, one for each half of the screen
+    for (int i = 0; i < 2; i++) {
+      GL_CALL(glViewport(view_settings.viewport_extents[i][0],
+                         view_settings.viewport_extents[i][1],
+                         view_settings.viewport_extents[i][2],
+                         view_settings.viewport_extents[i][3]));
+      // Convert the transforms from cardboard space to game space
+      CorrectCardboardCamera(view_settings.viewport_transforms[i]);
+      num_draws +=
+          RenderScene(scene, view_settings.viewport_transforms[i], half_res);
+    }
   }
+  StereoStats& stereo = stereo_stats_[single_pass ? 1 : 0];
+  stereo.frames++;
+  stereo.draws += num_draws;
+  stereo.cpu_time += NowMicroseconds() - render_start_time;
   HeadMountedDisplayRenderEnd(&renderer_,
                               game_state_.use_undistort_rendering());
+
+  // Everything for this frame has been handed to GL.
+  const int64_t submit_time = NowMicroseconds();
+  HeadPoseLatencyStats& latency = head_pose_latency_stats_;
+  latency.frames++;
+  latency.input_to_submit += submit_time - frame_input_time_;
+  latency.latched_to_submit += submit_time - latch_time;
+  latency.max_input_to_submit =
+      std::max(latency.max_input_to_submit, submit_time - frame_input_time_);
+  latency.max_latched_to_submit =
+      std::max(latency.max_latched_to_submit, submit_time - latch_time);
 #else
   (void)scene;
 #endif  // ANDROID_HMD
 }
 
-void PieNoonGame::RenderScene(const SceneDescription& scene,
-                              const mat4& additional_camera_changes,
-                              const vec2i& resolution) {
-  const Config& config = GetConfig();
-  const Config& cardboard_config = GetCardboardConfig();
-
-  float viewport_angle = game_state_.is_in_cardboard()
-                             ? cardboard_config.viewport_angle()
-                             : config.viewport_angle();
-  // Final matrix that applies the view frustum to bring into screen space.
-  mat4 perspective_matrix_ = mat4::Perspective(
-      viewport_angle, resolution.x() / static_cast<float>(resolution.y()),
-      config.viewport_near_plane(), config.viewport_far_plane(), -1.0f);
-
-  const mat4 camera_transform =
-      perspective_matrix_ * (additional_camera_changes * scene.camera());
+// Size of the ground plane, in x and z.
+vec2 PieNoonGame::GroundPlaneSize() const {
+  const Config& config = game_state_.is_in_cardboard() ? GetCardboardConfig()
+                                                       : GetConfig();
+  return vec2(config.ground_plane_width(), config.ground_plane_depth());
+}
 
-  // Render a ground plane.
-  // TODO: Replace with a regular environment prop. Calculate scale_bias from
-  // environment prop size.
-  renderer_.set_model_view_projection(camera_transform);
+// Render a ground plane into every scene view.
+// TODO: Replace with a regular environment prop. Calculate scale_bias from
+// environment prop size.
+void PieNoonGame::RenderGround() {
   renderer_.set_color(mathfu::kOnes4f);
-  shader_textured_->Set(renderer_);
   auto ground_mat = matman_.LoadMaterial("materials/floor.fplmat");
   assert(ground_mat);
   ground_mat->Set(renderer_);
-  const float ground_width = game_state_.is_in_cardboard()
-                                 ? cardboard_config.ground_plane_width()
-                                 : config.ground_plane_width();
-  const float ground_depth = game_state_.is_in_cardboard()
-                                 ? cardboard_config.ground_plane_depth()
-                                 : config.ground_plane_depth();
-  fplbase::Mesh::RenderAAQuadAlongX(vec3(-ground_width, 0, 0),
-                           vec3(ground_width, 0, ground_depth), vec2(0, 0),
-                           vec2(1.0f, 1.0f));
-  const vec4 world_scale_bias(1.0f / (2.0f * ground_width), 1.0f / ground_depth,
-                              0.5f, 0.0f);
-
-  // Render shadows for all Renderables first, with depth testing off so
-  // they blend properly.
+  const vec2 ground_size = GroundPlaneSize();
+  for (int view = 0; view < num_scene_views_; ++view) {
+    SetSceneViewport(view);
+    if (view == 0) {
+      renderer_.set_model_view_projection(scene_views_[view].camera_transform);
+      shader_textured_->Set(renderer_);
+    } else {
+      SetViewTransform(shader_textured_, scene_views_[view].camera_transform);
+    }
+    fplbase::Mesh::RenderAAQuadAlongX(
+        vec3(-ground_size.x(), 0, 0), vec3(ground_size.x(), 0, ground_size.y()),
+        vec2(0, 0), vec2(1.0f, 1.0f));
+  }
+}
+
+// Projects the shadows of the renderables of 'scene' at 'indices' that cast
+// them into 'batch'.
+void PieNoonGame::UpdateShadowBatch(const SceneDescription& scene,
+                                    const std::vector<int>& indices,
+                                    ShadowBatch* batch) {
+  const Config& config = GetConfig();
+  shadow_casters_.clear();
+  for (auto it = indices.begin(); it != indices.end(); ++it) {
+    if (!shadow_visible_[*it]) continue;
+    const auto& renderable = scene.renderables()[*it];
+    const int id = renderable->id();
+    if (!config.renderables()->Get(id)->shadow()) continue;
+    const CardboardQuad& front = GetCardboardFront(id, renderable->variant());
+    ShadowCaster caster;
+    caster.id = renderable->id();
+    caster.variant = renderable->variant();
+    caster.texture = front.material->textures()[0];
+    caster.texture_rect = front.texture_rect;
+    caster.offset = front.offset;
+    caster.size = front.size;
+    const mat4& world_matrix = renderable->world_matrix();
+    for (int j = 0; j < 16; ++j) caster.world_matrix[j] = world_matrix[j];
+    shadow_casters_.push_back(caster);
+  }
+  batch->Update(shadow_casters_, *scene.lights()[0]);
+}
+
+// Render shadows with depth testing off so they blend properly.
+void PieNoonGame::RenderShadowBatch(const ShadowBatch& batch,
+                                    const vec4& world_scale_bias) {
   renderer_.DepthTest(false);
   // This is a bit of a hack - We want to be in kBlendModeAlpha, but
   // FPLBase's renderer assumes that no one else is messing with the openGL
@@ -845,30 +1167,407 @@ void PieNoonGame::RenderScene(const SceneDescription& scene,
   // that things have change, and it should call glBlendMode(GL_ENABLE) again.
   renderer_.SetBlendMode(fplbase::kBlendModeOff);
   renderer_.SetBlendMode(fplbase::kBlendModeAlpha);
-  renderer_.set_model_view_projection(camera_transform);
-  renderer_.set_light_pos(*scene.lights()[0]);  // TODO: check amount of lights.
+  renderer_.set_model_view_projection(scene_views_[0].camera_transform);
+  shader_simple_shadow_->Set(renderer_);
   shader_simple_shadow_->SetUniform("world_scale_bias", world_scale_bias);
-  for (size_t i = 0; i < scene.renderables().size(); ++i) {
-    const auto& renderable = scene.renderables()[i];
-    const int id = renderable->id();
-    auto front = GetCardboardFront(id, renderable->variant());
-    if (config.renderables()->Get(id)->shadow()) {
-      renderer_.set_model(renderable->world_matrix());
-      shader_simple_shadow_->Set(renderer_);
-      // The first texture of the shadow shader has to be that of the
-      // billboard.
-      shadow_mat_->textures()[0] = front->GetMaterial(0)->textures()[0];
-      shadow_mat_->Set(renderer_);
-      front->Render(renderer_, true);
+  batch.Render(renderer_, shadow_mat_, num_scene_views_, [this](int view) {
+    if (num_scene_views_ <= 1) return;
+    SetSceneViewport(view);
+    SetViewTransform(shader_simple_shadow_,
+                     scene_views_[view].camera_transform);
+  });
+  renderer_.DepthTest(true);
+}
+
+// Corners of 'quad' in object space, going around its edge.
+static void CardboardQuadCorners(const CardboardQuad& quad, vec3* corners) {
+  const vec3 offset(quad.offset);
+  const vec2 size(quad.size);
+  const float half_width = size.x() * 0.5f;
+  corners[0] = offset + vec3(-half_width, 0.0f, 0.0f);
+  corners[1] = offset + vec3(half_width, 0.0f, 0.0f);
+  corners[2] = offset + vec3(half_width, size.y(), 0.0f);
+  corners[3] = offset + vec3(-half_width, size.y(), 0.0f);
+}
+
+// Finds a sphere around every quad that can be drawn for each RenderableId.
+// Must be called after the quads have been created.
+void PieNoonGame::InitializeRenderableBounds() {
+  const Config& config = GetConfig();
+  const CardboardQuad& invalid_front =
+      cardboard_fronts_[RenderableId_Invalid][0];
+  for (int id = 0; id < RenderableId_Count; ++id) {
+    std::vector<const CardboardQuad*> quads;
+    auto& fronts = cardboard_fronts_[id];
+    for (auto it = fronts.begin(); it != fronts.end(); ++it) {
+      if (it->material) quads.push_back(&*it);
+    }
+    // GetCardboardFront() falls back to the invalid front.
+    if (quads.empty()) quads.push_back(&invalid_front);
+    if (cardboard_backs_[id].material) quads.push_back(&cardboard_backs_[id]);
+    if (config.renderables()->Get(id)->stick()) {
+      quads.push_back(&stick_front_);
+      quads.push_back(&stick_back_);
+    }
+
+    vec3 min(std::numeric_limits<float>::infinity());
+    vec3 max(-std::numeric_limits<float>::infinity());
+    for (auto it = quads.begin(); it != quads.end(); ++it) {
+      vec3 corners[4];
+      CardboardQuadCorners(**it, corners);
+      for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 3; ++j) {
+          min[j] = std::min(min[j], corners[i][j]);
+          max[j] = std::max(max[j], corners[i][j]);
+        }
+      }
+    }
+    renderable_bounds_[id] =
+        vec4((min + max) * 0.5f, (max - min).Length() * 0.5f);
+  }
+}
+
+// Puts spheres around this frame's renderables, and their shadows, into the
+// frustum cullers, ready to be tested against each camera.
+void PieNoonGame::UpdateCullingSpheres(const SceneDescription& scene) {
+  const size_t num_renderables = scene.renderables().size();
+  culler_.Clear(num_renderables);
+  shadow_culler_.Clear(num_renderables);
+  const vec3 light = *scene.lights()[0];
+  for (size_t i = 0; i < num_renderables; ++i) {
+    const Renderable& renderable = *scene.renderables()[i];
+    const mat4& world_matrix = renderable.world_matrix();
+    const vec4 bounds(renderable_bounds_[renderable.id()]);
+    const vec3 center = world_matrix * bounds.xyz();
+    float scale = 0.0f;
+    for (int c = 0; c < 3; ++c) {
+      const vec3 axis(world_matrix(0, c), world_matrix(1, c),
+                      world_matrix(2, c));
+      scale = std::max(scale, axis.Length());
+    }
+    const float radius = bounds.w() * scale;
+    culler_.Add(center, radius);
+
+    // Renderables just off screen can still cast shadows onto the screen. The
+    // light is far away, so a shadow is about as wide as the renderable, and
+    // stretched away from the light by one over the sine of its elevation.
+    const vec3 to_center = center - light;
+    if (to_center.y() >= 0.0f) {
+      shadow_culler_.Add(center, radius);
+      continue;
+    }
+    const vec3 on_ground = center + to_center * (center.y() / -to_center.y());
+    const float shadow_radius = radius * to_center.Length() / -to_center.y();
+    shadow_culler_.Add((center + on_ground) * 0.5f,
+                       (on_ground - center).Length() * 0.5f +
+                           std::max(radius, shadow_radius));
+  }
+}
+
+// Estimates how many pixels of a 'resolution' sized screen the quadrilateral
+// 'corners' covers, once transformed by 'clip_from_object'. Edges aren't
+// clipped exactly, and quads that cross the camera plane count for nothing.
+static float ScreenArea(const vec3* corners, const mat4& clip_from_object,
+                        const vec2i& resolution) {
+  vec2 screen[4];
+  for (int i = 0; i < 4; ++i) {
+    const vec4 clip = clip_from_object * vec4(corners[i], 1.0f);
+    if (clip.w() <= 0.0f) return 0.0f;
+    screen[i] = vec2(mathfu::Clamp(clip.x() / clip.w(), -1.0f, 1.0f),
+                     mathfu::Clamp(clip.y() / clip.w(), -1.0f, 1.0f));
+  }
+  float twice_area = 0.0f;
+  for (int i = 0; i < 4; ++i) {
+    const vec2& a = screen[i];
+    const vec2& b = screen[(i + 1) % 4];
+    twice_area += a.x() * b.y() - b.x() * a.y();
+  }
+  // Clip space is two units across.
+  return fabs(twice_area) * 0.125f * resolution.x() * resolution.y();
+}
+
+// Draws the ground, the static renderables of 'scene' that are behind
+// everything else, and the shadows of all static renderables, from the static
+// layer. Redraws the layer first if any of that changed. Fills
+// live_renderables_ with what's left to draw, and projects their shadows into
+// shadow_batch_. Returns false, having drawn nothing, if there is no layer.
+//
+// The layer goes under everything else, without depth. That's only right if
+// what's in it is farther from the camera than anything drawn over it. So
+// static renderables only go into the layer if they're behind all the other
+// renderables and their shadows, except for those flat on the ground, which
+// the others stand on anyway. Everything is treated as its front quad.
+//
+// Only for a single scene view, whose transform is 'camera_transform'.
+bool PieNoonGame::RenderStaticLayer(const SceneDescription& scene,
+                                    const mat4& camera_transform,
+                                    const vec2i& resolution,
+                                    const vec4& world_scale_bias) {
+  // Static renderables are drawn a little past this much, in front.
+  static const float kStaticLayerDepthMargin = 0.1f;
+  // Anything lower than this is flat on the ground.
+  static const float kGroundDecalHeight = 0.05f;
+
+  const int num_renderables = static_cast<int>(scene.renderables().size());
+  live_renderables_.clear();
+  layer_renderables_.clear();
+  static_renderables_.clear();
+  static_layer_depths_.clear();
+
+  // Find how far back the renderables that move go. Shadows of static
+  // renderables go into the layer whether or not they do.
+  dynamic_renderables_.clear();
+  float farthest = 0.0f;
+  for (int i = 0; i < num_renderables; ++i) {
+    const Renderable& renderable = *scene.renderables()[i];
+    vec3 corners[4];
+    CardboardQuadCorners(
+        GetCardboardFront(renderable.id(), renderable.variant()), corners);
+    float nearest_corner = std::numeric_limits<float>::infinity();
+    float farthest_corner = 0.0f;
+    bool on_ground = true;
+    const mat4 clip_from_object = camera_transform * renderable.world_matrix();
+    for (int j = 0; j < 4; ++j) {
+      const float depth = (clip_from_object * vec4(corners[j], 1.0f)).w();
+      nearest_corner = std::min(nearest_corner, depth);
+      farthest_corner = std::max(farthest_corner, depth);
+      on_ground = on_ground &&
+                  (renderable.world_matrix() * corners[j]).y() <
+                      kGroundDecalHeight;
+    }
+    if (!renderable.is_static()) {
+      dynamic_renderables_.push_back(i);
+      farthest = std::max(farthest, farthest_corner);
+      continue;
+    }
+    static_renderables_.push_back(i);
+    StaticLayerDepth depth = {i, on_ground ? -1.0f : nearest_corner,
+                              farthest_corner};
+    static_layer_depths_.push_back(depth);
+  }
+  UpdateShadowBatch(scene, dynamic_renderables_, &shadow_batch_);
+  farthest = std::max(farthest, shadow_batch_.FarthestDepth(camera_transform));
+
+  // Going from the front, static renderables that something could be drawn
+  // behind are drawn live too. Everything behind them goes into the layer.
+  std::vector<bool> in_layer(num_renderables, false);
+  std::sort(static_layer_depths_.begin(), static_layer_depths_.end(),
+            [](const StaticLayerDepth& a, const StaticLayerDepth& b) {
+    return a.nearest < b.nearest;
+  });
+  for (auto it = static_layer_depths_.begin();
+       it != static_layer_depths_.end(); ++it) {
+    if (it->nearest < 0.0f ||
+        it->nearest > farthest + kStaticLayerDepthMargin) {
+      in_layer[it->index] = true;
+    } else {
+      farthest = std::max(farthest, it->farthest);
+    }
+  }
+
+  // Keep the scene's draw order within the layer and without.
+  for (int i = 0; i < num_renderables; ++i) {
+    (in_layer[i] ? layer_renderables_ : live_renderables_).push_back(i);
+  }
+
+  // See if the layer still shows what it should.
+  bool changed = !static_layer_.valid() ||
+                 resolution.x() != static_layer_resolution_.x() ||
+                 resolution.y() != static_layer_resolution_.y() ||
+                 static_layer_items_.size() != static_renderables_.size();
+  for (int i = 0; i < 16; ++i) {
+    changed = changed || static_layer_camera_[i] != camera_transform[i];
+  }
+  const vec3 light = *scene.lights()[0];
+  const vec3 layer_light(static_layer_light_);
+  changed = changed || light.x() != layer_light.x() ||
+            light.y() != layer_light.y() || light.z() != layer_light.z();
+  static_layer_items_.resize(static_renderables_.size());
+  for (size_t i = 0; i < static_renderables_.size(); ++i) {
+    const int index = static_renderables_[i];
+    const Renderable& renderable = *scene.renderables()[index];
+    StaticLayerItem item;
+    item.id = renderable.id();
+    item.variant = renderable.variant();
+    item.in_layer = in_layer[index];
+    item.color = renderable.color();
+    const mat4& world_matrix = renderable.world_matrix();
+    for (int j = 0; j < 16; ++j) item.world_matrix[j] = world_matrix[j];
+    if (!item.SameAs(static_layer_items_[i])) {
+      static_layer_items_[i] = item;
+      changed = true;
+    }
+  }
+
+  // Redraw the layer.
+  const float screen_pixels =
+      static_cast<float>(resolution.x()) * static_cast<float>(resolution.y());
+  const vec2 ground_size = GroundPlaneSize();
+  const vec3 ground_corners[] = {
+      vec3(-ground_size.x(), 0.0f, 0.0f), vec3(ground_size.x(), 0.0f, 0.0f),
+      vec3(ground_size.x(), 0.0f, ground_size.y()),
+      vec3(-ground_size.x(), 0.0f, ground_size.y())};
+  const float ground_pixels =
+      ScreenArea(ground_corners, camera_transform, resolution);
+  if (changed) {
+    if (!static_layer_.Begin(renderer_, resolution)) return false;
+    renderer_.DepthTest(true);
+    RenderGround();
+    UpdateShadowBatch(scene, static_renderables_, &static_shadow_batch_);
+    RenderShadowBatch(static_shadow_batch_, world_scale_bias);
+    const int num_prop_draws = RenderCardboard(scene, layer_renderables_);
+    static_layer_.End();
+
+    for (int i = 0; i < 16; ++i) static_layer_camera_[i] = camera_transform[i];
+    static_layer_resolution_ = resolution;
+    static_layer_light_ = light;
+
+    // What drawing the contents of the layer directly would cost. Shadows
+    // are small; only count their draw calls.
+    static_layer_cost_.draws =
+        1 + static_shadow_batch_.num_draws() + num_prop_draws;
+    static_layer_cost_.pixels = ground_pixels;
+    for (auto it = layer_renderables_.begin(); it != layer_renderables_.end();
+         ++it) {
+      const Renderable& renderable = *scene.renderables()[*it];
+      const mat4 clip_from_object =
+          camera_transform * renderable.world_matrix();
+      vec3 corners[4];
+      CardboardQuadCorners(
+          GetCardboardFront(renderable.id(), renderable.variant()), corners);
+      static_layer_cost_.pixels +=
+          ScreenArea(corners, clip_from_object, resolution);
+      if (cardboard_backs_[renderable.id()].material) {
+        CardboardQuadCorners(cardboard_backs_[renderable.id()], corners);
+        static_layer_cost_.pixels +=
+            ScreenArea(corners, clip_from_object, resolution);
+      }
     }
+    static_layer_stats_.rebuilds++;
   }
+
+  // Copy the layer to the screen, with blending off so that it replaces
+  // whatever was there.
+  renderer_.DepthTest(false);
+  renderer_.SetBlendMode(fplbase::kBlendModeOff);
+  static_layer_.Composite(renderer_, shader_textured_);
+
+  // Put the ground back into the depth buffer, for the live renderables to
+  // stand on.
   renderer_.DepthTest(true);
+  GL_CALL(glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE));
+  RenderGround();
+  GL_CALL(glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE));
+
+  // Drawing the layer costs two draw calls, one full screen of pixels and the
+  // ground's worth of depth. Redrawing it costs what it saves.
+  static_layer_stats_.frames++;
+  static_layer_stats_.draws_saved -= 2;
+  static_layer_stats_.pixels_saved -= screen_pixels + ground_pixels;
+  if (!changed) {
+    static_layer_stats_.draws_saved += static_layer_cost_.draws;
+    static_layer_stats_.pixels_saved += static_layer_cost_.pixels;
+  }
+  return true;
+}
 
-  // Now render the Renderables normally, on top of the shadows.
-  RenderCardboard(scene, camera_transform);
+// The transform that takes 'scene' into clip space, for a camera moved by
+// 'additional_camera_changes' and a viewport 'resolution' pixels in size.
+mat4 PieNoonGame::CameraTransform(const SceneDescription& scene,
+                                  const mat4& additional_camera_changes,
+                                  const vec2i& resolution) const {
+  const Config& config = GetConfig();
+  const Config& cardboard_config = GetCardboardConfig();
+
+  float viewport_angle = game_state_.is_in_cardboard()
+                             ? cardboard_config.viewport_angle()
+                             : config.viewport_angle();
+  // Final matrix that applies the view frustum to bring into screen space.
+  mat4 perspective_matrix_ = mat4::Perspective(
+      viewport_angle, resolution.x() / static_cast<float>(resolution.y()),
+      config.viewport_near_plane(), config.viewport_far_plane(), -1.0f);
+
+  return perspective_matrix_ * (additional_camera_changes * scene.camera());
+}
+
+// Returns the number of draw calls the 3D elements took.
+int PieNoonGame::RenderScene(const SceneDescription& scene,
+                             const mat4& additional_camera_changes,
+                             const vec2i& resolution) {
+  scene_views_[0].camera_transform =
+      CameraTransform(scene, additional_camera_changes, resolution);
+  const int num_draws = Render3DElements(scene, resolution, 1);
 
   // Render any UI/HUD/Splash on top
   Render2DElements(scene, additional_camera_changes);
+  return num_draws;
+}
+
+// Draws the ground, shadows and renderables of 'scene' through the first
+// 'num_views' of scene_views_, whose transforms must already be set. Each
+// view is 'resolution' pixels in size. Returns the number of draw calls it
+// took.
+int PieNoonGame::Render3DElements(const SceneDescription& scene,
+                                  const vec2i& resolution, int num_views) {
+  const Config& config = GetConfig();
+  num_scene_views_ = num_views;
+
+  const vec2 ground_size = GroundPlaneSize();
+  const vec4 world_scale_bias(1.0f / (2.0f * ground_size.x()),
+                              1.0f / ground_size.y(), 0.5f, 0.0f);
+
+  // Skip what each view can't see, in both the shadow and main passes.
+  // Shadows are projected once for all views, so keep any that one of them
+  // might see.
+  const size_t num_renderables = scene.renderables().size();
+  const bool cull = culler_.num_spheres() == num_renderables;
+  shadow_visible_.assign(num_renderables, 0);
+  for (int i = 0; i < num_views; ++i) {
+    SceneView& view = scene_views_[i];
+    if (cull) {
+      culling_stats_.passes++;
+      culling_stats_.renderables += static_cast<int>(culler_.num_spheres());
+      culling_stats_.renderables_culled +=
+          culler_.Cull(view.camera_transform, &view.visible);
+      culling_stats_.shadows += static_cast<int>(shadow_culler_.num_spheres());
+      culling_stats_.shadows_culled +=
+          shadow_culler_.Cull(view.camera_transform, &view.shadow_visible);
+    } else {
+      view.visible.assign(num_renderables, 1);
+      view.shadow_visible.assign(num_renderables, 1);
+    }
+    for (size_t j = 0; j < num_renderables; ++j) {
+      shadow_visible_[j] |= view.shadow_visible[j];
+    }
+  }
+
+  // Draw the ground, the props that haven't moved and their shadows, from
+  // the static layer if we can. Otherwise, draw the ground now, and
+  // everything else with the rest of the scene.
+  const bool use_static_layer =
+      num_views == 1 && !game_state_.is_in_cardboard() &&
+      config.use_static_layer() &&
+      RenderStaticLayer(scene, scene_views_[0].camera_transform, resolution,
+                        world_scale_bias);
+  // Compositing the static layer and restoring the ground's depth take a
+  // draw call each.
+  int num_draws = use_static_layer ? 2 : num_views;
+  if (!use_static_layer) {
+    live_renderables_.resize(num_renderables);
+    for (size_t i = 0; i < live_renderables_.size(); ++i) {
+      live_renderables_[i] = static_cast<int>(i);
+    }
+    RenderGround();
+    UpdateShadowBatch(scene, live_renderables_, &shadow_batch_);
+  }
+
+  // Render shadows first, so that the Renderables cover them.
+  RenderShadowBatch(shadow_batch_, world_scale_bias);
+  num_draws += shadow_batch_.num_draws() * num_views;
+
+  // Now render the Renderables normally, on top of the shadows.
+  num_draws += RenderCardboard(scene, live_renderables_);
+  return num_draws;
 }
 
 void PieNoonGame::Render2DElements(const SceneDescription& scene,
@@ -953,6 +1652,12 @@ void PieNoonGame::Render2DElements(const SceneDescription& scene,
   // Loop through the 2D elements. Draw each subsequent one slightly closer
   // to the camera so that they appear on top of the previous ones.
   gui_menu_.Render(&renderer_);
+
+#ifdef PIE_NOON_USES_GOOGLE_PLAY_GAMES
+  if (GetConfig().draw_network_overlay() && !game_state_.is_in_cardboard()) {
+    RenderNetworkOverlay();
+  }
+#endif
 }
 
 void PieNoonGame::CorrectCardboardCamera(mat4& cardboard_camera) {
@@ -988,6 +1693,163 @@ void PieNoonGame::DebugPrintPieStates() {
   }
 }
 
+// Debug function to print out what the static layer saved, once a second.
+void PieNoonGame::DebugPrintRenderStats(WorldTime world_time) {
+  if (world_time - debug_render_stats_time_ < kMillisecondsPerSecond) return;
+  debug_render_stats_time_ = world_time;
+
+  const StaticLayerStats& stats = static_layer_stats_;
+  fplbase::LogInfo(fplbase::kApplication,
+                   "Static layer: %d frames, %d redrawn, %d draw calls and "
+                   "%.2f Mpixels saved. Shadows: %d draw calls.\n",
+                   stats.frames, stats.rebuilds, stats.draws_saved,
+                   stats.pixels_saved / 1000000.0,
+                   shadow_batch_.num_draws());
+  const CullingStats& culling = culling_stats_;
+  fplbase::LogInfo(fplbase::kApplication,
+                   "Culling: %d passes, %d of %d renderables and %d of %d "
+                   "shadows culled.\n",
+                   culling.passes, culling.renderables_culled,
+                   culling.renderables, culling.shadows_culled,
+                   culling.shadows);
+  const HeadPoseLatencyStats& latency = head_pose_latency_stats_;
+  if (latency.frames > 0) {
+    fplbase::LogInfo(fplbase::kApplication,
+                     "Head pose to submit: %.2f ms from input (max %.2f), "
+                     "%.2f ms from latch (max %.2f), over %d frames.\n",
+                     latency.input_to_submit / (1000.0 * latency.frames),
+                     latency.max_input_to_submit / 1000.0,
+                     latency.latched_to_submit / (1000.0 * latency.frames),
+                     latency.max_latched_to_submit / 1000.0, latency.frames);
+  }
+  for (int single_pass = 0; single_pass < 2; ++single_pass) {
+    StereoStats& stereo = stereo_stats_[single_pass];
+    if (stereo.frames == 0) continue;
+    fplbase::LogInfo(fplbase::kApplication,
+                     "%s stereo: %.1f 3D draw calls and %.2f ms CPU per "
+                     "frame, over %d frames.\n",
+                     single_pass ? "Single pass" : "Two pass",
+                     stereo.draws / static_cast<double>(stereo.frames),
+                     stereo.cpu_time / (1000.0 * stereo.frames),
+                     stereo.frames);
+    stereo = StereoStats();
+  }
+  static_layer_stats_ = StaticLayerStats();
+  culling_stats_ = CullingStats();
+  head_pose_latency_stats_ = HeadPoseLatencyStats();
+}
+
+#ifdef PIE_NOON_USES_GOOGLE_PLAY_GAMES
+// Debug function to print out multiscreen traffic, once a second.
+void PieNoonGame::DebugPrintNetworkStats(WorldTime world_time) {
+  if (world_time - debug_network_stats_time_ < kMillisecondsPerSecond) return;
+  debug_network_stats_time_ = world_time;
+
+  const GPGMultiplayer::NetworkStats& stats = gpg_multiplayer_.network_stats();
+  fplbase::LogInfo(fplbase::kApplication,
+                   "Network: commands queued %d (max %d), "
+                   "events queued %d (max %d)\n",
+                   static_cast<int>(stats.command_queue_depth),
+                   static_cast<int>(stats.max_command_queue_depth),
+                   static_cast<int>(stats.event_queue_depth),
+                   static_cast<int>(stats.max_event_queue_depth));
+  for (auto it = stats.instances.begin(); it != stats.instances.end(); ++it) {
+    const GPGMultiplayer::InstanceStats& instance = it->second;
+    const int player = gpg_multiplayer_.GetPlayerNumberByInstanceId(it->first);
+    fplbase::LogInfo(
+        fplbase::kApplication,
+        "  player %d: sent %llu msgs / %llu bytes, received %llu msgs / "
+        "%llu bytes, send latency %llu us (max %llu us)\n",
+        player, static_cast<unsigned long long>(instance.messages_sent),
+        static_cast<unsigned long long>(instance.bytes_sent),
+        static_cast<unsigned long long>(instance.messages_received),
+        static_cast<unsigned long long>(instance.bytes_received),
+        static_cast<unsigned long long>(instance.AverageSendLatency()),
+        static_cast<unsigned long long>(instance.max_send_latency));
+    if (gpg_multiplayer_.is_hosting() && player >= 0 &&
+        player < static_cast<int>(game_state_.characters().size())) {
+      const PlayerNetworkStats& rtt =
+          multiplayer_director_->player_network_stats(player);
+      fplbase::LogInfo(fplbase::kApplication,
+                       "  player %d: round trip %d ms (smoothed %d ms, "
+                       "max %d ms), %d of %d pings answered\n",
+                       player, rtt.last_round_trip, rtt.smoothed_round_trip,
+                       rtt.max_round_trip, rtt.pongs_received, rtt.pings_sent);
+    }
+  }
+}
+
+// Debug overlay for the numbers DebugPrintNetworkStats() logs. There's no
+// text rendering, so each connection gets a row of bars in the top left:
+// average send latency (green), smoothed round trip time (yellow, host only),
+// and, in a row of their own at the top, the command (red) and event (blue)
+// queue depths. A gray line marks the maximum of each.
+void PieNoonGame::RenderNetworkOverlay() {
+  static const float kMargin = 8.0f;
+  static const float kBarHeight = 6.0f;
+  static const float kRowHeight = 10.0f;
+  static const float kMaxBarLength = 400.0f;
+  static const float kPixelsPerMillisecond = 2.0f;
+  static const float kPixelsPerQueuedItem = 8.0f;
+  static const vec4 kMaxColor(0.5f, 0.5f, 0.5f, 0.8f);
+
+  const vec2i res = renderer_.window_size();
+  renderer_.set_model_view_projection(mathfu::OrthoHelper<float>(
+      0.0f, static_cast<float>(res.x()), static_cast<float>(res.y()), 0.0f,
+      -1.0f, 1.0f));
+  renderer_.SetBlendMode(fplbase::kBlendModeAlpha);
+
+  // Draws a bar 'length' pixels long at the start of 'row', with a mark at
+  // 'max_length'.
+  auto DrawBar = [&](int row, float y_offset, float length, float max_length,
+                     const vec4& color) {
+    const float top = kMargin + row * kRowHeight + y_offset;
+    const float bottom = top + kBarHeight * 0.5f;
+    const float end = kMargin + std::min(length, kMaxBarLength);
+    const float max_end = kMargin + std::min(max_length, kMaxBarLength);
+    renderer_.set_color(kMaxColor);
+    shader_color_->Set(renderer_);
+    fplbase::Mesh::RenderAAQuadAlongX(vec3(max_end, top, 0.0f),
+                                      vec3(max_end + 1.0f, bottom, 0.0f),
+                                      mathfu::kZeros2f, mathfu::kOnes2f);
+    renderer_.set_color(color);
+    shader_color_->Set(renderer_);
+    fplbase::Mesh::RenderAAQuadAlongX(vec3(kMargin, top, 0.0f),
+                                      vec3(end, bottom, 0.0f),
+                                      mathfu::kZeros2f, mathfu::kOnes2f);
+  };
+
+  const GPGMultiplayer::NetworkStats& stats = gpg_multiplayer_.network_stats();
+  DrawBar(0, 0.0f, stats.command_queue_depth * kPixelsPerQueuedItem,
+          stats.max_command_queue_depth * kPixelsPerQueuedItem,
+          vec4(1.0f, 0.2f, 0.2f, 0.8f));
+  DrawBar(0, kBarHeight * 0.5f, stats.event_queue_depth * kPixelsPerQueuedItem,
+          stats.max_event_queue_depth * kPixelsPerQueuedItem,
+          vec4(0.2f, 0.4f, 1.0f, 0.8f));
+
+  int row = 1;
+  for (auto it = stats.instances.begin(); it != stats.instances.end();
+       ++it, ++row) {
+    const GPGMultiplayer::InstanceStats& instance = it->second;
+    DrawBar(row, 0.0f,
+            instance.AverageSendLatency() / 1000.0f * kPixelsPerMillisecond,
+            instance.max_send_latency / 1000.0f * kPixelsPerMillisecond,
+            vec4(0.2f, 1.0f, 0.2f, 0.8f));
+    const int player = gpg_multiplayer_.GetPlayerNumberByInstanceId(it->first);
+    if (gpg_multiplayer_.is_hosting() && multiplayer_director_ != nullptr &&
+        player >= 0 &&
+        player < static_cast<int>(game_state_.characters().size())) {
+      const PlayerNetworkStats& rtt =
+          multiplayer_director_->player_network_stats(player);
+      DrawBar(row, kBarHeight * 0.5f,
+              rtt.smoothed_round_trip * kPixelsPerMillisecond,
+              rtt.max_round_trip * kPixelsPerMillisecond,
+              vec4(1.0f, 1.0f, 0.2f, 0.8f));
+    }
+  }
+}
+#endif  // PIE_NOON_USES_GOOGLE_PLAY_GAMES
+
 const Config& PieNoonGame::GetConfig() const {
   return *fpl::pie_noon::GetConfig(config_source_.c_str());
 }
@@ -1225,6 +2087,7 @@ PieNoonState PieNoonGame::UpdatePieNoonState() {
           gui_menu_.Setup(TitleScreenButtons(config), &matman_);
           game_state_.set_is_in_cardboard(false);
           game_state_.Reset();
+          DiscardScenes();
         } else {
           input_.set_exit_requested(true);
         }
@@ -1352,6 +2215,7 @@ void PieNoonGame::TransitionToPieNoonState(PieNoonState next_state) {
       }
 
       game_state_.EnterJoiningMode();
+      DiscardScenes();
       break;
     }
     case kPlaying: {
@@ -1377,6 +2241,7 @@ void PieNoonGame::TransitionToPieNoonState(PieNoonState next_state) {
         music_channel_ = audio_engine_.PlaySound("MusicAction");
         ambience_channel_ = audio_engine_.PlaySound("Ambience");
         game_state_.Reset(GameState::kTrackAnalytics);
+        DiscardScenes();
       }
       break;
     }
@@ -1671,7 +2536,7 @@ void PieNoonGame::ProcessMultiplayerMessages() {
               CurrentWorldTime(input_) +
               start_turn->seconds() * kMillisecondsPerSecond;
 
-          ProcessPlayerStatusMessage(*start_turn->player_status());
+          ProcessPlayerStatusMessage(*start_turn->player_status(), true);
 
 #ifdef PIE_NOON_USES_GOOGLE_PLAY_GAMES
           SendMultiscreenPlayerCommand();
@@ -1686,13 +2551,25 @@ void PieNoonGame::ProcessMultiplayerMessages() {
               (const multiplayer::EndGame*)message->data();
           fplbase::LogInfo(fplbase::kApplication,
                            "Multiplayer message: EndGame.");
-          ProcessPlayerStatusMessage(*end_game->player_status());
+          ProcessPlayerStatusMessage(*end_game->player_status(), true);
           // The game is over, go to the wait screen.
           TransitionToPieNoonState(kMultiplayerWaiting);
         } else if (message->data_type() == multiplayer::Data_PlayerStatus) {
           const multiplayer::PlayerStatus* player_status =
               (const multiplayer::PlayerStatus*)message->data();
-          ProcessPlayerStatusMessage(*player_status);
+          ProcessPlayerStatusMessage(*player_status, false);
+        } else if (message->data_type() == multiplayer::Data_Ping) {
+          const multiplayer::Ping* ping =
+              (const multiplayer::Ping*)message->data();
+          multiplayer_director_->SendPongMsg(sender, *ping);
+        } else if (message->data_type() == multiplayer::Data_Pong) {
+          const multiplayer::Pong* pong =
+              (const multiplayer::Pong*)message->data();
+          if (gpg_multiplayer_.is_hosting()) {
+            multiplayer_director_->ReceivePong(
+                gpg_multiplayer_.GetPlayerNumberByInstanceId(sender), *pong,
+                CurrentWorldTime(input_));
+          }
         } else {
           fplbase::LogError(fplbase::kApplication,
                    "Multiplayer message has a data type of NONE.");
@@ -1724,28 +2601,103 @@ void PieNoonGame::ProcessMultiplayerMessages() {
 }
 
 void PieNoonGame::ProcessPlayerStatusMessage(
+    const multiplayer::PlayerStatus& status, bool apply_now) {
+  ReconcileMultiscreenCommand(status);
+
+  const std::vector<uint8_t> health(status.player_health()->begin(),
+                                    status.player_health()->end());
+  const std::vector<uint8_t> splats(status.player_splats()->begin(),
+                                    status.player_splats()->end());
+  if (!multiscreen_snapshots_.AddSnapshot(
+          status.host_time(), CurrentWorldTime(input_), health, splats)) {
+    // A newer status has already arrived, so this one is out of date.
+    return;
+  }
+  if (apply_now) {
+    multiscreen_snapshots_.DiscardAllButNewest();
+    ApplyMultiscreenStatus(std::vector<float>(health.begin(), health.end()),
+                           splats, true);
+  }
+}
+
+// The host echoes back the command it is going to carry out for us. We've
+// been displaying our own command since the button was pressed, so only take
+// the host's version once it has seen that command, and it disagrees.
+void PieNoonGame::ReconcileMultiscreenCommand(
     const multiplayer::PlayerStatus& status) {
-  // Iterate through characters and player healths.
+  const auto* commands = status.player_commands();
+  if (commands == nullptr ||
+      multiscreen_my_player_id_ >= static_cast<int>(commands->Length())) {
+    return;
+  }
+  const multiplayer::CommandAck* ack = commands->Get(multiscreen_my_player_id_);
+  const int16_t sequence_delta =
+      static_cast<int16_t>(ack->sequence() - multiscreen_command_sequence_);
+  if (sequence_delta < 0) return;  // Our latest command is still in flight.
+
+  const ButtonId action = ack->is_firing() ? ButtonId_Attack
+                          : ack->is_blocking() ? ButtonId_Defend
+                                               : ButtonId_Cancel;
+  const CharacterId aim_at =
+      ack->aim_at() >= 0 ? ack->aim_at() : multiscreen_action_aim_at_;
+  if (action != multiscreen_action_to_perform_ ||
+      aim_at != multiscreen_action_aim_at_) {
+    fplbase::LogInfo(fplbase::kApplication,
+                     "Host corrected our command (sequence %d).",
+                     ack->sequence());
+    multiscreen_action_to_perform_ = action;
+    multiscreen_action_aim_at_ = aim_at;
+    UpdateMultiscreenMenuIcons();
+  }
+}
+
+// Each frame, show the player statuses as of a moment ago, blended between
+// the statuses received either side of that moment.
+void PieNoonGame::UpdateMultiscreenClientStatus(WorldTime world_time) {
+  std::vector<float> health;
+  std::vector<uint8_t> splats;
+  if (multiscreen_snapshots_.Sample(
+          world_time,
+          GetConfig()
+              .multiscreen_options()
+              ->client_interpolation_delay_milliseconds(),
+          &health, &splats)) {
+    ApplyMultiscreenStatus(health, splats, false);
+  }
+}
+
+void PieNoonGame::ApplyMultiscreenStatus(const std::vector<float>& health,
+                                         const std::vector<uint8_t>& splats,
+                                         bool force) {
+  // Iterate through characters and player healths. Round up, so nobody is
+  // shown as knocked out until the host says they are.
+  bool health_changed = false;
   auto c = game_state_.characters().begin();
-  auto h = status.player_health()->begin();
-  for (; c != game_state_.characters().end() &&
-         h != status.player_health()->end();
-       ++c, ++h) {
-    (*c)->set_health(*h);
-  }
-  unsigned char splats;
-  if (multiscreen_my_player_id_ >=
-          static_cast<int>(status.player_splats()->Length()) ||
+  auto h = health.begin();
+  for (; c != game_state_.characters().end() && h != health.end(); ++c, ++h) {
+    const CharacterHealth new_health =
+        static_cast<CharacterHealth>(ceilf(*h));
+    if ((*c)->health() != new_health) {
+      (*c)->set_health(new_health);
+      health_changed = true;
+    }
+  }
+  uint8_t my_splats;
+  if (multiscreen_my_player_id_ >= static_cast<int>(splats.size()) ||
       game_state_.characters()[multiscreen_my_player_id_]->health() <= 0) {
     // we're an invalid player (or a dead one), don't show our splats.
-    splats = 0;
+    my_splats = 0;
   } else {
-    splats = status.player_splats()->Get(multiscreen_my_player_id_);
+    my_splats = splats[multiscreen_my_player_id_];
   }
+  if (!force && !health_changed && my_splats == multiscreen_displayed_splats_) {
+    return;
+  }
+  multiscreen_displayed_splats_ = my_splats;
 
   int new_splats = 0;
   for (int i = 0; i < GetConfig().multiscreen_options()->max_players(); i++) {
-    if (splats & (1 << i)) {
+    if (my_splats & (1 << i)) {
       // splat i is active
       if (ShowMultiscreenSplat(i)) {
         new_splats++;
@@ -1763,7 +2715,12 @@ void PieNoonGame::ProcessPlayerStatusMessage(
     // play a sound effect for the new splat(s) we got
     audio_engine_.PlaySound("HitWithLargePie");
   }
+  if (!force) {
+    // Mid-turn, so nothing else is going to refresh the buttons.
+    UpdateMultiscreenMenuIcons();
+  }
 }
+
 #endif  // PIE_NOON_USES_GOOGLE_PLAY_GAMES
 
 bool PieNoonGame::ShowMultiscreenSplat(int splat_num) {
@@ -2022,6 +2979,7 @@ PieNoonState PieNoonGame::HandleMenuButtons(WorldTime time) {
 #ifdef ANDROID_HMD
         game_state_.set_is_in_cardboard(true);
         game_state_.Reset();
+        DiscardScenes();
         input_.head_mounted_display_input().ResetHeadTracker();
         TransitionToPieNoonState(kFinished);
         const Config& config = GetConfig();
@@ -2056,6 +3014,7 @@ PieNoonState PieNoonGame::HandleMenuButtons(WorldTime time) {
         if (game_state_.is_in_cardboard()) {
           game_state_.set_is_in_cardboard(false);
           game_state_.Reset();
+          DiscardScenes();
           TransitionToPieNoonState(kFinished);
         }
         gui_menu_.Setup(TitleScreenButtons(config), &matman_);
@@ -2124,6 +3083,7 @@ void PieNoonGame::StartMultiscreenGameAsHost() {
   multiplayer_director_->set_num_ai_players(
       GetConfig().multiscreen_options()->max_players() - connected_players);
   game_state_.Reset(GameState::kNoAnalytics);
+  DiscardScenes();
   multiplayer_director_->StartGame();
   TransitionToPieNoonState(kJoining);
   SendTrackerEvent(kCategoryMultiscreen, kActionStart, kLabelGameHost,
@@ -2136,6 +3096,7 @@ void PieNoonGame::StartMultiscreenGameAsClient(CharacterId id) {
   // Set up the menu screen.
   gui_menu_.Setup(GetConfig().multiplayer_client(), &matman_);
   game_state_.Reset(GameState::kNoAnalytics);
+  DiscardScenes();
   int num_players = GetConfig().character_count();
   // Set multiplayer_action_button to the correct button ID, and color-code the
   // other buttons to correspond to the players.
@@ -2144,6 +3105,8 @@ void PieNoonGame::StartMultiscreenGameAsClient(CharacterId id) {
   multiscreen_action_aim_at_ = (id + 1) % num_players;
   multiscreen_turn_number_ = 0;
   multiscreen_turn_end_time_ = 0;
+  multiscreen_snapshots_.Reset();
+  multiscreen_displayed_splats_ = 0;
   SendMultiscreenPlayerCommand();
   UpdateMultiscreenMenuIcons();
   TransitionToPieNoonState(kMultiscreenClient);
@@ -2151,13 +3114,15 @@ void PieNoonGame::StartMultiscreenGameAsClient(CharacterId id) {
 }
 
 void PieNoonGame::SendMultiscreenPlayerCommand() {
+  multiscreen_command_sequence_++;
   flatbuffers::FlatBufferBuilder builder;
   auto message_root = multiplayer::CreateMessageRoot(
       builder, multiplayer::Data_PlayerCommand,
       multiplayer::CreatePlayerCommand(
           builder, multiscreen_action_aim_at_,
           (multiscreen_action_to_perform_ == ButtonId_Attack),
-          (multiscreen_action_to_perform_ == ButtonId_Defend))
+          (multiscreen_action_to_perform_ == ButtonId_Defend),
+          multiscreen_command_sequence_)
           .Union());
 
   builder.Finish(message_root);
@@ -2347,10 +3312,19 @@ void PieNoonGame::SetupWaitingForPlayersMenu() {
 // to keep them up to date so we can check their inputs as needed.)
 void PieNoonGame::UpdateControllers(WorldTime delta_time) {
   for (size_t i = 0; i < active_controllers_.size(); i++) {
-    if (active_controllers_[i].get() != nullptr) {
-      active_controllers_[i]->AdvanceFrame(delta_time);
+    Controller* controller = active_controllers_[i].get();
+    // The AIs are run by ai_scheduler_, below.
+    if (controller != nullptr &&
+        controller->controller_type() != Controller::kTypeAI) {
+      controller->AdvanceFrame(delta_time);
     }
   }
+  // The lookahead AIs plan from the whole game, other controllers' inputs
+  // included, so save it before the AIs start writing theirs.
+  if (GetConfig().ai_type() == AiType_Lookahead) {
+    game_state_.SaveSnapshot(&ai_frame_snapshot_);
+  }
+  ai_scheduler_.AdvanceFrame(delta_time);
 }
 
 void PieNoonGame::UpdateTouchButtons(WorldTime delta_time) {
@@ -2482,6 +3456,20 @@ bool PieNoonGame::ShouldTransitionFromSlide(WorldTime world_time) {
   return time_in_slide >= display_time;
 }
 
+// Update game logic by a variable number of milliseconds. Touches nothing
+// but the game state, and the audio engine through it, so that it can run on
+// the simulation thread.
+void PieNoonGame::AdvanceGameState(WorldTime delta_time) {
+  if (state_ != kPaused && state_ != kMultiscreenClient) {
+    game_state_.AdvanceFrame(delta_time, &audio_engine_);
+  } else {
+    // We are the client, we only update a few small things.
+    game_state_.particle_manager().AdvanceFrame(
+        static_cast<TimeStep>(delta_time));
+    game_state_.engine().AdvanceFrame(delta_time);
+  }
+}
+
 void PieNoonGame::Run() {
   // Initialize so that we don't sleep the first time through the loop.
   const Config& config = GetConfig();
@@ -2490,12 +3478,14 @@ void PieNoonGame::Run() {
   prev_world_time_ = CurrentWorldTime(input_) - min_update_time;
   TransitionToPieNoonState(kLoadingInitialMaterials);
   game_state_.Reset(GameState::kNoAnalytics);
+  DiscardScenes();
 
   while (!input_.exit_requested() &&
          !input_.GetButton(fplbase::FPLK_ESCAPE).went_down()) {
     // Process input device messages since the last game loop.
     // Update render window size.
     input_.AdvanceFrame(&renderer_.window_size());
+    frame_input_time_ = NowMicroseconds();
 
     // Milliseconds elapsed since last update. To avoid burning through the
     // CPU, enforce a minimum time between updates. For example, if
@@ -2577,6 +3567,7 @@ void PieNoonGame::Run() {
         if (game_state_.is_multiscreen() && multiplayer_director_ != nullptr &&
             state_ == kPlaying) {
           multiplayer_director_->AdvanceFrame(delta_time);
+          multiplayer_director_->SendPingMsgs(world_time);
           bool show_look = (multiplayer_director_->start_turn_timer() < 1000 &&
                             (multiplayer_director_->turn_timer() == 0 ||
                              multiplayer_director_->turn_timer() > 2000));
@@ -2624,6 +3615,7 @@ void PieNoonGame::Run() {
 
         if (state_ == kMultiscreenClient) {
           // do multiscreen client logic
+          UpdateMultiscreenClientStatus(world_time);
           if (CurrentWorldTime(input_) <= multiscreen_turn_end_time_) {
             // We are during a turn, update timer and splats.
             UpdateCountdownImage(CurrentWorldTime(input_));
@@ -2713,16 +3705,45 @@ void PieNoonGame::Run() {
         }
 #endif
 
-        if (state_ != kPaused && state_ != kMultiscreenClient) {
-          // Update game logic by a variable number of milliseconds.
-          game_state_.AdvanceFrame(delta_time, &audio_engine_);
+        if (simulation_thread_.running() && state_ != kMultiscreenClient) {
+          // Update the game, and fill in the next scene from it, on the
+          // simulation thread. Meanwhile, draw the scene from the frame
+          // before. Nothing here touches the game state until it's done.
+          const int next_scene_index = (scene_index_ + 1) % kNumSceneBuffers;
+          simulation_thread_.Start([this, delta_time, next_scene_index]() {
+            AdvanceGameState(delta_time);
+            game_state_.PopulateScene(&scenes_[next_scene_index]);
+          });
+          // There's no scene to draw until the first has been filled in.
+          const SceneDescription& scene = scenes_[scene_index_];
+          if (!scene.lights().empty()) Render(scene);
+          simulation_thread_.Wait();
+          scene_index_ = next_scene_index;
         } else {
-          // We are the client, we only update a few small things.
-          game_state_.particle_manager().AdvanceFrame(
-              static_cast<TimeStep>(delta_time));
-          game_state_.engine().AdvanceFrame(delta_time);
+          AdvanceGameState(delta_time);
+
+          // Issue draw calls for the 'scene'.
+          SceneDescription& scene = scenes_[scene_index_];
+          if (state_ != kMultiscreenClient) {
+            // Populate 'scene' from the game state--all the positions,
+            // orientations, and renderable-ids (which specify materials) of
+            // the characters and props. Also specify the camera matrix.
+            game_state_.PopulateScene(&scene);
+
+            // Issue draw calls for the 'scene'.
+            Render(scene);
+          } else {
+            Render2DElements(scene, mat4::Identity());
+          }
         }
 
+        // The frame's been handed to GL. What it cost the CPU up to here,
+        // rather than the time between frames, which includes waiting for
+        // vsync, is what the particle budget should track.
+        game_state_.particle_manager().RecordFrameCost(
+            static_cast<TimeStep>(NowMicroseconds() - frame_input_time_) /
+            1000.0f);
+
         if (state_ == kPlaying && !stinger_channel_.Valid() &&
             game_state_.IsGameOver()) {
           game_state_.DetermineWinnersAndLosers();
@@ -2732,19 +3753,6 @@ void PieNoonGame::Run() {
         // Update audio engine state.
         audio_engine_.AdvanceFrame(world_time);
 
-        // Issue draw calls for the 'scene'.
-        if (state_ != kMultiscreenClient) {
-          // Populate 'scene' from the game state--all the positions,
-          // orientations, and renderable-ids (which specify materials) of the
-          // characters and props. Also specify the camera matrix.
-          game_state_.PopulateScene(&scene_);
-
-          // Issue draw calls for the 'scene'.
-          Render(scene_);
-        } else {
-          Render2DElements(scene_, mat4::Identity());
-        }
-
         // Output debug information.
         if (config.print_character_states()) {
           DebugPrintCharacterStates();
@@ -2752,9 +3760,17 @@ void PieNoonGame::Run() {
         if (config.print_pie_states()) {
           DebugPrintPieStates();
         }
+        if (config.print_render_stats()) {
+          DebugPrintRenderStats(world_time);
+        }
         if (config.allow_camera_movement()) {
           DebugCamera();
         }
+#ifdef PIE_NOON_USES_GOOGLE_PLAY_GAMES
+        if (config.print_network_stats()) {
+          DebugPrintNetworkStats(world_time);
+        }
+#endif
 
         // Remember the real-world time from this frame.
         prev_world_time_ = world_time;
@@ -2829,6 +3845,7 @@ void PieNoonGame::Run() {
 
         if (UpdatePieNoonStateAndTransition() == kFinished) {
           game_state_.Reset(GameState::kNoAnalytics);
+          DiscardScenes();
         }
         break;
 
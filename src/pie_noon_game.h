@@ -20,20 +20,29 @@
 #endif  // __ANDROID__
 
 #include "ai_controller.h"
+#include "ai_scheduler.h"
 #include "cardboard_controller.h"
+#include "client_snapshot_buffer.h"
+#include "frustum_culler.h"
 #include "fplbase/asset_manager.h"
 #include "fplbase/input.h"
 #include "fplbase/renderer.h"
 #include "full_screen_fader.h"
 #include "game_state.h"
 #include "gui_menu.h"
+#include "job_thread.h"
+#include "lookahead_ai_controller.h"
 #include "multiplayer_controller.h"
 #include "multiplayer_director.h"
 #include "pindrop/pindrop.h"
 #include "player_controller.h"
 #include "scene_description.h"
+#include "shadow_batch.h"
+#include "static_layer.h"
 #include "touchscreen_button.h"
 #include "touchscreen_controller.h"
+#include "utility_ai_controller.h"
+#include "worker_pool.h"
 
 #ifdef ANDROID_GAMEPAD
 #include "gamepad_controller.h"
@@ -46,6 +55,7 @@
 namespace fpl {
 namespace pie_noon {
 
+struct AtlasEntry;
 struct Config;
 class CharacterStateMachine;
 struct RenderingAssets;
@@ -63,6 +73,25 @@ enum PieNoonState {
   kMultiscreenClient,
 };
 
+// One side of a cardboard cutout, or of a popsicle stick: the material to
+// draw the shared unit quad with, and how to place and texture it.
+struct CardboardQuad {
+  CardboardQuad() : material(nullptr), palette(-1) {}
+
+  // nullptr if there's nothing to draw.
+  fplbase::Material* material;
+
+  // Bottom center of the quad, and its width and height, in object space.
+  mathfu::vec3_packed offset;
+  mathfu::vec2_packed size;
+
+  // Texture coordinates of the top left (xy) and bottom right (zw) corners.
+  mathfu::vec4_packed texture_rect;
+
+  // Palette to recolor the material's art with, or -1 to draw it as is.
+  int palette;
+};
+
 class PieNoonGame {
  public:
   PieNoonGame();
@@ -89,29 +118,58 @@ class PieNoonGame {
 #endif
   bool InitializeGpgIds();
   bool InitializeRenderer();
-  fplbase::Mesh* CreateVerticalQuadMesh(
-      const flatbuffers::String* material_name, const vec3& offset,
-      const vec2& pixel_bounds, float pixel_to_world_scale);
+  const AtlasEntry* FindAtlasEntry(const char* material_name) const;
+  CardboardQuad CreateCardboardQuad(const flatbuffers::String* material_name,
+                                    const vec3& offset,
+                                    const vec2& pixel_bounds,
+                                    float pixel_to_world_scale);
   bool InitializeRenderingAssets();
+  void InitializePalettes();
+  void InitializeRenderableBounds();
+  void UpdateCullingSpheres(const SceneDescription& scene);
   bool InitializeGameState();
-  void RenderCardboard(const SceneDescription& scene,
-                       const mat4& camera_transform);
+  int RenderCardboard(const SceneDescription& scene,
+                      const std::vector<int>& indices);
+  int RenderCardboardQuad(const CardboardQuad& quad, fplbase::Shader* shader,
+                          const int* views, const mat4* mvps, int num_views);
+  void SetSceneViewport(int view);
+  void DiscardScenes();
+  void SetViewTransform(fplbase::Shader* shader, const mat4& mvp);
   void Render(const SceneDescription& scene);
   void RenderForDefault(const SceneDescription& scene);
   void RenderForCardboard(const SceneDescription& scene);
-  void RenderScene(const SceneDescription& scene,
-                   const mat4& additional_camera_changes,
-                   const vec2i& resolution);
+  vec2 GroundPlaneSize() const;
+  void RenderGround();
+  void UpdateShadowBatch(const SceneDescription& scene,
+                         const std::vector<int>& indices, ShadowBatch* batch);
+  void RenderShadowBatch(const ShadowBatch& batch,
+                         const vec4& world_scale_bias);
+  bool RenderStaticLayer(const SceneDescription& scene,
+                         const mat4& camera_transform, const vec2i& resolution,
+                         const vec4& world_scale_bias);
+  mat4 CameraTransform(const SceneDescription& scene,
+                       const mat4& additional_camera_changes,
+                       const vec2i& resolution) const;
+  int RenderScene(const SceneDescription& scene,
+                  const mat4& additional_camera_changes,
+                  const vec2i& resolution);
+  int Render3DElements(const SceneDescription& scene, const vec2i& resolution,
+                       int num_views);
   void Render2DElements(const SceneDescription& scene,
                         const mat4& additional_camera_changes);
   void CorrectCardboardCamera(mat4& cardboard_camera);
   void DebugPrintCharacterStates();
   void DebugPrintPieStates();
+  void DebugPrintRenderStats(WorldTime world_time);
   void DebugCamera();
+#ifdef PIE_NOON_USES_GOOGLE_PLAY_GAMES
+  void DebugPrintNetworkStats(WorldTime world_time);
+  void RenderNetworkOverlay();
+#endif
   const Config& GetConfig() const;
   const Config& GetCardboardConfig() const;
   const CharacterStateMachineDef* GetStateMachine() const;
-  fplbase::Mesh* GetCardboardFront(int renderable_id, int variant);
+  const CardboardQuad& GetCardboardFront(int renderable_id, int variant);
   PieNoonState UpdatePieNoonState();
   void TransitionToPieNoonState(PieNoonState next_state);
   PieNoonState UpdatePieNoonStateAndTransition();
@@ -131,6 +189,7 @@ class PieNoonGame {
   PieNoonState HandleMenuButtons(WorldTime time);
   // void HandleMenuButton(Controller* controller, TouchscreenButton* button);
   void UpdateControllers(WorldTime delta_time);
+  void AdvanceGameState(WorldTime delta_time);
   void UpdateTouchButtons(WorldTime delta_time);
 
   pindrop::Channel PlayStinger();
@@ -146,7 +205,14 @@ class PieNoonGame {
                               fplbase::Material* material);
 
   void ProcessMultiplayerMessages();
-  void ProcessPlayerStatusMessage(const multiplayer::PlayerStatus&);
+  // If 'apply_now' is false the status is buffered and shown a little later,
+  // blended with its neighbours, by UpdateMultiscreenClientStatus().
+  void ProcessPlayerStatusMessage(const multiplayer::PlayerStatus&,
+                                  bool apply_now);
+  void ReconcileMultiscreenCommand(const multiplayer::PlayerStatus& status);
+  void UpdateMultiscreenClientStatus(WorldTime world_time);
+  void ApplyMultiscreenStatus(const std::vector<float>& health,
+                              const std::vector<uint8_t>& splats, bool force);
 
   // returns true if a new splat was displayed
   bool ShowMultiscreenSplat(int splat_num);
@@ -184,6 +250,10 @@ class PieNoonGame {
   std::string cardboard_config_source_;
 #endif
 
+  // Hold the texture atlas manifest binary data. Empty when the assets were
+  // built without an atlas.
+  std::string atlas_source_;
+
   // Report touches, button presses, keyboard presses.
   fplbase::InputSystem input_;
 
@@ -196,30 +266,178 @@ class PieNoonGame {
   // Manage ownership and playing of audio assets.
   pindrop::AudioEngine audio_engine_;
 
-  // Map RenderableId to rendering mesh.
-  std::vector<fplbase::Mesh*> cardboard_fronts_[RenderableId_Count];
-  fplbase::Mesh* cardboard_backs_[RenderableId_Count];
+  // A quad one unit wide and high, standing on the origin. Every cardboard
+  // cutout and popsicle stick is drawn with it, placed and textured by the
+  // uniforms of its CardboardQuad.
+  fplbase::Mesh* quad_mesh_;
 
-  // Rendering mesh for front and back of the stick that props cardboard.
-  fplbase::Mesh* stick_front_;
-  fplbase::Mesh* stick_back_;
+  // The atlas' palettes, for recoloring character variants, as a GL texture.
+  // See InitializePalettes(). Zero if there are none.
+  unsigned int palette_texture_;
+  int num_palettes_;
+
+  // Map RenderableId to the quads to draw it with.
+  std::vector<CardboardQuad> cardboard_fronts_[RenderableId_Count];
+  CardboardQuad cardboard_backs_[RenderableId_Count];
+
+  // Front and back of the stick that props cardboard.
+  CardboardQuad stick_front_;
+  CardboardQuad stick_back_;
 
   // Shaders we use.
   fplbase::Shader* shader_cardboard;
   fplbase::Shader* shader_lit_textured_normal_;
   fplbase::Shader* shader_simple_shadow_;
   fplbase::Shader* shader_textured_;
+  // shader_textured_, for drawing quad_mesh_.
+  fplbase::Shader* shader_textured_quad_;
   fplbase::Shader* shader_grayscale_;
+  fplbase::Shader* shader_color_;
 
   // Shadow material.
   fplbase::Material* shadow_mat_;
 
+  // A sphere around everything drawn for each RenderableId, in object space.
+  // The center is in xyz, the radius in w.
+  mathfu::vec4_packed renderable_bounds_[RenderableId_Count];
+
+  // Spheres around each of the scene's renderables, and around each of them
+  // together with its shadow, for this frame. Indexed like the renderables.
+  FrustumCuller culler_;
+  FrustumCuller shadow_culler_;
+  CullingStats culling_stats_;
+
+  // A camera that the 3D part of the scene is drawn through.
+  struct SceneView {
+    mat4 camera_transform;
+    // Where on screen it goes. Unused if there's only one view.
+    int viewport[4];
+    // Which of the scene's renderables, and their shadows, it might see.
+    std::vector<uint8_t> visible;
+    std::vector<uint8_t> shadow_visible;
+  };
+
+  // One view for the whole screen, or one per eye in Cardboard. The 3D
+  // elements are drawn through all of them in a single pass, so that each
+  // item is set up once however many views there are.
+  static const int kMaxSceneViews = 2;
+  SceneView scene_views_[kMaxSceneViews];
+  int num_scene_views_;
+
+  // Shadows that any of the views might see.
+  std::vector<uint8_t> shadow_visible_;
+
+  // The shadows of the scene's renderables that are drawn every frame, and
+  // scratch space for collecting shadow casters.
+  ShadowBatch shadow_batch_;
+  std::vector<ShadowCaster> shadow_casters_;
+
+  // The ground, the static renderables behind everything else, and the
+  // shadows of all static renderables. See RenderStaticLayer().
+  StaticLayer static_layer_;
+  ShadowBatch static_shadow_batch_;
+
+  // A static renderable, as it was when the layer was last drawn.
+  struct StaticLayerItem {
+    bool SameAs(const StaticLayerItem& rhs) const {
+      return id == rhs.id && variant == rhs.variant &&
+             in_layer == rhs.in_layer &&
+             memcmp(&color, &rhs.color, sizeof(color)) == 0 &&
+             memcmp(world_matrix, rhs.world_matrix, sizeof(world_matrix)) == 0;
+    }
+
+    uint16_t id;
+    uint16_t variant;
+    bool in_layer;
+    float world_matrix[16];
+    mathfu::vec4_packed color;
+  };
+  std::vector<StaticLayerItem> static_layer_items_;
+  float static_layer_camera_[16];
+  vec2i static_layer_resolution_;
+  mathfu::vec3_packed static_layer_light_;
+
+  // How far from the camera a static renderable reaches. 'nearest' is
+  // negative for renderables that lie flat on the ground.
+  struct StaticLayerDepth {
+    int index;
+    float nearest;
+    float farthest;
+  };
+  std::vector<StaticLayerDepth> static_layer_depths_;
+
+  // What drawing the layer's contents directly would cost, and what drawing
+  // the layer instead has saved since DebugPrintRenderStats() last ran.
+  StaticLayerCost static_layer_cost_;
+  StaticLayerStats static_layer_stats_;
+  WorldTime debug_render_stats_time_;
+
+  // How long, in microseconds, from reading the head pose in Cardboard to
+  // finishing submitting the frame drawn with it. Summed since
+  // DebugPrintRenderStats() last ran.
+  struct HeadPoseLatencyStats {
+    HeadPoseLatencyStats()
+        : frames(0),
+          input_to_submit(0),
+          latched_to_submit(0),
+          max_input_to_submit(0),
+          max_latched_to_submit(0) {}
+    int frames;
+    // From the head pose read at the start of the frame.
+    int64_t input_to_submit;
+    // From the head pose actually drawn with; the same as the above unless
+    // late_latch_head_pose is set.
+    int64_t latched_to_submit;
+    int64_t max_input_to_submit;
+    int64_t max_latched_to_submit;
+  };
+  HeadPoseLatencyStats head_pose_latency_stats_;
+
+  // What drawing the scene for both eyes in Cardboard cost, summed since
+  // DebugPrintRenderStats() last ran. Indexed by whether single_pass_stereo
+  // was set, so the two paths can be compared.
+  struct StereoStats {
+    StereoStats() : frames(0), draws(0), cpu_time(0) {}
+    int frames;
+    // Draw calls for the 3D elements.
+    int draws;
+    // Microseconds spent submitting the frame, 2D elements included.
+    int64_t cpu_time;
+  };
+  StereoStats stereo_stats_[2];
+
+  // When input, and with it the head pose, was read for this frame.
+  int64_t frame_input_time_;
+
+  // Indices into the scene's renderables, split up by RenderScene().
+  std::vector<int> live_renderables_;
+  std::vector<int> layer_renderables_;
+  std::vector<int> static_renderables_;
+  std::vector<int> dynamic_renderables_;
+
   // Hold state machine binary data.
   std::string state_machine_source_;
 
+  // Threads that share out per-frame work, such as updating particles.
+  WorkerPool worker_pool_;
+
+  // Updates game_state_ and fills in the next scene, with
+  // pipelined_simulation, while the main thread draws the last one.
+  JobThread simulation_thread_;
+
   // Hold characters, pies, camera state.
   GameState game_state_;
 
+  // Works out moves for the lookahead AIs on its own threads.
+  RolloutPlanner rollout_planner_;
+
+  // Runs the AI controllers when they have something to do.
+  AiScheduler ai_scheduler_;
+
+  // The game as it was before the AIs ran this frame, for the lookahead
+  // AIs to plan from.
+  GameStateSnapshot ai_frame_snapshot_;
+
   // Map containing every active controller, referenced by a unique,
   // unchanging ID.
   std::vector<std::unique_ptr<Controller>> active_controllers_;
@@ -238,10 +456,22 @@ class PieNoonGame {
   // Animation for the multiscreen splats that appear.
   float multiscreen_splat_param;
   float multiscreen_splat_param_speed;
+  // On the client, the last few player statuses received from the host.
+  ClientSnapshotBuffer multiscreen_snapshots_;
+  // On the client, the splats (bitmask) on our screen right now.
+  uint8_t multiscreen_displayed_splats_;
+  // On the client, the sequence number of the last PlayerCommand we sent.
+  // Never reset, so the host can't confuse a new game's commands with old
+  // ones.
+  uint16_t multiscreen_command_sequence_;
 
   // Description of the scene to be rendered. Isolates gameplay and rendering
-  // code with a type-light structure. Recreated every frame.
-  SceneDescription scene_;
+  // code with a type-light structure. Recreated every frame. Double buffered,
+  // so that the simulation thread can fill one in while the other is drawn.
+  static const int kNumSceneBuffers = 2;
+  SceneDescription scenes_[kNumSceneBuffers];
+  // The scene to draw; the latest one filled in.
+  int scene_index_;
 
   // World time of previous update. We use this to calculate the delta_time
   // of the current update. This value is tied to the real-world clock.
@@ -254,6 +484,9 @@ class PieNoonGame {
   std::vector<int> debug_previous_states_;
   std::vector<motive::Angle> debug_previous_angles_;
 
+  // Debug data. When we last printed the network stats.
+  WorldTime debug_network_stats_time_;
+
   TouchscreenController* touch_controller_;
   GuiMenu gui_menu_;
 
@@ -0,0 +1,162 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include <math.h>
+
+#include "character.h"
+#include "pie_trajectory.h"
+
+using mathfu::vec3;
+using mathfu::mat4;
+using motive::kTwoPi;
+
+namespace fpl {
+namespace pie_noon {
+
+// The columns of PieTrajectoryBatch::values_.
+enum PieColumn {
+  // Launch parameters, filled in by Rebuild().
+  kStartTime,
+  kFlightTime,
+  kInverseFlightTime,
+  kSourceX,
+  kSourceZ,
+  kDeltaX,
+  kDeltaZ,
+  kStartHeight,
+  kStartVelocity,
+  kHalfDeceleration,
+  kTotalRotation,
+  kCosYRotation,
+  kSinYRotation,
+  // Calculated by Evaluate().
+  kFraction,
+  kX,
+  kY,
+  kZ,
+  kCosZRotation,
+  kSinZRotation,
+  kNumPieColumns
+};
+
+void PieTrajectoryBatch::Rebuild(
+    const std::vector<std::unique_ptr<AirbornePie>>& pies) {
+  num_pies_ = pies.size();
+  values_.resize(num_pies_ * kNumPieColumns);
+  for (size_t i = 0; i < num_pies_; ++i) {
+    const AirbornePie& pie = *pies[i];
+    const float flight_time = static_cast<float>(pie.flight_time());
+    // Since deceleration is constant, and velocity at the peak is zero,
+    // the average velocity from start to peak is,
+    //       0.5(start_velocity + 0)
+    //
+    // At peak, height is average velocity times travel time, so
+    //       peak_height = 0.5(start_velocity + 0)*peak_time
+    // Which implies,
+    //    start_velocity = 2 * delta_height / peak_time
+    const float peak_time = 0.5f * flight_time;
+    const float start_velocity =
+        2.0f * (pie.peak_height() - pie.start_height()) / peak_time;
+    const vec3& source = pie.source_position();
+    const vec3& target = pie.target_position();
+
+    Column(kStartTime)[i] = static_cast<float>(pie.start_time());
+    Column(kFlightTime)[i] = flight_time;
+    Column(kInverseFlightTime)[i] = 1.0f / flight_time;
+    Column(kSourceX)[i] = source.x();
+    Column(kSourceZ)[i] = source.z();
+    Column(kDeltaX)[i] = target.x() - source.x();
+    Column(kDeltaZ)[i] = target.z() - source.z();
+    Column(kStartHeight)[i] = pie.start_height();
+    Column(kStartVelocity)[i] = start_velocity;
+    Column(kHalfDeceleration)[i] = 0.5f * start_velocity / peak_time;
+    Column(kTotalRotation)[i] = pie.rotations() * kTwoPi;
+    Column(kCosYRotation)[i] = cosf(pie.y_rotation());
+    Column(kSinYRotation)[i] = sinf(pie.y_rotation());
+  }
+}
+
+void PieTrajectoryBatch::Evaluate(
+    WorldTime time, const std::vector<std::unique_ptr<AirbornePie>>& pies) {
+  assert(pies.size() == num_pies_);
+  const size_t n = num_pies_;
+  if (n == 0) return;
+
+  // Each loop below reads and writes whole columns, so the compiler can
+  // turn it into vector instructions.
+  const float now = static_cast<float>(time);
+  const float* start_time = Column(kStartTime);
+  const float* flight_time = Column(kFlightTime);
+  float* elapsed = Column(kFraction);
+  for (size_t i = 0; i < n; ++i) {
+    elapsed[i] = mathfu::Clamp(now - start_time[i], 0.0f, flight_time[i]);
+  }
+
+  // Height follows from the constant deceleration. Uses the elapsed time,
+  // so must come before it's turned into a fraction of the flight.
+  const float* start_height = Column(kStartHeight);
+  const float* start_velocity = Column(kStartVelocity);
+  const float* half_deceleration = Column(kHalfDeceleration);
+  float* y = Column(kY);
+  for (size_t i = 0; i < n; ++i) {
+    const float t = elapsed[i];
+    y[i] = start_height[i] + (start_velocity[i] - half_deceleration[i] * t) * t;
+  }
+
+  const float* inverse_flight_time = Column(kInverseFlightTime);
+  float* fraction = elapsed;
+  for (size_t i = 0; i < n; ++i) {
+    fraction[i] = elapsed[i] * inverse_flight_time[i];
+  }
+
+  // x and z move at constant speed from source to target.
+  const float* source_x = Column(kSourceX);
+  const float* source_z = Column(kSourceZ);
+  const float* delta_x = Column(kDeltaX);
+  const float* delta_z = Column(kDeltaZ);
+  float* x = Column(kX);
+  float* z = Column(kZ);
+  for (size_t i = 0; i < n; ++i) {
+    x[i] = source_x[i] + delta_x[i] * fraction[i];
+    z[i] = source_z[i] + delta_z[i] * fraction[i];
+  }
+
+  // The pie rotates top to bottom a fixed number of times, at a constant
+  // speed.
+  const float* total_rotation = Column(kTotalRotation);
+  float* cos_z = Column(kCosZRotation);
+  float* sin_z = Column(kSinZRotation);
+  for (size_t i = 0; i < n; ++i) {
+    const float angle = total_rotation[i] * fraction[i];
+    cos_z[i] = cosf(angle);
+    sin_z[i] = sinf(angle);
+  }
+
+  // translate(x, y, z) * rotate_about_y(y_rotation) * rotate_about_z(angle),
+  // multiplied out. mat4's constructor takes one column at a time.
+  const float* cos_y = Column(kCosYRotation);
+  const float* sin_y = Column(kSinYRotation);
+  for (size_t i = 0; i < n; ++i) {
+    pies[i]->set_matrix(mat4(cos_y[i] * cos_z[i], sin_z[i],
+                             -sin_y[i] * cos_z[i], 0.0f,
+                             -cos_y[i] * sin_z[i], cos_z[i],
+                             sin_y[i] * sin_z[i], 0.0f,
+                             sin_y[i], 0.0f, cos_y[i], 0.0f,
+                             x[i], y[i], z[i], 1.0f));
+  }
+}
+
+}  // pie_noon
+}  // fpl
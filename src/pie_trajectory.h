@@ -0,0 +1,62 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PIE_TRAJECTORY_H
+#define PIE_TRAJECTORY_H
+
+#include <memory>
+#include <vector>
+#include "common.h"
+
+namespace fpl {
+namespace pie_noon {
+
+class AirbornePie;
+
+// Works out where every airborne pie is, straight from its launch
+// parameters.
+//
+// A pie's flight is a closed-form function of time: x and z move at a
+// constant speed from source to target, y follows a parabola from the
+// start height up to the peak height and back, and the pie tumbles about
+// z at a constant rate. The parameters of all pies are kept column by
+// column, so each step of the evaluation is one loop over every pie.
+class PieTrajectoryBatch {
+ public:
+  PieTrajectoryBatch() : num_pies_(0) {}
+
+  // Copy the launch parameters of 'pies'. Call whenever pies are added or
+  // removed.
+  void Rebuild(const std::vector<std::unique_ptr<AirbornePie>>& pies);
+
+  // Calculate each pie's matrix 'time' into the game and store it in the
+  // pie. 'pies' must be the vector last passed to Rebuild().
+  void Evaluate(WorldTime time,
+                const std::vector<std::unique_ptr<AirbornePie>>& pies);
+
+ private:
+  // Start of column 'column' in values_.
+  float* Column(int column) { return &values_[column * num_pies_]; }
+
+  size_t num_pies_;
+
+  // One column of num_pies_ values for each of the inputs and outputs
+  // listed in pie_trajectory.cpp.
+  std::vector<float> values_;
+};
+
+}  // pie_noon
+}  // fpl
+
+#endif  // PIE_TRAJECTORY_H
@@ -0,0 +1,305 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include <atomic>
+#include <chrono>
+#include <limits>
+
+#include "ai_controller.h"
+#include "config_generated.h"
+#include "controller.h"
+#include "game_state.h"
+#include "headless_game.h"
+#include "rollout_planner.h"
+
+namespace fpl {
+namespace pie_noon {
+
+void ApplyLookaheadAction(const LookaheadAction& action,
+                          const Character& character, Controller* controller) {
+  switch (action.type) {
+    case LookaheadAction::kCharge:
+      break;
+    case LookaheadAction::kBlock:
+      controller->SetLogicalInputs(LogicalInputs_Deflect, true);
+      break;
+    case LookaheadAction::kThrow:
+      controller->set_target_id(action.target);
+      controller->SetLogicalInputs(LogicalInputs_TurnToTarget, true);
+      // Once the pie has gone, don't start on another.
+      if (character.pie_damage() > 0) {
+        controller->SetLogicalInputs(LogicalInputs_ThrowPie, true);
+      }
+      break;
+  }
+}
+
+// Plays like an AiController, except that it can be told to carry out a
+// LookaheadAction first. Each rollout seeds its random choices with the
+// rollout's number, so rollouts differ from each other but not from run to
+// run, whichever worker plays them.
+class RolloutController : public AiController {
+ public:
+  RolloutController() : game_state_(nullptr), script_end_(0) {}
+
+  virtual void Initialize(GameState* game_state, const Config* config,
+                          CharacterId character_id) {
+    AiController::Initialize(game_state, config, character_id);
+    game_state_ = game_state;
+    script_end_ = 0;
+  }
+
+  // Carry out 'action' until the game reaches 'end'.
+  void SetScript(const LookaheadAction& action, WorldTime end) {
+    script_ = action;
+    script_end_ = end;
+  }
+
+  virtual void AdvanceFrame(WorldTime delta_time) {
+    if (!InScript()) {
+      AiController::AdvanceFrame(delta_time);
+      return;
+    }
+    ClearAllLogicalInputs();
+    ApplyLookaheadAction(script_, *game_state_->characters()[character_id_],
+                         this);
+  }
+
+  virtual WorldTime TimeUntilInput() const {
+    return InScript() ? 0 : AiController::TimeUntilInput();
+  }
+
+ private:
+  bool InScript() const { return game_state_->time() < script_end_; }
+
+  GameState* game_state_;
+  LookaheadAction script_;
+  WorldTime script_end_;
+};
+
+// How far ahead of the average opponent 'id' is, in health and score.
+static float Value(const GameState& game_state, CharacterId id) {
+  const auto& characters = game_state.characters();
+  float opponent_total = 0.0f;
+  int num_opponents = 0;
+  for (size_t i = 0; i < characters.size(); ++i) {
+    if (static_cast<CharacterId>(i) == id) continue;
+    opponent_total +=
+        std::max(characters[i]->health(), 0) + characters[i]->score();
+    num_opponents++;
+  }
+  const Character& self = *characters[id];
+  const float own_total =
+      static_cast<float>(std::max(self.health(), 0) + self.score());
+  return num_opponents == 0 ? own_total
+                            : own_total - opponent_total / num_opponents;
+}
+
+// Play out 'action' for 'id' in 'game', from 'snapshot', with the AIs'
+// choices seeded by 'seed', and return how well it went in 'value'.
+// Returns false if the snapshot doesn't fit.
+static bool Rollout(const Config& config, const GameStateSnapshot& snapshot,
+                    CharacterId id, const LookaheadAction& action,
+                    uint32_t seed, HeadlessGame* game, float* value) {
+  if (!game->Restore(snapshot, seed)) return false;
+  const WorldTime start = game->game_state().time();
+  // Every controller in our games is a RolloutController.
+  static_cast<RolloutController*>(game->controller(id))
+      ->SetScript(action, start + config.ai_lookahead_commit_time());
+  game->PlayUntil(start + config.ai_lookahead_horizon(),
+                  config.ai_lookahead_frame_time());
+  *value = Value(game->game_state(), id);
+  return true;
+}
+
+RolloutPlanner::RolloutPlanner()
+    : config_(nullptr), next_request_(0), quit_(false) {}
+
+RolloutPlanner::~RolloutPlanner() { Shutdown(); }
+
+void RolloutPlanner::Initialize(
+    const Config* config, const CharacterStateMachineDef* state_machine_def,
+    int num_characters) {
+  Shutdown();
+  config_ = config;
+  const int num_threads = std::max(config->ai_lookahead_thread_count(), 0);
+  worker_pool_.Initialize(num_threads);
+
+  // ParallelFor() runs on the planner thread when there are no workers, so
+  // there is always at least one job.
+  const int num_jobs = std::max(num_threads, 1);
+  games_.clear();
+  for (int i = 0; i < num_jobs; ++i) {
+    std::vector<std::unique_ptr<AiController>> controllers;
+    for (int j = 0; j < num_characters; ++j) {
+      controllers.push_back(
+          std::unique_ptr<AiController>(new RolloutController()));
+    }
+    games_.push_back(std::unique_ptr<HeadlessGame>(new HeadlessGame()));
+    games_.back()->Initialize(config, state_machine_def, &controllers);
+  }
+
+  requests_.clear();
+  requests_.resize(num_characters);
+  next_request_ = 0;
+  quit_ = false;
+  planner_thread_ = std::thread(&RolloutPlanner::PlannerMain, this);
+}
+
+void RolloutPlanner::Shutdown() {
+  if (!planner_thread_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  request_ready_.notify_all();
+  planner_thread_.join();
+}
+
+void RolloutPlanner::RequestPlan(CharacterId id,
+                                 const GameStateSnapshot& snapshot) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Request& request = requests_[id];
+    request.snapshot.Assign(snapshot.data(), snapshot.size());
+    request.pending = true;
+  }
+  request_ready_.notify_one();
+}
+
+bool RolloutPlanner::TakePlan(CharacterId id, LookaheadAction* action) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Request& request = requests_[id];
+  if (!request.done) return false;
+  *action = request.result;
+  request.done = false;
+  return true;
+}
+
+void RolloutPlanner::CancelPlan(CharacterId id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Request& request = requests_[id];
+  request.pending = false;
+  request.done = false;
+  request.generation++;
+}
+
+void RolloutPlanner::PlannerMain() {
+  const CharacterId num_ids = static_cast<CharacterId>(requests_.size());
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    CharacterId id = kNoCharacter;
+    request_ready_.wait(lock, [this, num_ids, &id] {
+      if (quit_) return true;
+      for (CharacterId i = 0; i < num_ids; ++i) {
+        const CharacterId candidate = (next_request_ + i) % num_ids;
+        if (requests_[candidate].pending) {
+          id = candidate;
+          return true;
+        }
+      }
+      return false;
+    });
+    if (quit_) return;
+
+    Request& request = requests_[id];
+    request.pending = false;
+    const uint32_t generation = request.generation;
+    planning_snapshot_.Assign(request.snapshot.data(),
+                              request.snapshot.size());
+    next_request_ = (id + 1) % num_ids;
+    lock.unlock();
+
+    const LookaheadAction action = Plan(id, planning_snapshot_);
+
+    lock.lock();
+    if (request.generation != generation) continue;
+    request.result = action;
+    request.done = true;
+  }
+}
+
+LookaheadAction RolloutPlanner::Plan(CharacterId id,
+                                     const GameStateSnapshot& snapshot) {
+  const LookaheadAction charge = {LookaheadAction::kCharge, kNoCharacter};
+  HeadlessGame& first = *games_[0];
+  if (!first.Restore(snapshot)) return charge;
+
+  // Charging, blocking, or throwing at anyone still standing.
+  candidates_.clear();
+  candidates_.push_back(charge);
+  const LookaheadAction block = {LookaheadAction::kBlock, kNoCharacter};
+  candidates_.push_back(block);
+  const auto& characters = first.game_state().characters();
+  for (size_t i = 0; i < characters.size(); ++i) {
+    const CharacterId target = static_cast<CharacterId>(i);
+    if (target == id || characters[i]->health() <= 0) continue;
+    const LookaheadAction throw_pie = {LookaheadAction::kThrow, target};
+    candidates_.push_back(throw_pie);
+  }
+
+  const int num_candidates = static_cast<int>(candidates_.size());
+  const int num_jobs = static_cast<int>(games_.size());
+  value_sums_.assign(num_jobs * num_candidates, 0.0f);
+  rollout_counts_.assign(num_jobs * num_candidates, 0);
+
+  // Hand out rollouts a candidate at a time, so that they all get a fair
+  // share of the budget.
+  const int max_rollouts = config_->ai_lookahead_max_rollouts();
+  const auto deadline =
+      std::chrono::steady_clock::now() +
+      std::chrono::milliseconds(config_->ai_lookahead_time_budget());
+  std::atomic<int> next_rollout(0);
+  worker_pool_.ParallelFor(num_jobs, [&](int job) {
+    HeadlessGame* game = games_[job].get();
+    float* sums = &value_sums_[job * num_candidates];
+    int* counts = &rollout_counts_[job * num_candidates];
+    while (std::chrono::steady_clock::now() < deadline) {
+      const int rollout = next_rollout++;
+      if (rollout >= max_rollouts) break;
+      const int candidate = rollout % num_candidates;
+      float value;
+      if (!Rollout(*config_, snapshot, id, candidates_[candidate],
+                   static_cast<uint32_t>(rollout), game, &value)) {
+        break;
+      }
+      sums[candidate] += value;
+      counts[candidate]++;
+    }
+  });
+
+  // Pick the best average. Ties go to the earlier candidate, so charging
+  // wins if nothing makes a difference.
+  LookaheadAction best = charge;
+  float best_value = -std::numeric_limits<float>::max();
+  for (int c = 0; c < num_candidates; ++c) {
+    float sum = 0.0f;
+    int count = 0;
+    for (int job = 0; job < num_jobs; ++job) {
+      sum += value_sums_[job * num_candidates + c];
+      count += rollout_counts_[job * num_candidates + c];
+    }
+    if (count == 0) continue;
+    const float value = sum / count;
+    if (value > best_value) {
+      best_value = value;
+      best = candidates_[c];
+    }
+  }
+  return best;
+}
+
+}  // pie_noon
+}  // fpl
@@ -0,0 +1,138 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROLLOUT_PLANNER_H
+#define ROLLOUT_PLANNER_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "character.h"
+#include "game_state_snapshot.h"
+#include "worker_pool.h"
+
+namespace fpl {
+namespace pie_noon {
+
+class Controller;
+class HeadlessGame;
+struct Config;
+struct CharacterStateMachineDef;
+
+// Something a lookahead AI can spend a while doing.
+struct LookaheadAction {
+  enum Type {
+    kCharge,  // Do nothing, and let our pie grow.
+    kBlock,
+    kThrow  // Turn to 'target' and throw at it.
+  };
+
+  Type type;
+  CharacterId target;
+};
+
+// Set the logical inputs on 'controller' that carry out 'action' for
+// 'character'.
+void ApplyLookaheadAction(const LookaheadAction& action,
+                          const Character& character, Controller* controller);
+
+// Picks actions for lookahead AIs by trying each one out.
+//
+// Each plan starts from a snapshot of the real game. For every candidate
+// action, copies of the game are restored from the snapshot and played
+// forward headless for ai_lookahead_horizon milliseconds: the planning
+// character carries out the action for ai_lookahead_commit_time, and
+// everyone else (and then the planning character too) plays like the random
+// AiController. The action whose games end best for the planning character,
+// on average, wins.
+//
+// Planning happens on a background thread that hands the rollouts out to
+// its own WorkerPool, one copy of the game per worker, until the time
+// budget or rollout limit is used up. The game thread only copies the
+// snapshot in and the answer out.
+class RolloutPlanner {
+ public:
+  RolloutPlanner();
+  ~RolloutPlanner();
+
+  // Build the copies of the game and start the threads. 'config' and
+  // 'state_machine_def' must outlive the planner, and the motivator types
+  // must already be registered.
+  void Initialize(const Config* config,
+                  const CharacterStateMachineDef* state_machine_def,
+                  int num_characters);
+
+  // Ask for the best action for 'id' in the game saved in 'snapshot'. The
+  // snapshot is copied. Replaces any request for 'id' that hasn't started.
+  void RequestPlan(CharacterId id, const GameStateSnapshot& snapshot);
+
+  // If a plan asked for with RequestPlan() is ready, return it in 'action'
+  // and forget it.
+  bool TakePlan(CharacterId id, LookaheadAction* action);
+
+  // Forget any request for 'id', and any plan for it that is ready or still
+  // being worked out, so TakePlan() won't return it.
+  void CancelPlan(CharacterId id);
+
+ private:
+  struct Request {
+    Request() : pending(false), done(false), generation(0) {}
+
+    GameStateSnapshot snapshot;
+    bool pending;
+    bool done;
+    LookaheadAction result;
+    // Incremented by CancelPlan(), so a plan that was being worked out when
+    // it was called is thrown away.
+    uint32_t generation;
+  };
+
+  void PlannerMain();
+  void Shutdown();
+  LookaheadAction Plan(CharacterId id, const GameStateSnapshot& snapshot);
+
+  const Config* config_;
+
+  // One copy of the game per job. Only touched by the planner thread and
+  // its workers.
+  std::vector<std::unique_ptr<HeadlessGame>> games_;
+  WorkerPool worker_pool_;
+  std::thread planner_thread_;
+  GameStateSnapshot planning_snapshot_;
+  std::vector<LookaheadAction> candidates_;
+  // Indexed by job, then candidate.
+  std::vector<float> value_sums_;
+  std::vector<int> rollout_counts_;
+
+  // Everything below is protected by mutex_.
+  std::mutex mutex_;
+  // Signalled when a request comes in, or when shutting down.
+  std::condition_variable request_ready_;
+  // Indexed by CharacterId.
+  std::vector<Request> requests_;
+  // Where to start looking for the next pending request, so every
+  // character gets its turn.
+  CharacterId next_request_;
+  bool quit_;
+
+  RolloutPlanner(const RolloutPlanner&);
+  void operator=(const RolloutPlanner&);
+};
+
+}  // pie_noon
+}  // fpl
+
+#endif  // ROLLOUT_PLANNER_H
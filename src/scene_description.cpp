@@ -0,0 +1,131 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "scene_description.h"
+
+using mathfu::mat4;
+using mathfu::vec3;
+
+namespace fpl {
+
+// Elements of the affine part of a matrix, kept a column at a time. Inputs
+// are the top three rows of the world matrix; outputs are the camera and
+// light in object space.
+enum ObjectSpaceColumn {
+  kIn00, kIn10, kIn20,
+  kIn01, kIn11, kIn21,
+  kIn02, kIn12, kIn22,
+  kIn03, kIn13, kIn23,
+  kCameraX, kCameraY, kCameraZ,
+  kLightX, kLightY, kLightZ,
+  kNumObjectSpaceColumns
+};
+
+// True if the bottom row of 'm' is (0, 0, 0, 1).
+static bool IsAffine(const mat4& m) {
+  return m(3, 0) == 0.0f && m(3, 1) == 0.0f && m(3, 2) == 0.0f &&
+         m(3, 3) == 1.0f;
+}
+
+void SceneDescription::UpdateObjectSpace(const vec3& camera_position) {
+  const size_t n = renderables_.size();
+  if (n == 0) return;
+  const vec3 light = lights_.empty() ? mathfu::kZeros3f : *lights_[0];
+
+  object_space_columns_.resize(kNumObjectSpaceColumns * n);
+  float* columns = &object_space_columns_[0];
+  auto Column = [columns, n](ObjectSpaceColumn c) { return columns + c * n; };
+
+  for (size_t i = 0; i < n; ++i) {
+    const mat4& m = renderables_[i]->world_matrix();
+    for (int col = 0; col < 4; ++col) {
+      for (int row = 0; row < 3; ++row) {
+        Column(static_cast<ObjectSpaceColumn>(kIn00 + col * 3 + row))[i] =
+            m(row, col);
+      }
+    }
+  }
+
+  // The inverse of [A t] is [inverse(A) -inverse(A)t]. The rows of
+  // inverse(A) are cross products of A's columns, divided by its
+  // determinant. This loop reads whole columns and has no branches, so the
+  // compiler can turn it into vector instructions.
+  const float* a00 = Column(kIn00);
+  const float* a10 = Column(kIn10);
+  const float* a20 = Column(kIn20);
+  const float* a01 = Column(kIn01);
+  const float* a11 = Column(kIn11);
+  const float* a21 = Column(kIn21);
+  const float* a02 = Column(kIn02);
+  const float* a12 = Column(kIn12);
+  const float* a22 = Column(kIn22);
+  const float* t0 = Column(kIn03);
+  const float* t1 = Column(kIn13);
+  const float* t2 = Column(kIn23);
+  float* camera_x = Column(kCameraX);
+  float* camera_y = Column(kCameraY);
+  float* camera_z = Column(kCameraZ);
+  float* light_x = Column(kLightX);
+  float* light_y = Column(kLightY);
+  float* light_z = Column(kLightZ);
+  for (size_t i = 0; i < n; ++i) {
+    // Row 0 is column 1 cross column 2, and so on.
+    const float c00 = a11[i] * a22[i] - a21[i] * a12[i];
+    const float c01 = a21[i] * a02[i] - a01[i] * a22[i];
+    const float c02 = a01[i] * a12[i] - a11[i] * a02[i];
+    const float c10 = a12[i] * a20[i] - a22[i] * a10[i];
+    const float c11 = a22[i] * a00[i] - a02[i] * a20[i];
+    const float c12 = a02[i] * a10[i] - a12[i] * a00[i];
+    const float c20 = a10[i] * a21[i] - a20[i] * a11[i];
+    const float c21 = a20[i] * a01[i] - a00[i] * a21[i];
+    const float c22 = a00[i] * a11[i] - a10[i] * a01[i];
+    const float det = a00[i] * c00 + a10[i] * c01 + a20[i] * c02;
+    const float inv_det = det != 0.0f ? 1.0f / det : 0.0f;
+    const float b00 = c00 * inv_det;
+    const float b01 = c01 * inv_det;
+    const float b02 = c02 * inv_det;
+    const float b10 = c10 * inv_det;
+    const float b11 = c11 * inv_det;
+    const float b12 = c12 * inv_det;
+    const float b20 = c20 * inv_det;
+    const float b21 = c21 * inv_det;
+    const float b22 = c22 * inv_det;
+    const float u0 = -(b00 * t0[i] + b01 * t1[i] + b02 * t2[i]);
+    const float u1 = -(b10 * t0[i] + b11 * t1[i] + b12 * t2[i]);
+    const float u2 = -(b20 * t0[i] + b21 * t1[i] + b22 * t2[i]);
+    camera_x[i] = b00 * camera_position.x() + b01 * camera_position.y() +
+                  b02 * camera_position.z() + u0;
+    camera_y[i] = b10 * camera_position.x() + b11 * camera_position.y() +
+                  b12 * camera_position.z() + u1;
+    camera_z[i] = b20 * camera_position.x() + b21 * camera_position.y() +
+                  b22 * camera_position.z() + u2;
+    light_x[i] = b00 * light.x() + b01 * light.y() + b02 * light.z() + u0;
+    light_y[i] = b10 * light.x() + b11 * light.y() + b12 * light.z() + u1;
+    light_z[i] = b20 * light.x() + b21 * light.y() + b22 * light.z() + u2;
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    Renderable& renderable = *renderables_[i];
+    if (!IsAffine(renderable.world_matrix())) {
+      const mat4 inverse = renderable.world_matrix().Inverse();
+      renderable.set_object_space(inverse * camera_position, inverse * light);
+      continue;
+    }
+    renderable.set_object_space(vec3(camera_x[i], camera_y[i], camera_z[i]),
+                                vec3(light_x[i], light_y[i], light_z[i]));
+  }
+}
+
+}  // namespace fpl
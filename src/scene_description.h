@@ -28,7 +28,10 @@ class Renderable {
       : id_(id),
         variant_(variant),
         world_matrix_(world_matrix),
-        color_(color) {}
+        object_camera_pos_(mathfu::kZeros3f),
+        object_light_pos_(mathfu::kZeros3f),
+        color_(color),
+        is_static_(false) {}
 
   uint16_t id() const { return id_; }
   void set_id(uint16_t id) { id_ = id; }
@@ -39,9 +42,22 @@ class Renderable {
   const mathfu::mat4& world_matrix() const { return world_matrix_; }
   void set_world_matrix(const mathfu::mat4& mat) { world_matrix_ = mat; }
 
+  // The camera and first light positions in the item's own space. Only
+  // valid after SceneDescription::UpdateObjectSpace().
+  const mathfu::vec3& object_camera_pos() const { return object_camera_pos_; }
+  const mathfu::vec3& object_light_pos() const { return object_light_pos_; }
+  void set_object_space(const mathfu::vec3& camera_pos,
+                        const mathfu::vec3& light_pos) {
+    object_camera_pos_ = camera_pos;
+    object_light_pos_ = light_pos;
+  }
+
   const mathfu::vec4& color() const { return color_; }
   void set_color(const mathfu::vec4& c) { color_ = c; }
 
+  bool is_static() const { return is_static_; }
+  void set_is_static(bool is_static) { is_static_ = is_static; }
+
  private:
   // Unique identifier for item to be rendered.
   // See renderable_id in timeline_generated.h.
@@ -54,7 +70,16 @@ class Renderable {
   // Position and orientation of item.
   mathfu::mat4 world_matrix_;
 
+  // Cached by SceneDescription::UpdateObjectSpace(), so that rendering
+  // doesn't have to invert world_matrix_ every frame, for every camera.
+  mathfu::vec3 object_camera_pos_;
+  mathfu::vec3 object_light_pos_;
+
   mathfu::vec4 color_;
+
+  // True if the item hasn't moved, and won't until something disturbs it.
+  // Static items can be drawn once and reused from frame to frame.
+  bool is_static_;
 };
 
 class SceneDescription {
@@ -80,6 +105,12 @@ class SceneDescription {
     lights_.clear();
   }
 
+  // Work out where 'camera_position' and the first light are relative to
+  // every renderable. Call once all renderables and lights have been added.
+  // World matrices are expected to be affine; any that aren't are inverted
+  // the slow way.
+  void UpdateObjectSpace(const mathfu::vec3& camera_position);
+
  private:
   // The camera position, orientation, fov.
   mathfu::mat4 camera_;
@@ -89,6 +120,9 @@ class SceneDescription {
 
   // Array of positions for where to place point lights.
   std::vector<std::unique_ptr<mathfu::vec3>> lights_;
+
+  // Working space for UpdateObjectSpace(), kept to avoid reallocating it.
+  std::vector<float> object_space_columns_;
 };
 
 }  // namespace fpl
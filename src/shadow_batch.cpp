@@ -0,0 +1,154 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/mesh.h"
+#include "shadow_batch.h"
+
+using mathfu::vec2;
+using mathfu::vec3;
+using mathfu::vec4;
+
+namespace fpl {
+namespace pie_noon {
+
+// Corners of a billboard, in the order of the quad meshes in
+// pie_noon_game.cpp: bottom left, bottom right, top left, top right. xy is
+// the position on a billboard of unit size, zw the texture coordinate.
+static const float kCorners[4][4] = {
+    {-0.5f, 0.0f, 0.0f, 1.0f},
+    {0.5f, 0.0f, 1.0f, 1.0f},
+    {-0.5f, 1.0f, 0.0f, 0.0f},
+    {0.5f, 1.0f, 1.0f, 0.0f},
+};
+static const unsigned short kQuadIndices[] = {0, 1, 2, 2, 1, 3};
+static const int kQuadNumIndices = 6;
+
+static const fplbase::Attribute kShadowFormat[] = {
+    fplbase::kPosition3f, fplbase::kTexCoord2f, fplbase::kTangent4f,
+    fplbase::kEND};
+
+bool ShadowBatch::SameCaster(const ShadowCaster& a, const ShadowCaster& b) {
+  // The rest of the caster follows from its art.
+  return a.id == b.id && a.variant == b.variant &&
+         memcmp(a.world_matrix, b.world_matrix, sizeof(a.world_matrix)) == 0;
+}
+
+// Projects the corners of 'caster' onto the ground, along the rays from the
+// light through them.
+void ShadowBatch::Project(const ShadowCaster& caster, Vertex* vertices) const {
+  const float* m = caster.world_matrix;
+  const vec3 offset(caster.offset);
+  const vec2 size(caster.size);
+  const vec4 rect(caster.texture_rect);
+  const vec3 light(light_pos_);
+  for (int i = 0; i < 4; ++i) {
+    const vec3 local(kCorners[i][0] * size.x() + offset.x(),
+                     kCorners[i][1] * size.y() + offset.y(), offset.z());
+    const vec3 world(
+        m[0] * local.x() + m[4] * local.y() + m[8] * local.z() + m[12],
+        m[1] * local.x() + m[5] * local.y() + m[9] * local.z() + m[13],
+        m[2] * local.x() + m[6] * local.y() + m[10] * local.z() + m[14]);
+
+    // Corners level with or above the light cast no shadow; leave them
+    // where they are.
+    const vec3 to_corner = world - light;
+    vertices[i].pos = to_corner.y() < 0.0f
+                          ? world + to_corner * (world.y() / -to_corner.y())
+                          : world;
+    vertices[i].tc = vec2(
+        mathfu::Lerp(rect.x(), rect.z(), kCorners[i][2]),
+        mathfu::Lerp(rect.y(), rect.w(), kCorners[i][3]));
+    vertices[i].texture_rect = rect;
+  }
+}
+
+void ShadowBatch::Update(const std::vector<ShadowCaster>& casters,
+                         const vec3& light_pos) {
+  // Moving the light moves every shadow.
+  const vec3 old_light_pos(light_pos_);
+  const bool light_moved = old_light_pos.x() != light_pos.x() ||
+                           old_light_pos.y() != light_pos.y() ||
+                           old_light_pos.z() != light_pos.z();
+  light_pos_ = light_pos;
+
+  bool changed = light_moved || casters.size() != shadows_.size();
+  shadows_.resize(casters.size());
+  for (size_t i = 0; i < casters.size(); ++i) {
+    Shadow& shadow = shadows_[i];
+    if (!light_moved && SameCaster(shadow.caster, casters[i])) continue;
+    shadow.caster = casters[i];
+    Project(shadow.caster, shadow.vertices);
+    changed = true;
+  }
+  if (!changed) return;
+
+  // Group the quads by texture. The order they're drawn in doesn't matter:
+  // the shadows all blend in the same ground color.
+  std::vector<const Shadow*> order(shadows_.size());
+  for (size_t i = 0; i < shadows_.size(); ++i) order[i] = &shadows_[i];
+  std::stable_sort(order.begin(), order.end(),
+                   [](const Shadow* a, const Shadow* b) {
+    return a->caster.texture < b->caster.texture;
+  });
+
+  vertices_.clear();
+  indices_.clear();
+  draws_.clear();
+  for (auto it = order.begin(); it != order.end(); ++it) {
+    const Shadow& shadow = **it;
+    if (shadow.caster.texture == nullptr) continue;
+    if (draws_.empty() || draws_.back().texture != shadow.caster.texture) {
+      const Draw draw = {shadow.caster.texture,
+                         static_cast<int>(indices_.size()), 0};
+      draws_.push_back(draw);
+    }
+    const unsigned short first_vertex =
+        static_cast<unsigned short>(vertices_.size());
+    vertices_.insert(vertices_.end(), shadow.vertices, shadow.vertices + 4);
+    for (int i = 0; i < kQuadNumIndices; ++i) {
+      indices_.push_back(
+          static_cast<unsigned short>(first_vertex + kQuadIndices[i]));
+    }
+    draws_.back().num_indices += kQuadNumIndices;
+  }
+}
+
+float ShadowBatch::FarthestDepth(const mathfu::mat4& camera_transform) const {
+  float farthest = 0.0f;
+  for (auto it = vertices_.begin(); it != vertices_.end(); ++it) {
+    const vec4 clip = camera_transform * vec4(vec3(it->pos), 1.0f);
+    farthest = std::max(farthest, clip.w());
+  }
+  return farthest;
+}
+
+void ShadowBatch::Render(fplbase::Renderer& renderer,
+                         fplbase::Material* material, int num_views,
+                         const std::function<void(int)>& set_view) const {
+  for (auto it = draws_.begin(); it != draws_.end(); ++it) {
+    material->textures()[0] = it->texture;
+    material->Set(renderer);
+    for (int view = 0; view < num_views; ++view) {
+      if (set_view) set_view(view);
+      fplbase::Mesh::RenderArray(
+          fplbase::Mesh::kTriangles, it->num_indices, kShadowFormat,
+          sizeof(Vertex), reinterpret_cast<const char*>(&vertices_[0]),
+          &indices_[it->first_index]);
+    }
+  }
+}
+
+}  // pie_noon
+}  // fpl
@@ -0,0 +1,123 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHADOW_BATCH_H
+#define SHADOW_BATCH_H
+
+#include <functional>
+#include <vector>
+#include "fplbase/material.h"
+#include "fplbase/renderer.h"
+#include "mathfu/glsl_mappings.h"
+
+namespace fpl {
+namespace pie_noon {
+
+// A billboard whose shadow should be drawn this frame.
+struct ShadowCaster {
+  // Identify the billboard's art. Casters with the same art and world matrix
+  // as last frame cast the same shadow.
+  uint16_t id;
+  uint16_t variant;
+
+  // Texture holding the art, and where on it the art is. The top left corner
+  // is in xy, the bottom right in zw.
+  fplbase::Texture* texture;
+  mathfu::vec4_packed texture_rect;
+
+  // Bottom center and size of the billboard, in object space.
+  mathfu::vec3_packed offset;
+  mathfu::vec2_packed size;
+
+  // Object to world space transform, column major.
+  float world_matrix[16];
+};
+
+// Draws the shadows of many billboards with as few draw calls as possible.
+//
+// Each billboard is projected onto the ground from the light on the CPU, and
+// the projected quads of all billboards that share a texture are drawn with
+// one call. With the cardboard art packed into atlases, that's usually a
+// single draw for the whole scene.
+//
+// Most shadow casters, the props, don't move. Their projected quads are kept
+// from one Update() to the next, so only the casters that moved are projected
+// again, and the batch isn't rebuilt at all when nothing did.
+class ShadowBatch {
+ public:
+  ShadowBatch() : light_pos_(0.0f, 0.0f, 0.0f) {}
+
+  // Project the shadows of 'casters' from 'light_pos'. The casters should
+  // come in the same order every frame, for their shadows to be reused.
+  void Update(const std::vector<ShadowCaster>& casters,
+              const mathfu::vec3& light_pos);
+
+  // Draw the shadows projected by the last Update(), with the shader that is
+  // currently set. 'material' supplies the ground's shadow color as its
+  // second texture; its first texture is replaced with that of the casters.
+  //
+  // To draw into several views without rebinding each texture for every
+  // one, pass 'num_views' and a 'set_view' that sets up the view it's given
+  // the index of. It's called before each draw.
+  void Render(fplbase::Renderer& renderer, fplbase::Material* material,
+              int num_views = 1,
+              const std::function<void(int)>& set_view = nullptr) const;
+
+  // Number of draw calls Render() makes, per view.
+  int num_draws() const { return static_cast<int>(draws_.size()); }
+
+  // How far the farthest shadow reaches from the camera, i.e. the largest w
+  // of any shadow vertex once transformed by 'camera_transform'. Zero if
+  // there are no shadows.
+  float FarthestDepth(const mathfu::mat4& camera_transform) const;
+
+ private:
+  struct Vertex {
+    mathfu::vec3_packed pos;
+    mathfu::vec2_packed tc;
+    // The caster's texture_rect, for the shader to keep its samples within.
+    mathfu::vec4_packed texture_rect;
+  };
+
+  // The shadow of one caster, as of the last Update().
+  struct Shadow {
+    ShadowCaster caster;
+    Vertex vertices[4];
+  };
+
+  // The indices of all shadows with the same texture.
+  struct Draw {
+    fplbase::Texture* texture;
+    int first_index;
+    int num_indices;
+  };
+
+  static bool SameCaster(const ShadowCaster& a, const ShadowCaster& b);
+  void Project(const ShadowCaster& caster, Vertex* vertices) const;
+
+  // Indexed like the casters passed to Update().
+  std::vector<Shadow> shadows_;
+
+  // Every shadow's quad, grouped by texture.
+  std::vector<Vertex> vertices_;
+  std::vector<unsigned short> indices_;
+  std::vector<Draw> draws_;
+
+  mathfu::vec3_packed light_pos_;
+};
+
+}  // pie_noon
+}  // fpl
+
+#endif  // SHADOW_BATCH_H
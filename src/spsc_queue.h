@@ -0,0 +1,88 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace fpl {
+
+// Bounded, lock-free queue for handing data from exactly one producer thread
+// to exactly one consumer thread. Neither side ever blocks: Push() fails when
+// the queue is full and Pop() fails when it is empty.
+//
+// kCapacity must be a power of two. One slot is never used, so the queue
+// holds at most kCapacity - 1 items.
+template <class T, size_t kCapacity>
+class SpscQueue {
+  static_assert(kCapacity >= 2 && (kCapacity & (kCapacity - 1)) == 0,
+                "SpscQueue capacity must be a power of two.");
+
+ public:
+  SpscQueue() : head_(0), tail_(0) {}
+
+  // Producer only. Returns false, and leaves 'item' untouched, if full.
+  bool Push(T&& item) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t next = (tail + 1) & kMask;
+    if (next == head_.load(std::memory_order_acquire)) return false;
+    items_[tail] = std::move(item);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only. Returns false if there is nothing to pop.
+  bool Pop(T* item) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return false;
+    *item = std::move(items_[head]);
+    // Release whatever the slot still owns before handing it back.
+    items_[head] = T();
+    head_.store((head + 1) & kMask, std::memory_order_release);
+    return true;
+  }
+
+  // Safe to call from either side, but only a snapshot: the other thread may
+  // change the answer immediately.
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+  // Number of items in the queue. Also only a snapshot.
+  size_t Size() const {
+    return (tail_.load(std::memory_order_acquire) -
+            head_.load(std::memory_order_acquire)) & kMask;
+  }
+
+ private:
+  static const size_t kMask = kCapacity - 1;
+
+  T items_[kCapacity];
+
+  // Next slot to read. Written only by the consumer.
+  std::atomic<size_t> head_;
+  // Next slot to write. Written only by the producer.
+  std::atomic<size_t> tail_;
+
+  SpscQueue(const SpscQueue&);
+  void operator=(const SpscQueue&);
+};
+
+}  // namespace fpl
+
+#endif  // SPSC_QUEUE_H
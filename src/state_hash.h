@@ -0,0 +1,50 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STATE_HASH_H
+#define STATE_HASH_H
+
+#include <cstdint>
+
+namespace fpl {
+namespace pie_noon {
+
+// Builds a 32-bit FNV-1a hash one value at a time. Values are fed in as
+// integers, byte by byte, least significant first, so the result doesn't
+// depend on the compiler, the platform's byte order or struct padding.
+class StateHasher {
+ public:
+  StateHasher() : hash_(kOffsetBasis) {}
+
+  void Add(int32_t value) { Add(static_cast<uint32_t>(value)); }
+
+  void Add(uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+      hash_ = (hash_ ^ ((value >> (i * 8)) & 0xFF)) * kPrime;
+    }
+  }
+
+  uint32_t hash() const { return hash_; }
+
+ private:
+  static const uint32_t kOffsetBasis = 2166136261u;
+  static const uint32_t kPrime = 16777619u;
+
+  uint32_t hash_;
+};
+
+}  // pie_noon
+}  // fpl
+
+#endif  // STATE_HASH_H
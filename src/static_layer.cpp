@@ -0,0 +1,133 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/glplatform.h"
+#include "fplbase/mesh.h"
+#include "static_layer.h"
+
+using mathfu::mat4;
+using mathfu::vec2;
+using mathfu::vec2i;
+using mathfu::vec3;
+
+namespace fpl {
+namespace pie_noon {
+
+StaticLayer::StaticLayer()
+    : size_(0, 0),
+      framebuffer_(0),
+      color_texture_(0),
+      depth_renderbuffer_(0),
+      previous_framebuffer_(0),
+      valid_(false),
+      unsupported_(false) {
+  for (int i = 0; i < 4; ++i) previous_viewport_[i] = 0;
+}
+
+StaticLayer::~StaticLayer() { Destroy(); }
+
+void StaticLayer::Destroy() {
+  if (framebuffer_ != 0) {
+    GL_CALL(glDeleteFramebuffers(1, &framebuffer_));
+    framebuffer_ = 0;
+  }
+  if (color_texture_ != 0) {
+    GL_CALL(glDeleteTextures(1, &color_texture_));
+    color_texture_ = 0;
+  }
+  if (depth_renderbuffer_ != 0) {
+    GL_CALL(glDeleteRenderbuffers(1, &depth_renderbuffer_));
+    depth_renderbuffer_ = 0;
+  }
+  size_ = vec2i(0, 0);
+  valid_ = false;
+}
+
+bool StaticLayer::Begin(fplbase::Renderer& renderer, const vec2i& size) {
+  if (unsupported_) return false;
+  GL_CALL(glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous_framebuffer_));
+  GL_CALL(glGetIntegerv(GL_VIEWPORT, previous_viewport_));
+
+  if (framebuffer_ == 0 || size.x() != size_.x() || size.y() != size_.y()) {
+    Destroy();
+    size_ = size;
+
+    // Sampled once per pixel, at the same size, so no mipmaps or filtering.
+    GL_CALL(glGenTextures(1, &color_texture_));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, color_texture_));
+    GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x(), size.y(), 0,
+                         GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+    GL_CALL(
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    GL_CALL(
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+
+    // The props in the layer still have to hide each other.
+    GL_CALL(glGenRenderbuffers(1, &depth_renderbuffer_));
+    GL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer_));
+    GL_CALL(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16,
+                                  size.x(), size.y()));
+
+    GL_CALL(glGenFramebuffers(1, &framebuffer_));
+    GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_));
+    GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                   GL_TEXTURE_2D, color_texture_, 0));
+    GL_CALL(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                      GL_RENDERBUFFER, depth_renderbuffer_));
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+      fplbase::LogError(fplbase::kError,
+                        "Static layer framebuffer incomplete: 0x%x\n", status);
+      GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER,
+                                static_cast<GLuint>(previous_framebuffer_)));
+      Destroy();
+      unsupported_ = true;
+      return false;
+    }
+  } else {
+    GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_));
+  }
+
+  GL_CALL(glViewport(0, 0, size.x(), size.y()));
+  renderer.ClearFrameBuffer(mathfu::kZeros4f);
+  return true;
+}
+
+void StaticLayer::End() {
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER,
+                            static_cast<GLuint>(previous_framebuffer_)));
+  GL_CALL(glViewport(previous_viewport_[0], previous_viewport_[1],
+                     previous_viewport_[2], previous_viewport_[3]));
+  valid_ = true;
+}
+
+void StaticLayer::Composite(fplbase::Renderer& renderer,
+                            fplbase::Shader* shader) const {
+  // The quad covers clip space exactly. Framebuffer textures are stored
+  // bottom row first, unlike those fplbase loads.
+  renderer.set_model_view_projection(mat4::Identity());
+  renderer.set_color(mathfu::kOnes4f);
+  shader->Set(renderer);
+  GL_CALL(glActiveTexture(GL_TEXTURE0));
+  GL_CALL(glBindTexture(GL_TEXTURE_2D, color_texture_));
+  fplbase::Mesh::RenderAAQuadAlongX(vec3(-1.0f, -1.0f, 0.0f),
+                                    vec3(1.0f, 1.0f, 0.0f), vec2(0.0f, 0.0f),
+                                    vec2(1.0f, 1.0f));
+}
+
+}  // pie_noon
+}  // fpl
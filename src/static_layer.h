@@ -0,0 +1,96 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STATIC_LAYER_H
+#define STATIC_LAYER_H
+
+#include "fplbase/renderer.h"
+#include "fplbase/shader.h"
+#include "mathfu/glsl_mappings.h"
+
+namespace fpl {
+namespace pie_noon {
+
+// What it costs to draw something.
+struct StaticLayerCost {
+  StaticLayerCost() : draws(0), pixels(0.0f) {}
+  int draws;
+  // Estimated from the screen area of every quad drawn.
+  float pixels;
+};
+
+// What drawing the layer saved, over some number of frames.
+struct StaticLayerStats {
+  StaticLayerStats()
+      : frames(0), rebuilds(0), draws_saved(0), pixels_saved(0.0) {}
+  // Frames the layer was drawn in, and how many of those it was redrawn in.
+  int frames;
+  int rebuilds;
+  // Compared to drawing its contents directly. Negative if it was redrawn
+  // more often than it paid for.
+  int draws_saved;
+  double pixels_saved;
+};
+
+// An offscreen copy of the parts of the scene that haven't moved, so that
+// they can be drawn with a single full screen quad instead of redrawing every
+// one of them each frame.
+//
+// What goes into the layer, and when to draw it again, is up to the caller;
+// see PieNoonGame::RenderStaticLayer(). This class only owns the framebuffer.
+class StaticLayer {
+ public:
+  StaticLayer();
+  ~StaticLayer();
+
+  // Redirect rendering into the layer, resized to 'size' if need be, and
+  // clear it. Returns false, leaving rendering alone, if the layer can't be
+  // created on this device.
+  bool Begin(fplbase::Renderer& renderer, const mathfu::vec2i& size);
+
+  // Go back to rendering wherever Begin() redirected it from.
+  void End();
+
+  // Draw the layer over the whole viewport with 'shader', which should take a
+  // texture and a color. Pixels that were left clear don't overwrite anything.
+  void Composite(fplbase::Renderer& renderer, fplbase::Shader* shader) const;
+
+  // True once the layer has been drawn into.
+  bool valid() const { return valid_; }
+  void Invalidate() { valid_ = false; }
+
+ private:
+  void Destroy();
+
+  mathfu::vec2i size_;
+
+  // GL names of the framebuffer and its attachments. Zero if not created.
+  unsigned int framebuffer_;
+  unsigned int color_texture_;
+  unsigned int depth_renderbuffer_;
+
+  // What Begin() redirected rendering from.
+  int previous_framebuffer_;
+  int previous_viewport_[4];
+
+  bool valid_;
+
+  // Set if the framebuffer couldn't be created, so as not to keep trying.
+  bool unsupported_;
+};
+
+}  // pie_noon
+}  // fpl
+
+#endif  // STATIC_LAYER_H
@@ -0,0 +1,157 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include <limits>
+
+#include "utility_ai_controller.h"
+
+namespace fpl {
+namespace pie_noon {
+
+UtilityAiController::UtilityAiController()
+    : Controller(kTypeAI),
+      gamestate_(nullptr),
+      config_(nullptr),
+      has_decided_(false),
+      block_window_start_(AiPerception::kNoImpact),
+      decision_(0) {}
+
+void UtilityAiController::Initialize(GameState* gamestate,
+                                     const Config* config,
+                                     CharacterId character_id) {
+  gamestate_ = gamestate;
+  config_ = config;
+  character_id_ = character_id;
+  has_decided_ = false;
+  block_window_start_ = AiPerception::kNoImpact;
+  decision_ = 0;
+}
+
+void UtilityAiController::AdvanceFrame(WorldTime /*delta_time*/) {
+  if (character_id_ == kNoCharacter) {
+    return;
+  }
+  ClearAllLogicalInputs();
+
+  const AiPerception& perception = gamestate_->perception();
+  const Character& character = *gamestate_->characters()[character_id_];
+  DecisionInputs inputs;
+  inputs.generation = perception.generation();
+  inputs.state = character.State();
+  inputs.target = character.target();
+  inputs.can_act = character.CanAct();
+
+  // The block window only moves when the pies heading our way change.
+  if (!has_decided_ || inputs.generation != last_inputs_.generation) {
+    const WorldTime time_to_impact = perception.time_to_impact(character_id_);
+    block_window_start_ =
+        time_to_impact == AiPerception::kNoImpact
+            ? AiPerception::kNoImpact
+            : gamestate_->time() + time_to_impact -
+                  config_->ai_utility_block_lead_time();
+  }
+  inputs.in_block_window = gamestate_->time() >= block_window_start_;
+
+  if (!has_decided_ || !(inputs == last_inputs_)) {
+    last_inputs_ = inputs;
+    has_decided_ = true;
+    Decide();
+  }
+  if (decision_ != 0) {
+    SetLogicalInputs(decision_, true);
+  }
+}
+
+WorldTime UtilityAiController::TimeUntilInput() const {
+  if (character_id_ == kNoCharacter) return kNoPendingInput;
+  if (!has_decided_ || decision_ != 0) return 0;
+  // Anything else that would change our mind happens in the game itself,
+  // which won't skip the frame it happens in.
+  if (last_inputs_.in_block_window ||
+      block_window_start_ == AiPerception::kNoImpact) {
+    return kNoPendingInput;
+  }
+  return std::max(block_window_start_ - gamestate_->time(), 0);
+}
+
+void UtilityAiController::Decide() {
+  decision_ = 0;
+  if (!last_inputs_.can_act) return;
+
+  const AiPerception& perception = gamestate_->perception();
+  const CharacterId target = last_inputs_.target;
+  const bool target_valid =
+      target != character_id_ && perception.IsValidTarget(target);
+
+  // Blocking is only worth anything once the pie is about to land.
+  float block_score = 0.0f;
+  if (last_inputs_.in_block_window && !gamestate_->is_in_cardboard()) {
+    block_score = config_->ai_utility_block_weight() *
+                  perception.incoming_damage(character_id_);
+  }
+
+  const CharacterHealth pie_damage = perception.pie_damage(character_id_);
+  float throw_score = 0.0f;
+  if (target_valid && pie_damage > 0) {
+    throw_score = config_->ai_utility_throw_weight() * pie_damage;
+    if (pie_damage >= perception.health(target)) {
+      throw_score += config_->ai_utility_knockout_bonus();
+    }
+  }
+
+  // Look for a target that's enough better than the one we have.
+  const float current_score =
+      target_valid ? TargetScore(target) : -std::numeric_limits<float>::max();
+  float best_score = current_score + config_->ai_utility_turn_threshold();
+  CharacterId best_target = kNoCharacter;
+  const CharacterId num_characters =
+      static_cast<CharacterId>(gamestate_->characters().size());
+  for (CharacterId id = 0; id < num_characters; ++id) {
+    if (id == character_id_ || id == target || !perception.IsValidTarget(id)) {
+      continue;
+    }
+    const float score = TargetScore(id);
+    if (score > best_score) {
+      best_score = score;
+      best_target = id;
+    }
+  }
+
+  if (block_score > 0.0f && block_score >= throw_score) {
+    decision_ = LogicalInputs_Deflect;
+  } else if (best_target != kNoCharacter) {
+    set_target_id(best_target);
+    decision_ = LogicalInputs_TurnToTarget;
+  } else if (throw_score > config_->ai_utility_charge_score()) {
+    decision_ = LogicalInputs_ThrowPie;
+  }  // else let our pie grow.
+}
+
+float UtilityAiController::TargetScore(CharacterId target) const {
+  const AiPerception& perception = gamestate_->perception();
+  const CharacterHealth health = perception.health(target);
+  float score = config_->ai_utility_target_weakness_weight() *
+                    (config_->character_health() - health) +
+                config_->ai_utility_target_threat_weight() *
+                    perception.pie_damage(target);
+  const CharacterHealth pie_damage = perception.pie_damage(character_id_);
+  if (pie_damage > 0 && pie_damage >= health) {
+    score += config_->ai_utility_knockout_bonus();
+  }
+  return score;
+}
+
+}  // pie_noon
+}  // fpl
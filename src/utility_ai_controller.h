@@ -0,0 +1,86 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef UTILITY_AI_CONTROLLER_H_
+#define UTILITY_AI_CONTROLLER_H_
+
+#include "common.h"
+#include "config_generated.h"
+#include "controller.h"
+#include "game_state.h"
+
+namespace fpl {
+namespace pie_noon {
+
+// A computer-controlled player that scores blocking, turning, throwing and
+// waiting from what it can see, and does whatever scores best.
+//
+// It blocks just before the first incoming pie lands, throws once its pie
+// is big enough to be worth it (or big enough to knock out its target), and
+// turns toward whoever is weakest or most dangerous. Its decision only
+// depends on the shared AiPerception, its own state and target, and whether
+// the block window has opened, so it only decides again when one of those
+// changes. Each decision is a handful of multiplies per character.
+class UtilityAiController : public Controller {
+ public:
+  UtilityAiController();
+
+  // Give the AI everything it will need.
+  void Initialize(GameState* gamestate, const Config* config,
+                  CharacterId character_id);
+
+  // Decide again if anything we decide on has changed, then hold down the
+  // inputs for the current decision.
+  virtual void AdvanceFrame(WorldTime delta_time);
+
+  virtual WorldTime TimeUntilInput() const;
+
+ private:
+  // Everything a decision depends on.
+  struct DecisionInputs {
+    bool operator==(const DecisionInputs& rhs) const {
+      return generation == rhs.generation && state == rhs.state &&
+             target == rhs.target && can_act == rhs.can_act &&
+             in_block_window == rhs.in_block_window;
+    }
+
+    uint32_t generation;  // AiPerception::generation().
+    uint16_t state;
+    CharacterId target;
+    bool can_act;
+    bool in_block_window;
+  };
+
+  void Decide();
+  // How much we'd like to be aiming at 'target'.
+  float TargetScore(CharacterId target) const;
+
+  GameState* gamestate_;  // Pointer to the gamestate object
+  const Config* config_;  // Pointer to the config structure
+
+  DecisionInputs last_inputs_;
+  bool has_decided_;
+
+  // When to start blocking the first incoming pie, or
+  // AiPerception::kNoImpact if there isn't one.
+  WorldTime block_window_start_;
+
+  // Logical inputs to hold down until the next decision.
+  uint32_t decision_;
+};
+
+}  // pie_noon
+}  // fpl
+
+#endif  // UTILITY_AI_CONTROLLER_H_
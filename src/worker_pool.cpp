@@ -0,0 +1,87 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+
+#include "worker_pool.h"
+
+namespace fpl {
+
+WorkerPool::WorkerPool()
+    : job_(nullptr),
+      num_jobs_(0),
+      next_job_(0),
+      jobs_remaining_(0),
+      quit_(false) {}
+
+WorkerPool::~WorkerPool() { Shutdown(); }
+
+void WorkerPool::Initialize(int num_threads) {
+  Shutdown();
+  quit_ = false;
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.push_back(std::thread(&WorkerPool::WorkerMain, this));
+  }
+}
+
+void WorkerPool::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  work_ready_.notify_all();
+  for (auto it = threads_.begin(); it != threads_.end(); ++it) {
+    it->join();
+  }
+  threads_.clear();
+}
+
+void WorkerPool::ParallelFor(int num_jobs,
+                             const std::function<void(int)>& job) {
+  if (num_jobs <= 0) return;
+  if (threads_.empty() || num_jobs == 1) {
+    for (int i = 0; i < num_jobs; ++i) job(i);
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  job_ = &job;
+  num_jobs_ = num_jobs;
+  next_job_ = 0;
+  jobs_remaining_ = num_jobs;
+  work_ready_.notify_all();
+  work_done_.wait(lock, [this] { return jobs_remaining_ == 0; });
+  job_ = nullptr;
+}
+
+void WorkerPool::WorkerMain() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    work_ready_.wait(lock, [this] { return quit_ || next_job_ < num_jobs_; });
+    if (quit_) return;
+
+    const int index = next_job_++;
+    const std::function<void(int)>* job = job_;
+    lock.unlock();
+    (*job)(index);
+    lock.lock();
+
+    if (--jobs_remaining_ == 0) {
+      num_jobs_ = 0;
+      work_done_.notify_one();
+    }
+  }
+}
+
+}  // namespace fpl
@@ -0,0 +1,71 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fpl {
+
+// A fixed set of threads that split up a batch of independent jobs.
+// ParallelFor() hands out job indices to the workers and waits for all of
+// them to finish, so the caller sees the batch as one blocking call.
+//
+// Only one thread may call ParallelFor() at a time.
+class WorkerPool {
+ public:
+  WorkerPool();
+  ~WorkerPool();
+
+  // Start 'num_threads' worker threads. With 0 threads, ParallelFor() runs
+  // every job on the calling thread.
+  void Initialize(int num_threads);
+
+  // Call job(i) for every i in [0, num_jobs), spread across the workers, and
+  // return once they have all finished. Jobs may run in any order, so each
+  // one must only write to data that no other job touches.
+  void ParallelFor(int num_jobs, const std::function<void(int)>& job);
+
+  int num_threads() const { return static_cast<int>(threads_.size()); }
+
+ private:
+  void WorkerMain();
+  void Shutdown();
+
+  std::vector<std::thread> threads_;
+
+  // Everything below is protected by mutex_.
+  std::mutex mutex_;
+  // Signalled when a batch is posted, or when the pool is shutting down.
+  std::condition_variable work_ready_;
+  // Signalled when the last job of a batch finishes.
+  std::condition_variable work_done_;
+  const std::function<void(int)>* job_;
+  int num_jobs_;
+  int next_job_;
+  int jobs_remaining_;
+  bool quit_;
+
+  WorkerPool(const WorkerPool&);
+  void operator=(const WorkerPool&);
+};
+
+}  // namespace fpl
+
+#endif  // WORKER_POOL_H
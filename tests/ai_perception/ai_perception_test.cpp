@@ -0,0 +1,163 @@
+/*
+* Copyright (c) 2015 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <memory>
+#include <vector>
+#include "ai_perception.h"
+#include "character.h"
+#include "character_state_machine_def_generated.h"
+#include "config_generated.h"
+#include "game_state_snapshot.h"
+#include "timeline_generated.h"
+#include "flatbuffers/flatbuffers.h"
+#include "gtest/gtest.h"
+
+namespace pn = ::fpl::pie_noon;
+namespace fb = ::flatbuffers;
+
+static const int kNumCharacters = 4;
+
+// Characters need a config and a state machine, but AiPerception only looks
+// at their health and pie damage, so empty ones do.
+class AiPerceptionTests : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    config_builder_.Finish(pn::CreateConfig(config_builder_));
+    std::vector<fb::Offset<pn::CharacterState>> states;
+    for (int i = 0; i < pn::StateId_Count; i++) {
+      states.push_back(pn::CreateCharacterState(
+          state_machine_builder_, static_cast<pn::StateId>(i),
+          state_machine_builder_.CreateVector<fb::Offset<pn::Transition>>(
+              nullptr, 0),
+          fpl::CreateTimeline(state_machine_builder_)));
+    }
+    state_machine_builder_.Finish(pn::CreateCharacterStateMachineDef(
+        state_machine_builder_, state_machine_builder_.CreateVector(states),
+        pn::StateId_Idling));
+
+    const pn::Config* config =
+        pn::GetConfig(config_builder_.GetBufferPointer());
+    const pn::CharacterStateMachineDef* state_machine =
+        pn::GetCharacterStateMachineDef(
+            state_machine_builder_.GetBufferPointer());
+    for (int i = 0; i < kNumCharacters; ++i) {
+      characters_.push_back(std::unique_ptr<pn::Character>(
+          new pn::Character(i, nullptr, *config, state_machine)));
+    }
+  }
+
+  void SetCharacter(fpl::CharacterId id, pn::CharacterHealth health,
+                    pn::CharacterHealth pie_damage) {
+    characters_[id]->set_health(health);
+    characters_[id]->set_pie_damage(pie_damage);
+  }
+
+  void Throw(fpl::CharacterId target, pn::CharacterHealth damage,
+             fpl::WorldTime start_time, fpl::WorldTime flight_time) {
+    pn::AirbornePieSnapshot pie = pn::AirbornePieSnapshot();
+    pie.target = target;
+    pie.damage = damage;
+    pie.start_time = start_time;
+    pie.flight_time = flight_time;
+    pies_.push_back(std::unique_ptr<pn::AirbornePie>(new pn::AirbornePie(pie)));
+  }
+
+  fb::FlatBufferBuilder config_builder_;
+  fb::FlatBufferBuilder state_machine_builder_;
+  std::vector<std::unique_ptr<pn::Character>> characters_;
+  std::vector<std::unique_ptr<pn::AirbornePie>> pies_;
+  pn::AiPerception perception_;
+};
+
+// Pies in the air are totted up for the character they're heading for.
+TEST_F(AiPerceptionTests, CountsIncomingPies) {
+  for (int i = 0; i < kNumCharacters; ++i) SetCharacter(i, 10, 1);
+  Throw(1, 2, 1000, 500);
+  Throw(1, 3, 900, 400);
+  perception_.Update(characters_, pies_, 1000);
+
+  EXPECT_TRUE(perception_.IsInDanger(1));
+  EXPECT_EQ(2, perception_.incoming_pies(1));
+  EXPECT_EQ(5, perception_.incoming_damage(1));
+  EXPECT_EQ(300, perception_.time_to_impact(1));
+
+  EXPECT_FALSE(perception_.IsInDanger(0));
+  EXPECT_EQ(0, perception_.incoming_pies(0));
+  EXPECT_EQ(pn::AiPerception::kNoImpact, perception_.time_to_impact(0));
+}
+
+// Rankings skip 'self' and characters with no health, and return every
+// character tied for best, in id order.
+TEST_F(AiPerceptionTests, RanksTargets) {
+  SetCharacter(0, 10, 1);
+  SetCharacter(1, 0, 3);
+  SetCharacter(2, 5, 3);
+  SetCharacter(3, 5, 2);
+  perception_.Update(characters_, pies_, 0);
+  EXPECT_FALSE(perception_.IsValidTarget(1));
+
+  std::vector<fpl::CharacterId> targets;
+  perception_.LargestPieTargets(0, &targets);
+  EXPECT_EQ(std::vector<fpl::CharacterId>({2}), targets);
+
+  targets.clear();
+  perception_.LowestHealthTargets(0, &targets);
+  EXPECT_EQ(std::vector<fpl::CharacterId>({2, 3}), targets);
+
+  targets.clear();
+  perception_.LowestHealthTargets(2, &targets);
+  EXPECT_EQ(std::vector<fpl::CharacterId>({3}), targets);
+
+  targets.clear();
+  perception_.HighestHealthTargets(0, &targets);
+  EXPECT_EQ(std::vector<fpl::CharacterId>({2, 3}), targets);
+
+  targets.clear();
+  perception_.HighestHealthTargets(2, &targets);
+  EXPECT_EQ(std::vector<fpl::CharacterId>({0}), targets);
+
+  targets.clear();
+  perception_.AllTargets(0, &targets);
+  EXPECT_EQ(std::vector<fpl::CharacterId>({2, 3}), targets);
+}
+
+// The generation only moves when something other than the time changes.
+TEST_F(AiPerceptionTests, GenerationTracksChanges) {
+  for (int i = 0; i < kNumCharacters; ++i) SetCharacter(i, 10, 1);
+  perception_.Update(characters_, pies_, 0);
+  const uint32_t generation = perception_.generation();
+
+  perception_.Update(characters_, pies_, 100);
+  EXPECT_EQ(generation, perception_.generation());
+
+  characters_[2]->set_pie_damage(2);
+  perception_.Update(characters_, pies_, 200);
+  EXPECT_EQ(generation + 1, perception_.generation());
+
+  Throw(3, 1, 200, 500);
+  perception_.Update(characters_, pies_, 300);
+  EXPECT_EQ(generation + 2, perception_.generation());
+
+  perception_.Update(characters_, pies_, 400);
+  EXPECT_EQ(generation + 2, perception_.generation());
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,115 @@
+/*
+* Copyright (c) 2015 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include "ai_scheduler.h"
+#include "controller.h"
+#include "worker_pool.h"
+#include "gtest/gtest.h"
+
+namespace pn = ::fpl::pie_noon;
+
+// Controls nobody, so the scheduler wakes it every frame without looking at
+// the game. Draws from its own generator each frame, like AiController.
+class RandomController : public pn::Controller {
+ public:
+  explicit RandomController(unsigned int seed)
+      : pn::Controller(kTypeAI),
+        random_(seed),
+        num_frames_(0),
+        total_time_(0),
+        last_draw_(0) {}
+
+  virtual void AdvanceFrame(fpl::WorldTime delta_time) {
+    num_frames_++;
+    total_time_ += delta_time;
+    last_draw_ = random_();
+    thread_ = std::this_thread::get_id();
+  }
+
+  int num_frames() const { return num_frames_; }
+  fpl::WorldTime total_time() const { return total_time_; }
+  unsigned int last_draw() const { return last_draw_; }
+  std::thread::id thread() const { return thread_; }
+
+ private:
+  std::minstd_rand random_;
+  int num_frames_;
+  fpl::WorldTime total_time_;
+  unsigned int last_draw_;
+  std::thread::id thread_;
+};
+
+static const int kNumControllers = 32;
+static const int kNumFrames = 10;
+static const fpl::WorldTime kFrameTime = 16;
+
+static void Play(fpl::WorkerPool* worker_pool, int min_parallel_batch,
+                 std::vector<std::unique_ptr<RandomController>>* controllers) {
+  pn::AiScheduler scheduler;
+  // The controllers have no character, so the game is never looked at.
+  scheduler.Initialize(nullptr, min_parallel_batch);
+  scheduler.set_worker_pool(worker_pool);
+  for (int i = 0; i < kNumControllers; ++i) {
+    controllers->push_back(
+        std::unique_ptr<RandomController>(new RandomController(i + 1)));
+    scheduler.AddController(controllers->back().get());
+  }
+  for (int frame = 0; frame < kNumFrames; ++frame) {
+    scheduler.AdvanceFrame(kFrameTime);
+    EXPECT_EQ(kNumControllers, scheduler.num_awake());
+  }
+}
+
+// A batch of one is big enough, so every frame goes through the worker
+// pool, and must come out the same as running the controllers in turn.
+TEST(AiSchedulerTests, ParallelBatchMatchesSerial) {
+  fpl::WorkerPool worker_pool;
+  worker_pool.Initialize(4);
+  std::vector<std::unique_ptr<RandomController>> parallel;
+  Play(&worker_pool, 1, &parallel);
+
+  std::vector<std::unique_ptr<RandomController>> serial;
+  Play(nullptr, 1, &serial);
+
+  for (int i = 0; i < kNumControllers; ++i) {
+    EXPECT_EQ(kNumFrames, parallel[i]->num_frames());
+    EXPECT_EQ(kNumFrames * kFrameTime, parallel[i]->total_time());
+    EXPECT_EQ(serial[i]->last_draw(), parallel[i]->last_draw());
+  }
+}
+
+// Batches smaller than the minimum stay on the calling thread.
+TEST(AiSchedulerTests, SmallBatchRunsSerially) {
+  fpl::WorkerPool worker_pool;
+  worker_pool.Initialize(4);
+  std::vector<std::unique_ptr<RandomController>> controllers;
+  Play(&worker_pool, kNumControllers + 1, &controllers);
+  for (int i = 0; i < kNumControllers; ++i) {
+    EXPECT_EQ(kNumFrames, controllers[i]->num_frames());
+    EXPECT_EQ(std::this_thread::get_id(), controllers[i]->thread());
+  }
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,131 @@
+/*
+* Copyright (c) 2015 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <vector>
+#include "client_snapshot_buffer.h"
+#include "gtest/gtest.h"
+
+namespace pn = ::fpl::pie_noon;
+
+static std::vector<uint8_t> Bytes(uint8_t value) {
+  return std::vector<uint8_t>(1, value);
+}
+
+// Adds a snapshot of one player with 'health' and 'splats'.
+static bool Add(pn::ClientSnapshotBuffer* buffer, fpl::WorldTime host_time,
+                fpl::WorldTime receive_time, uint8_t health, uint8_t splats) {
+  return buffer->AddSnapshot(host_time, receive_time, Bytes(health),
+                             Bytes(splats));
+}
+
+TEST(ClientSnapshotBufferTests, EmptyHasNothingToSample) {
+  pn::ClientSnapshotBuffer buffer;
+  std::vector<float> health;
+  std::vector<uint8_t> splats;
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_FALSE(buffer.Sample(1000, 100, &health, &splats));
+}
+
+// Health is blended between the snapshots either side of the delayed time,
+// and splats come from the earlier one.
+TEST(ClientSnapshotBufferTests, BlendsHealthBetweenSnapshots) {
+  pn::ClientSnapshotBuffer buffer;
+  EXPECT_TRUE(Add(&buffer, 0, 1000, 10, 1));
+  EXPECT_TRUE(Add(&buffer, 100, 1100, 20, 2));
+
+  std::vector<float> health;
+  std::vector<uint8_t> splats;
+  ASSERT_TRUE(buffer.Sample(1150, 100, &health, &splats));
+  ASSERT_EQ(1u, health.size());
+  EXPECT_FLOAT_EQ(15.0f, health[0]);
+  EXPECT_EQ(Bytes(1), splats);
+}
+
+// Past the newest snapshot, it's held rather than extrapolated.
+TEST(ClientSnapshotBufferTests, HoldsTheNewestSnapshot) {
+  pn::ClientSnapshotBuffer buffer;
+  Add(&buffer, 0, 1000, 10, 1);
+  Add(&buffer, 100, 1100, 20, 2);
+
+  std::vector<float> health;
+  std::vector<uint8_t> splats;
+  ASSERT_TRUE(buffer.Sample(5000, 100, &health, &splats));
+  EXPECT_FLOAT_EQ(20.0f, health[0]);
+  EXPECT_EQ(Bytes(2), splats);
+}
+
+// Snapshots that arrive out of order are dropped.
+TEST(ClientSnapshotBufferTests, RejectsOlderSnapshots) {
+  pn::ClientSnapshotBuffer buffer;
+  EXPECT_TRUE(Add(&buffer, 100, 1100, 20, 2));
+  EXPECT_FALSE(Add(&buffer, 50, 1120, 15, 1));
+
+  std::vector<float> health;
+  std::vector<uint8_t> splats;
+  ASSERT_TRUE(buffer.Sample(1100, 100, &health, &splats));
+  EXPECT_FLOAT_EQ(20.0f, health[0]);
+}
+
+// The clock offset comes from the fastest snapshot, so one that arrives late
+// doesn't drag the playback time back.
+TEST(ClientSnapshotBufferTests, ClockOffsetFollowsFastestSnapshot) {
+  pn::ClientSnapshotBuffer buffer;
+  Add(&buffer, 0, 1000, 10, 1);
+  Add(&buffer, 100, 1300, 20, 2);
+
+  // The offset may creep up by a millisecond per snapshot, to 1001.
+  std::vector<float> health;
+  std::vector<uint8_t> splats;
+  ASSERT_TRUE(buffer.Sample(1051, 0, &health, &splats));
+  EXPECT_FLOAT_EQ(15.0f, health[0]);
+}
+
+// Only the newest few snapshots are kept.
+TEST(ClientSnapshotBufferTests, OverwritesTheOldest) {
+  pn::ClientSnapshotBuffer buffer;
+  for (int i = 0; i < 20; ++i) {
+    Add(&buffer, i * 100, 1000 + i * 100, static_cast<uint8_t>(i), 0);
+  }
+
+  // Going back before everything kept gives the oldest left.
+  std::vector<float> health;
+  std::vector<uint8_t> splats;
+  ASSERT_TRUE(buffer.Sample(1000, 0, &health, &splats));
+  EXPECT_LT(0.0f, health[0]);
+  EXPECT_GT(19.0f, health[0]);
+}
+
+// After discarding, sampling the past gives the newest snapshot.
+TEST(ClientSnapshotBufferTests, DiscardAllButNewest) {
+  pn::ClientSnapshotBuffer buffer;
+  Add(&buffer, 0, 1000, 10, 1);
+  Add(&buffer, 100, 1100, 20, 2);
+  buffer.DiscardAllButNewest();
+  EXPECT_FALSE(buffer.empty());
+
+  std::vector<float> health;
+  std::vector<uint8_t> splats;
+  ASSERT_TRUE(buffer.Sample(1000, 0, &health, &splats));
+  EXPECT_FLOAT_EQ(20.0f, health[0]);
+  EXPECT_EQ(Bytes(2), splats);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
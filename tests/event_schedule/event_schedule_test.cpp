@@ -0,0 +1,88 @@
+/*
+* Copyright (c) 2015 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <vector>
+#include "event_schedule.h"
+#include "gtest/gtest.h"
+
+namespace pn = ::fpl::pie_noon;
+
+// Events come out earliest first, whatever order they went in.
+TEST(EventScheduleTests, PopsEarliestFirst) {
+  pn::EventSchedule<int> schedule;
+  const fpl::WorldTime times[] = {50, 10, 40, 20, 30};
+  for (int i = 0; i < 5; ++i) schedule.Schedule(times[i], times[i]);
+  EXPECT_EQ(10, schedule.next_time());
+
+  int payload;
+  for (fpl::WorldTime expected = 10; expected <= 50; expected += 10) {
+    ASSERT_TRUE(schedule.PopDue(1000, &payload));
+    EXPECT_EQ(expected, payload);
+  }
+  EXPECT_TRUE(schedule.empty());
+  EXPECT_FALSE(schedule.PopDue(1000, &payload));
+}
+
+// Nothing comes out before it's due, and the schedule is left alone.
+TEST(EventScheduleTests, WaitsUntilDue) {
+  pn::EventSchedule<int> schedule;
+  schedule.Schedule(100, 1);
+  int payload = -1;
+  EXPECT_FALSE(schedule.PopDue(99, &payload));
+  EXPECT_EQ(-1, payload);
+  EXPECT_EQ(100, schedule.next_time());
+  EXPECT_TRUE(schedule.PopDue(100, &payload));
+  EXPECT_EQ(1, payload);
+}
+
+// Events due at the same time come out in the order they were scheduled.
+TEST(EventScheduleTests, TiesKeepScheduleOrder) {
+  pn::EventSchedule<int> schedule;
+  static const int kNumEvents = 64;
+  for (int i = 0; i < kNumEvents; ++i) {
+    schedule.Schedule(i % 2 == 0 ? 20 : 10, i);
+  }
+  std::vector<int> order;
+  int payload;
+  while (schedule.PopDue(20, &payload)) order.push_back(payload);
+  ASSERT_EQ(static_cast<size_t>(kNumEvents), order.size());
+  for (int i = 0; i < kNumEvents / 2; ++i) {
+    EXPECT_EQ(2 * i + 1, order[i]);
+    EXPECT_EQ(2 * i, order[kNumEvents / 2 + i]);
+  }
+}
+
+// Clearing empties the schedule and starts the tie order over.
+TEST(EventScheduleTests, ClearEmpties) {
+  pn::EventSchedule<int> schedule;
+  schedule.Schedule(5, 1);
+  schedule.Schedule(6, 2);
+  schedule.Clear();
+  EXPECT_TRUE(schedule.empty());
+  int payload;
+  EXPECT_FALSE(schedule.PopDue(100, &payload));
+  schedule.Schedule(7, 3);
+  schedule.Schedule(7, 4);
+  EXPECT_TRUE(schedule.PopDue(7, &payload));
+  EXPECT_EQ(3, payload);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
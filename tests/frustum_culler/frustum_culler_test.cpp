@@ -0,0 +1,104 @@
+/*
+* Copyright (c) 2015 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <vector>
+#include "frustum_culler.h"
+#include "gtest/gtest.h"
+
+namespace pn = ::fpl::pie_noon;
+using mathfu::mat4;
+using mathfu::vec3;
+
+// With no transform, clip space is the frustum: the cube from -1 to 1.
+TEST(FrustumCullerTests, CullsOutsideTheCube) {
+  pn::FrustumCuller culler;
+  culler.Clear(5);
+  culler.Add(vec3(0.0f, 0.0f, 0.0f), 0.1f);   // Inside.
+  culler.Add(vec3(3.0f, 0.0f, 0.0f), 0.5f);   // Right of it.
+  culler.Add(vec3(1.5f, 0.0f, 0.0f), 0.6f);   // Overlaps the right side.
+  culler.Add(vec3(0.0f, -1.5f, 0.0f), 0.4f);  // Below it.
+  culler.Add(vec3(0.0f, 0.0f, 2.0f), 0.5f);   // Behind it.
+  EXPECT_EQ(5u, culler.num_spheres());
+
+  std::vector<uint8_t> visible;
+  EXPECT_EQ(3, culler.Cull(mat4::Identity(), &visible));
+  const uint8_t expected[] = {1, 0, 1, 0, 0};
+  EXPECT_EQ(std::vector<uint8_t>(expected, expected + 5), visible);
+}
+
+// A camera at the origin looking down -z, with a 90 degree field of view and
+// near and far planes at 1 and 100, as glFrustum() would set it up. mat4's
+// constructor takes one column at a time.
+static mat4 Perspective() {
+  const float near_plane = 1.0f;
+  const float far_plane = 100.0f;
+  const float depth = near_plane - far_plane;
+  return mat4(1.0f, 0.0f, 0.0f, 0.0f,
+              0.0f, 1.0f, 0.0f, 0.0f,
+              0.0f, 0.0f, (far_plane + near_plane) / depth, -1.0f,
+              0.0f, 0.0f, 2.0f * far_plane * near_plane / depth, 0.0f);
+}
+
+// What the camera looks at is kept, and what's behind it, past the far plane
+// or off to the side is culled.
+TEST(FrustumCullerTests, CullsAroundTheCamera) {
+  pn::FrustumCuller culler;
+  culler.Clear(4);
+  culler.Add(vec3(0.0f, 0.0f, -10.0f), 1.0f);   // In front.
+  culler.Add(vec3(0.0f, 0.0f, 10.0f), 1.0f);    // Behind the camera.
+  culler.Add(vec3(50.0f, 0.0f, -10.0f), 1.0f);  // Far to the side.
+  culler.Add(vec3(0.0f, 0.0f, -200.0f), 1.0f);  // Past the far plane.
+
+  std::vector<uint8_t> visible;
+  EXPECT_EQ(3, culler.Cull(Perspective(), &visible));
+  const uint8_t expected[] = {1, 0, 0, 0};
+  EXPECT_EQ(std::vector<uint8_t>(expected, expected + 4), visible);
+}
+
+// Spheres are measured against the slanted side planes by true distance. At
+// z = -10 the right side of the frustum is at x = 10, and a sphere centered
+// at x = 10 + d is d / sqrt(2) from it.
+TEST(FrustumCullerTests, MeasuresDistanceToSlantedPlanes) {
+  pn::FrustumCuller culler;
+  culler.Clear(2);
+  culler.Add(vec3(11.0f, 0.0f, -10.0f), 1.0f);  // 0.71 out; still touches.
+  culler.Add(vec3(12.0f, 0.0f, -10.0f), 1.0f);  // 1.41 out.
+
+  std::vector<uint8_t> visible;
+  EXPECT_EQ(1, culler.Cull(Perspective(), &visible));
+  const uint8_t expected[] = {1, 0};
+  EXPECT_EQ(std::vector<uint8_t>(expected, expected + 2), visible);
+}
+
+// Clearing forgets the old spheres.
+TEST(FrustumCullerTests, ClearRemovesSpheres) {
+  pn::FrustumCuller culler;
+  culler.Clear(1);
+  culler.Add(vec3(5.0f, 0.0f, 0.0f), 1.0f);
+  culler.Clear(0);
+  EXPECT_EQ(0u, culler.num_spheres());
+
+  std::vector<uint8_t> visible(3, 1);
+  EXPECT_EQ(0, culler.Cull(mat4::Identity(), &visible));
+  EXPECT_TRUE(visible.empty());
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,185 @@
+/*
+* Copyright (c) 2015 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ai_controller.h"
+#include "character_state_machine.h"
+#include "character_state_machine_def_generated.h"
+#include "config_generated.h"
+#include "flatbuffers/util.h"
+#include "game_state_snapshot.h"
+#include "headless_game.h"
+#include "motive/init.h"
+#include "gtest/gtest.h"
+
+namespace pn = ::fpl::pie_noon;
+
+static const fpl::WorldTime kFrameTime = 33;
+
+// Loads the built config once for every test.
+class GameStateSnapshotTests : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    const std::string assets_dir = PIE_NOON_ASSETS_DIR;
+    if (!flatbuffers::LoadFile((assets_dir + "/config.pieconfig").c_str(),
+                               true, &config_source_) ||
+        !flatbuffers::LoadFile(
+            (assets_dir + "/character_state_machine_def.piestate").c_str(),
+            true, &state_machine_source_)) {
+      return;
+    }
+    motive::OvershootInit::Register();
+    motive::SplineInit::Register();
+    motive::MatrixInit::Register();
+  }
+
+  virtual void SetUp() {
+    ASSERT_FALSE(config_source_.empty())
+        << "Build the assets with scripts/build_assets.py first.";
+    config_ = pn::GetConfig(config_source_.c_str());
+    state_machine_def_ =
+        pn::GetCharacterStateMachineDef(state_machine_source_.c_str());
+    ASSERT_TRUE(pn::CharacterStateMachineDef_Validate(state_machine_def_));
+  }
+
+  std::unique_ptr<pn::HeadlessGame> NewGame() const {
+    std::vector<std::unique_ptr<pn::AiController>> controllers;
+    for (unsigned int i = 0; i < config_->character_count(); ++i) {
+      controllers.push_back(
+          std::unique_ptr<pn::AiController>(new pn::AiController()));
+    }
+    std::unique_ptr<pn::HeadlessGame> game(new pn::HeadlessGame());
+    game->Initialize(config_, state_machine_def_, &controllers);
+    return game;
+  }
+
+  static std::string config_source_;
+  static std::string state_machine_source_;
+  const pn::Config* config_;
+  const pn::CharacterStateMachineDef* state_machine_def_;
+};
+
+std::string GameStateSnapshotTests::config_source_;
+std::string GameStateSnapshotTests::state_machine_source_;
+
+// Saving, playing on, and restoring puts the game back exactly.
+TEST_F(GameStateSnapshotTests, RestoreReturnsToSavedHash) {
+  std::unique_ptr<pn::HeadlessGame> game = NewGame();
+  game->Restart(1);
+  game->PlayUntil(5000, kFrameTime);
+  pn::GameStateSnapshot snapshot;
+  game->game_state().SaveSnapshot(&snapshot);
+  const uint32_t saved_hash = game->game_state().StateHash();
+  const fpl::WorldTime saved_time = game->game_state().time();
+
+  game->PlayUntil(15000, kFrameTime);
+  ASSERT_TRUE(game->Restore(snapshot));
+  EXPECT_EQ(saved_hash, game->game_state().StateHash());
+  EXPECT_EQ(saved_time, game->game_state().time());
+}
+
+// A snapshot can be restored into another game with the same config.
+TEST_F(GameStateSnapshotTests, RestoreIntoAnotherGame) {
+  std::unique_ptr<pn::HeadlessGame> game = NewGame();
+  game->Restart(2);
+  game->PlayUntil(8000, kFrameTime);
+  pn::GameStateSnapshot snapshot;
+  game->game_state().SaveSnapshot(&snapshot);
+
+  pn::GameStateSnapshot copy;
+  copy.Assign(snapshot.data(), snapshot.size());
+  std::unique_ptr<pn::HeadlessGame> other = NewGame();
+  ASSERT_TRUE(other->Restore(copy));
+  EXPECT_EQ(game->game_state().StateHash(), other->game_state().StateHash());
+}
+
+// Everything random is in the snapshot or the seed, so playing on from the
+// same snapshot with the same seed ends the same way.
+TEST_F(GameStateSnapshotTests, RestoredGamesReplayTheSame) {
+  std::unique_ptr<pn::HeadlessGame> game = NewGame();
+  game->Restart(3);
+  game->PlayUntil(3000, kFrameTime);
+  pn::GameStateSnapshot snapshot;
+  game->game_state().SaveSnapshot(&snapshot);
+
+  ASSERT_TRUE(game->Restore(snapshot, 7));
+  game->PlayUntil(20000, kFrameTime);
+  const uint32_t first_hash = game->game_state().StateHash();
+
+  ASSERT_TRUE(game->Restore(snapshot, 7));
+  game->PlayUntil(20000, kFrameTime);
+  EXPECT_EQ(first_hash, game->game_state().StateHash());
+}
+
+// Characters with an index or state out of range can't be restored.
+TEST_F(GameStateSnapshotTests, InvalidCharacterIsRefused) {
+  pn::CharacterSnapshot character = pn::CharacterSnapshot();
+  const fpl::CharacterId num_characters =
+      static_cast<fpl::CharacterId>(config_->character_count());
+  character.target = 1;
+  EXPECT_TRUE(pn::Character::IsValidSnapshot(character, num_characters));
+  character.target = 99;
+  EXPECT_FALSE(pn::Character::IsValidSnapshot(character, num_characters));
+  character.target = 0;
+  character.state = pn::StateId_Count;
+  EXPECT_FALSE(pn::Character::IsValidSnapshot(character, num_characters));
+}
+
+// Saving and restoring are meant to be cheap enough to do several times a
+// frame. Records the average cost in the test's XML output rather than
+// failing on a threshold, since test machines vary too much. Restores go
+// through HeadlessGame, as rollouts do.
+TEST_F(GameStateSnapshotTests, SaveAndRestoreCost) {
+  static const int kIterations = 1000;
+  std::unique_ptr<pn::HeadlessGame> game = NewGame();
+  game->Restart(4);
+  game->PlayUntil(5000, kFrameTime);
+  pn::GameStateSnapshot snapshot;
+  game->game_state().SaveSnapshot(&snapshot);
+
+  const auto save_start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) {
+    game->game_state().SaveSnapshot(&snapshot);
+  }
+  const auto restore_start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) {
+    ASSERT_TRUE(game->Restore(snapshot));
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  typedef std::chrono::nanoseconds Nanoseconds;
+  RecordProperty("snapshot_bytes", static_cast<int>(snapshot.size()));
+  RecordProperty(
+      "save_nanoseconds",
+      static_cast<int>(std::chrono::duration_cast<Nanoseconds>(
+                           restore_start - save_start).count() /
+                       kIterations));
+  RecordProperty(
+      "restore_nanoseconds",
+      static_cast<int>(std::chrono::duration_cast<Nanoseconds>(
+                           end - restore_start).count() /
+                       kIterations));
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,133 @@
+/*
+* Copyright (c) 2015 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <memory>
+#include <vector>
+#include "character.h"
+#include "game_state_snapshot.h"
+#include "pie_trajectory.h"
+#include "gtest/gtest.h"
+
+namespace pn = ::fpl::pie_noon;
+using mathfu::mat4;
+using mathfu::vec3;
+
+static const float kEpsilon = 1e-4f;
+
+// A pie thrown at time 1000 from (1, 0, 2) to (-3, 0, 6), taking 'flight_time'
+// milliseconds to arrive.
+static pn::AirbornePieSnapshot Throw(fpl::WorldTime flight_time,
+                                     int rotations, float y_rotation) {
+  pn::AirbornePieSnapshot pie = pn::AirbornePieSnapshot();
+  pie.start_time = 1000;
+  pie.flight_time = flight_time;
+  pie.source_position[0] = 1.0f;
+  pie.source_position[2] = 2.0f;
+  pie.target_position[0] = -3.0f;
+  pie.target_position[2] = 6.0f;
+  pie.start_height = 0.5f;
+  pie.peak_height = 2.5f;
+  pie.rotations = rotations;
+  pie.y_rotation = y_rotation;
+  return pie;
+}
+
+static void ExpectNear(const vec3& expected, const vec3& actual) {
+  EXPECT_NEAR(expected.x(), actual.x(), kEpsilon);
+  EXPECT_NEAR(expected.y(), actual.y(), kEpsilon);
+  EXPECT_NEAR(expected.z(), actual.z(), kEpsilon);
+}
+
+// Where the pie is at the start, the middle and the end of its flight, and
+// after it has landed.
+TEST(PieTrajectoryTests, FollowsTheArc) {
+  std::vector<std::unique_ptr<pn::AirbornePie>> pies;
+  pies.push_back(std::unique_ptr<pn::AirbornePie>(
+      new pn::AirbornePie(Throw(400, 1, 0.0f))));
+  pn::PieTrajectoryBatch batch;
+  batch.Rebuild(pies);
+
+  batch.Evaluate(1000, pies);
+  ExpectNear(vec3(1.0f, 0.5f, 2.0f), pies[0]->Position());
+  batch.Evaluate(1200, pies);
+  ExpectNear(vec3(-1.0f, 2.5f, 4.0f), pies[0]->Position());
+  batch.Evaluate(1400, pies);
+  ExpectNear(vec3(-3.0f, 0.5f, 6.0f), pies[0]->Position());
+  batch.Evaluate(5000, pies);
+  ExpectNear(vec3(-3.0f, 0.5f, 6.0f), pies[0]->Position());
+  batch.Evaluate(0, pies);
+  ExpectNear(vec3(1.0f, 0.5f, 2.0f), pies[0]->Position());
+}
+
+// The hand-multiplied matrix is translate * rotate about y * rotate about z.
+TEST(PieTrajectoryTests, MatrixMatchesRotations) {
+  static const int kRotations = 2;
+  static const float kYRotation = 0.7f;
+  std::vector<std::unique_ptr<pn::AirbornePie>> pies;
+  pies.push_back(std::unique_ptr<pn::AirbornePie>(
+      new pn::AirbornePie(Throw(400, kRotations, kYRotation))));
+  pn::PieTrajectoryBatch batch;
+  batch.Rebuild(pies);
+
+  for (fpl::WorldTime time = 1000; time <= 1400; time += 30) {
+    batch.Evaluate(time, pies);
+    const float fraction = (time - 1000) / 400.0f;
+    const float z_angle = kRotations * motive::kTwoPi * fraction;
+    const mat4 rotation = mat4::FromRotationMatrix(
+        (mathfu::quat::FromAngleAxis(kYRotation, mathfu::kAxisY3f) *
+         mathfu::quat::FromAngleAxis(z_angle, mathfu::kAxisZ3f))
+            .ToMatrix());
+    const mat4 expected =
+        mat4::FromTranslationVector(pies[0]->Position()) * rotation;
+    for (int i = 0; i < 16; ++i) {
+      EXPECT_NEAR(expected[i], pies[0]->Matrix()[i], kEpsilon);
+    }
+  }
+}
+
+// Evaluating pies together gives each the same result as evaluating it
+// alone.
+TEST(PieTrajectoryTests, BatchMatchesSinglePies) {
+  std::vector<std::unique_ptr<pn::AirbornePie>> together;
+  for (int i = 0; i < 7; ++i) {
+    together.push_back(std::unique_ptr<pn::AirbornePie>(
+        new pn::AirbornePie(Throw(200 + 50 * i, i % 3, 0.3f * i))));
+  }
+  pn::PieTrajectoryBatch batch;
+  batch.Rebuild(together);
+  batch.Evaluate(1234, together);
+
+  for (size_t i = 0; i < together.size(); ++i) {
+    pn::AirbornePieSnapshot snapshot;
+    together[i]->SaveSnapshot(&snapshot);
+    std::vector<std::unique_ptr<pn::AirbornePie>> alone;
+    alone.push_back(
+        std::unique_ptr<pn::AirbornePie>(new pn::AirbornePie(snapshot)));
+    pn::PieTrajectoryBatch single;
+    single.Rebuild(alone);
+    single.Evaluate(1234, alone);
+    for (int j = 0; j < 16; ++j) {
+      EXPECT_EQ(alone[0]->Matrix()[j], together[i]->Matrix()[j]);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
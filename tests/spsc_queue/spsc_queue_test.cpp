@@ -0,0 +1,96 @@
+/*
+* Copyright (c) 2015 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <memory>
+#include <thread>
+#include "spsc_queue.h"
+#include "gtest/gtest.h"
+
+// One slot is always left free, so a queue of 8 holds 7.
+TEST(SpscQueueTests, HoldsOneLessThanCapacity) {
+  fpl::SpscQueue<int, 8> queue;
+  EXPECT_TRUE(queue.Empty());
+  for (int i = 0; i < 7; ++i) {
+    EXPECT_TRUE(queue.Push(int(i)));
+    EXPECT_EQ(static_cast<size_t>(i + 1), queue.Size());
+  }
+  int rejected = 7;
+  EXPECT_FALSE(queue.Push(std::move(rejected)));
+  EXPECT_EQ(7, rejected);
+}
+
+// Items come out in the order they went in, including after the indices
+// wrap around the end of the buffer.
+TEST(SpscQueueTests, PopsInOrderAcrossTheWrap) {
+  fpl::SpscQueue<int, 4> queue;
+  int next_in = 0;
+  int next_out = 0;
+  for (int round = 0; round < 10; ++round) {
+    while (queue.Push(int(next_in))) next_in++;
+    int item;
+    for (int i = 0; i < 2; ++i) {
+      ASSERT_TRUE(queue.Pop(&item));
+      EXPECT_EQ(next_out++, item);
+    }
+  }
+  int item;
+  while (queue.Pop(&item)) EXPECT_EQ(next_out++, item);
+  EXPECT_EQ(next_in, next_out);
+  EXPECT_TRUE(queue.Empty());
+  EXPECT_EQ(0u, queue.Size());
+}
+
+// Popping lets go of the slot's contents straight away.
+TEST(SpscQueueTests, PopReleasesTheSlot) {
+  fpl::SpscQueue<std::shared_ptr<int>, 2> queue;
+  std::shared_ptr<int> shared(new int(3));
+  EXPECT_TRUE(queue.Push(std::shared_ptr<int>(shared)));
+  EXPECT_EQ(2, shared.use_count());
+  std::shared_ptr<int> popped;
+  ASSERT_TRUE(queue.Pop(&popped));
+  popped.reset();
+  EXPECT_EQ(1, shared.use_count());
+}
+
+// Everything one thread pushes arrives at the other, once and in order.
+TEST(SpscQueueTests, HandsItemsBetweenThreads) {
+  static const int kNumItems = 100000;
+  fpl::SpscQueue<int, 64> queue;
+  std::thread producer([&queue]() {
+    for (int i = 0; i < kNumItems; ++i) {
+      while (!queue.Push(int(i))) std::this_thread::yield();
+    }
+  });
+  int expected = 0;
+  while (expected < kNumItems) {
+    int item;
+    if (!queue.Pop(&item)) {
+      std::this_thread::yield();
+      continue;
+    }
+    EXPECT_EQ(expected, item);
+    expected++;
+  }
+  producer.join();
+  EXPECT_TRUE(queue.Empty());
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,60 @@
+/*
+* Copyright (c) 2015 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "state_hash.h"
+#include "gtest/gtest.h"
+
+namespace pn = ::fpl::pie_noon;
+
+// Nothing added leaves the FNV-1a offset basis.
+TEST(StateHasherTests, EmptyIsOffsetBasis) {
+  EXPECT_EQ(2166136261u, pn::StateHasher().hash());
+}
+
+// A value goes in least significant byte first, so 0x64636261 hashes like
+// the string "abcd" does under FNV-1a, on any platform.
+TEST(StateHasherTests, MatchesFnv1aOfLittleEndianBytes) {
+  pn::StateHasher hasher;
+  hasher.Add(0x64636261u);
+  EXPECT_EQ(0xce3479bdu, hasher.hash());
+}
+
+// Signed values hash as their two's complement bits.
+TEST(StateHasherTests, SignedMatchesUnsigned) {
+  pn::StateHasher signed_hasher;
+  signed_hasher.Add(static_cast<int32_t>(-2));
+  pn::StateHasher unsigned_hasher;
+  unsigned_hasher.Add(0xFFFFFFFEu);
+  EXPECT_EQ(unsigned_hasher.hash(), signed_hasher.hash());
+}
+
+// The same values in another order give another hash.
+TEST(StateHasherTests, OrderMatters) {
+  pn::StateHasher forwards;
+  forwards.Add(1u);
+  forwards.Add(2u);
+  pn::StateHasher backwards;
+  backwards.Add(2u);
+  backwards.Add(1u);
+  EXPECT_NE(forwards.hash(), backwards.hash());
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,434 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Searches for AiController tunings that win more games.
+//
+// Each generation samples a population of tunings around the current
+// estimate, plays every one in headless games against AIs with the tuning
+// the config ships with, and moves the estimate to the best quarter of the
+// population (the cross-entropy method). Games are played on every core.
+//
+// Usage:
+//   pie_noon_ai_tuner [options] <assets dir> <config.json> <output json>
+//                     <convergence csv>
+//
+// <assets dir> holds the built config.pieconfig and
+// character_state_machine_def.piestate. <config.json> is the source of
+// that config; it is written to <output json> with the winning tuning
+// patched in. <convergence csv> gets one row per generation.
+//
+// Options:
+//   --generations=N      Generations to run (default 20).
+//   --population=N       Tunings tried per generation (default 24).
+//   --games=N            Games played by each tuning (default 32).
+//   --max_game_time=MS   Games still going after this are draws
+//                        (default 120000).
+//   --frame_time=MS      Simulated frame length (default 33).
+//   --threads=N          Threads to play on (default: one per core).
+//   --seed=N             Random seed (default 1). Runs with the same seed
+//                        and options give the same results, whatever the
+//                        number of threads.
+//
+// Each generation's progress line ends with a hash of the final state of
+// every game it played. Compare them to check that a build, or a different
+// number of threads, plays exactly the same games.
+
+#include "precompiled.h"
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "ai_controller.h"
+#include "character_state_machine.h"
+#include "character_state_machine_def_generated.h"
+#include "config_generated.h"
+#include "headless_game.h"
+#include "motive/init.h"
+#include "state_hash.h"
+#include "worker_pool.h"
+
+using fpl::CharacterId;
+using fpl::WorkerPool;
+using fpl::WorldTime;
+using fpl::pie_noon::AiController;
+using fpl::pie_noon::AiTuning;
+using fpl::pie_noon::CharacterStateMachineDef;
+using fpl::pie_noon::Config;
+using fpl::pie_noon::HeadlessGame;
+using fpl::pie_noon::StateHasher;
+
+namespace {
+
+// A config value that the search can change.
+struct Knob {
+  const char* name;
+  float min_value;
+  float max_value;
+  bool is_time;
+};
+
+// The knobs, in the order they appear in a Tuning.
+const Knob kKnobs[] = {
+    {"ai_chance_to_throw", 0.0f, 1.0f, false},
+    {"ai_chance_to_block", 0.0f, 1.0f, false},
+    {"ai_chance_to_change_aim", 0.0f, 1.0f, false},
+    {"ai_block_min_duration", 0.0f, 4000.0f, true},
+    {"ai_block_max_duration", 0.0f, 4000.0f, true},
+};
+const int kNumKnobs = static_cast<int>(sizeof(kKnobs) / sizeof(kKnobs[0]));
+
+struct Tuning {
+  float values[kNumKnobs];
+};
+
+struct Options {
+  Options()
+      : generations(20),
+        population(24),
+        games(32),
+        max_game_time(120000),
+        frame_time(33),
+        threads(0),
+        seed(1) {}
+
+  int generations;
+  int population;
+  int games;
+  int max_game_time;
+  int frame_time;
+  int threads;
+  int seed;
+  std::vector<std::string> paths;
+};
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg.compare(0, 2, "--") != 0) {
+      options->paths.push_back(arg);
+      continue;
+    }
+    const size_t equals = arg.find('=');
+    if (equals == std::string::npos) return false;
+    const std::string name = arg.substr(2, equals - 2);
+    const int value = atoi(arg.c_str() + equals + 1);
+    if (name == "generations") {
+      options->generations = value;
+    } else if (name == "population") {
+      options->population = value;
+    } else if (name == "games") {
+      options->games = value;
+    } else if (name == "max_game_time") {
+      options->max_game_time = value;
+    } else if (name == "frame_time") {
+      options->frame_time = value;
+    } else if (name == "threads") {
+      options->threads = value;
+    } else if (name == "seed") {
+      options->seed = value;
+    } else {
+      return false;
+    }
+  }
+  return options->paths.size() == 4 && options->generations > 0 &&
+         options->population > 1 && options->games > 0;
+}
+
+Tuning TuningFromConfig(const Config& config) {
+  const AiTuning ai = AiTuning::FromConfig(config);
+  Tuning tuning;
+  tuning.values[0] = ai.chance_to_throw;
+  tuning.values[1] = ai.chance_to_block;
+  tuning.values[2] = ai.chance_to_change_aim;
+  tuning.values[3] = static_cast<float>(ai.block_min_duration);
+  tuning.values[4] = static_cast<float>(ai.block_max_duration);
+  return tuning;
+}
+
+AiTuning ToAiTuning(const Tuning& tuning, const Config& config) {
+  AiTuning ai = AiTuning::FromConfig(config);
+  ai.chance_to_throw = tuning.values[0];
+  ai.chance_to_block = tuning.values[1];
+  ai.chance_to_change_aim = tuning.values[2];
+  ai.block_min_duration = static_cast<WorldTime>(tuning.values[3]);
+  ai.block_max_duration = static_cast<WorldTime>(tuning.values[4]);
+  return ai;
+}
+
+// Keep every knob in range, times whole, and the block durations in order.
+void Constrain(Tuning* tuning) {
+  for (int k = 0; k < kNumKnobs; ++k) {
+    float& value = tuning->values[k];
+    value = std::min(std::max(value, kKnobs[k].min_value), kKnobs[k].max_value);
+    if (kKnobs[k].is_time) value = std::floor(value + 0.5f);
+  }
+  if (tuning->values[4] < tuning->values[3]) {
+    std::swap(tuning->values[3], tuning->values[4]);
+  }
+}
+
+// How well 'tuned' did in a game: 1 for being the only one left, plus a
+// little for health left so that close games still count for something.
+float Outcome(const HeadlessGame& game, CharacterId tuned,
+              const Config& config) {
+  const auto& characters = game.game_state().characters();
+  const int health = std::max(characters[tuned]->health(), 0);
+  const bool won = health > 0 && game.NumStanding() == 1;
+  return (won ? 1.0f : 0.0f) +
+         0.1f * health / std::max(config.character_health(), 1);
+}
+
+// Replace the value of the top-level field 'name' in the config JSON. The
+// config files put top-level fields on their own lines, indented by two
+// spaces, which tells them apart from fields of the same name in nested
+// tables.
+bool PatchJsonField(const char* name, const std::string& value,
+                    std::string* json) {
+  const std::string key = std::string("\n  \"") + name + "\":";
+  const size_t key_pos = json->find(key);
+  if (key_pos == std::string::npos) return false;
+  size_t begin = key_pos + key.size();
+  while (begin < json->size() && (*json)[begin] == ' ') begin++;
+  const size_t end = json->find_first_of(",\n}", begin);
+  if (end == std::string::npos) return false;
+  json->replace(begin, end - begin, value);
+  return true;
+}
+
+// The seed for one game, from the run's seed and the game's place in the
+// whole run, so that it doesn't matter which thread plays it.
+uint32_t GameSeed(int seed, int generation, int index) {
+  std::seed_seq sequence = {static_cast<uint32_t>(seed),
+                            static_cast<uint32_t>(generation),
+                            static_cast<uint32_t>(index)};
+  uint32_t game_seed;
+  sequence.generate(&game_seed, &game_seed + 1);
+  return game_seed;
+}
+
+std::string FormatKnob(int knob, float value) {
+  char buffer[32];
+  if (kKnobs[knob].is_time) {
+    snprintf(buffer, sizeof(buffer), "%d", static_cast<int>(value));
+  } else {
+    snprintf(buffer, sizeof(buffer), "%.3f", value);
+  }
+  return buffer;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    fprintf(stderr,
+            "Usage: %s [--generations=N] [--population=N] [--games=N]\n"
+            "    [--max_game_time=MS] [--frame_time=MS] [--threads=N]\n"
+            "    [--seed=N] <assets dir> <config.json> <output json>\n"
+            "    <convergence csv>\n",
+            argv[0]);
+    return 1;
+  }
+  const std::string& assets_dir = options.paths[0];
+
+  std::string config_source;
+  std::string state_machine_source;
+  std::string config_json;
+  if (!flatbuffers::LoadFile((assets_dir + "/config.pieconfig").c_str(), true,
+                             &config_source) ||
+      !flatbuffers::LoadFile(
+          (assets_dir + "/character_state_machine_def.piestate").c_str(),
+          true, &state_machine_source) ||
+      !flatbuffers::LoadFile(options.paths[1].c_str(), false, &config_json)) {
+    fprintf(stderr, "Can't load the config and state machine.\n");
+    return 1;
+  }
+  flatbuffers::Verifier config_verifier(
+      reinterpret_cast<const uint8_t*>(config_source.c_str()),
+      config_source.size());
+  flatbuffers::Verifier state_machine_verifier(
+      reinterpret_cast<const uint8_t*>(state_machine_source.c_str()),
+      state_machine_source.size());
+  if (!fpl::pie_noon::VerifyConfigBuffer(config_verifier) ||
+      !fpl::pie_noon::VerifyCharacterStateMachineDefBuffer(
+          state_machine_verifier)) {
+    fprintf(stderr, "The config or state machine is corrupt.\n");
+    return 1;
+  }
+  const Config* config = fpl::pie_noon::GetConfig(config_source.c_str());
+  const CharacterStateMachineDef* state_machine_def =
+      fpl::pie_noon::GetCharacterStateMachineDef(state_machine_source.c_str());
+  if (!fpl::pie_noon::CharacterStateMachineDef_Validate(state_machine_def)) {
+    fprintf(stderr, "State machine is invalid.\n");
+    return 1;
+  }
+
+  motive::OvershootInit::Register();
+  motive::SplineInit::Register();
+  motive::MatrixInit::Register();
+  std::mt19937 random(options.seed);
+
+  // One game per thread, each with a seat for every character.
+  const int num_threads =
+      options.threads > 0
+          ? options.threads
+          : std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+  const int num_characters = static_cast<int>(config->character_count());
+  std::vector<std::unique_ptr<HeadlessGame>> games;
+  for (int i = 0; i < num_threads; ++i) {
+    std::vector<std::unique_ptr<AiController>> controllers;
+    for (int j = 0; j < num_characters; ++j) {
+      controllers.push_back(std::unique_ptr<AiController>(new AiController()));
+    }
+    games.push_back(std::unique_ptr<HeadlessGame>(new HeadlessGame()));
+    games.back()->Initialize(config, state_machine_def, &controllers);
+  }
+  WorkerPool worker_pool;
+  worker_pool.Initialize(num_threads);
+
+  FILE* csv = fopen(options.paths[3].c_str(), "w");
+  if (!csv) {
+    fprintf(stderr, "Can't write %s.\n", options.paths[3].c_str());
+    return 1;
+  }
+  fprintf(csv, "generation,best_fitness,mean_fitness,best_ever_fitness");
+  for (int k = 0; k < kNumKnobs; ++k) fprintf(csv, ",mean_%s", kKnobs[k].name);
+  for (int k = 0; k < kNumKnobs; ++k) fprintf(csv, ",sigma_%s", kKnobs[k].name);
+  fprintf(csv, "\n");
+
+  const Tuning shipped = TuningFromConfig(*config);
+  const AiTuning opponent_tuning = AiTuning::FromConfig(*config);
+  Tuning mean = shipped;
+  float sigma[kNumKnobs];
+  for (int k = 0; k < kNumKnobs; ++k) {
+    sigma[k] = (kKnobs[k].max_value - kKnobs[k].min_value) / 4.0f;
+  }
+  Tuning best_ever = shipped;
+  float best_ever_fitness = -1.0f;
+
+  const int num_elites = std::max(options.population / 4, 2);
+  std::vector<Tuning> population(options.population);
+  std::vector<float> outcomes(options.population * options.games);
+  std::vector<uint32_t> end_hashes(options.population * options.games);
+  std::vector<float> fitness(options.population);
+  std::vector<int> ranking(options.population);
+
+  for (int generation = 0; generation < options.generations; ++generation) {
+    // Always measure the current estimate itself alongside its samples.
+    population[0] = mean;
+    for (int p = 1; p < options.population; ++p) {
+      for (int k = 0; k < kNumKnobs; ++k) {
+        std::normal_distribution<float> spread(mean.values[k], sigma[k]);
+        population[p].values[k] = spread(random);
+      }
+      Constrain(&population[p]);
+    }
+
+    // Every game of every tuning is a separate piece of work. The tuned AI
+    // takes each seat in turn, since the seats aren't all equal.
+    const int num_games = options.population * options.games;
+    std::atomic<int> next_game(0);
+    worker_pool.ParallelFor(num_threads, [&](int thread) {
+      HeadlessGame* game = games[thread].get();
+      for (;;) {
+        const int index = next_game++;
+        if (index >= num_games) break;
+        const int p = index / options.games;
+        const CharacterId tuned = (index % options.games) % num_characters;
+        game->Restart(GameSeed(options.seed, generation, index));
+        for (CharacterId id = 0; id < num_characters; ++id) {
+          game->controller(id)->set_tuning(
+              id == tuned ? ToAiTuning(population[p], *config)
+                          : opponent_tuning);
+        }
+        game->PlayUntil(options.max_game_time, options.frame_time);
+        outcomes[index] = Outcome(*game, tuned, *config);
+        end_hashes[index] = game->game_state().StateHash();
+      }
+    });
+
+    // Combined in game order, so the thread that played each doesn't matter.
+    StateHasher generation_hash;
+    for (auto it = end_hashes.begin(); it != end_hashes.end(); ++it) {
+      generation_hash.Add(*it);
+    }
+
+    float total_fitness = 0.0f;
+    for (int p = 0; p < options.population; ++p) {
+      float sum = 0.0f;
+      for (int g = 0; g < options.games; ++g) {
+        sum += outcomes[p * options.games + g];
+      }
+      fitness[p] = sum / options.games;
+      total_fitness += fitness[p];
+      ranking[p] = p;
+    }
+    std::sort(ranking.begin(), ranking.end(), [&fitness](int a, int b) {
+      return fitness[a] > fitness[b] || (fitness[a] == fitness[b] && a < b);
+    });
+    const int best = ranking[0];
+    if (fitness[best] > best_ever_fitness) {
+      best_ever_fitness = fitness[best];
+      best_ever = population[best];
+    }
+
+    // Refit the sampling distribution to the elites. Keep a little spread
+    // so the search doesn't stop dead.
+    for (int k = 0; k < kNumKnobs; ++k) {
+      float sum = 0.0f;
+      for (int e = 0; e < num_elites; ++e) {
+        sum += population[ranking[e]].values[k];
+      }
+      const float elite_mean = sum / num_elites;
+      float variance = 0.0f;
+      for (int e = 0; e < num_elites; ++e) {
+        const float d = population[ranking[e]].values[k] - elite_mean;
+        variance += d * d;
+      }
+      mean.values[k] = elite_mean;
+      sigma[k] = std::max(std::sqrt(variance / num_elites),
+                          (kKnobs[k].max_value - kKnobs[k].min_value) * 0.01f);
+    }
+    Constrain(&mean);
+
+    fprintf(csv, "%d,%f,%f,%f", generation, fitness[best],
+            total_fitness / options.population, best_ever_fitness);
+    for (int k = 0; k < kNumKnobs; ++k) fprintf(csv, ",%f", mean.values[k]);
+    for (int k = 0; k < kNumKnobs; ++k) fprintf(csv, ",%f", sigma[k]);
+    fprintf(csv, "\n");
+    fflush(csv);
+    printf("generation %d: best %.3f, mean %.3f, state hash %08x\n",
+           generation, fitness[best], total_fitness / options.population,
+           generation_hash.hash());
+  }
+  fclose(csv);
+
+  for (int k = 0; k < kNumKnobs; ++k) {
+    const std::string value = FormatKnob(k, best_ever.values[k]);
+    if (!PatchJsonField(kKnobs[k].name, value, &config_json)) {
+      fprintf(stderr, "Can't find %s in %s.\n", kKnobs[k].name,
+              options.paths[1].c_str());
+      return 1;
+    }
+    printf("%s: %s\n", kKnobs[k].name, value.c_str());
+  }
+  if (!flatbuffers::SaveFile(options.paths[2].c_str(), config_json, false)) {
+    fprintf(stderr, "Can't write %s.\n", options.paths[2].c_str());
+    return 1;
+  }
+  return 0;
+}